@@ -9,11 +9,13 @@ DEFINES += APP_VERSION=\\\"$$VERSION\\\"
 
 QT       += core gui
 QT       += dbus
+QT       += concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG    += c++11
 CONFIG    += link_pkgconfig
+PKGCONFIG += zlib
 
 #CONFIG    += packaging   # Enables "make install" for packaging paths
 
@@ -87,7 +89,40 @@ SOURCES += src/main.cpp\
     src/core/resourceexporter.cpp \
     src/capture/widget/notifierbox.cpp \
     src/utils/desktopinfo.cpp \
-    src/utils/dbusutils.cpp
+    src/utils/dbusutils.cpp \
+    src/utils/windowindex.cpp \
+    src/utils/imagestitcher.cpp \
+    src/utils/tilehasher.cpp \
+    src/utils/imagediff.cpp \
+    src/capture/workers/scrollcapture.cpp \
+    src/capture/tools/scrollcapturetool.cpp \
+    src/capture/tools/filltool.cpp \
+    src/capture/tools/texttool.cpp \
+    src/utils/glyphcache.cpp \
+    src/utils/pngencoder.cpp \
+    src/utils/imageencoder.cpp \
+    src/utils/clipboardmimedata.cpp \
+    src/utils/savequeue.cpp \
+    src/utils/filenametemplate.cpp \
+    src/utils/filenameindex.cpp \
+    src/utils/encoderselector.cpp \
+    src/utils/dedupindex.cpp \
+    src/utils/mipmapcache.cpp \
+    src/core/exportpipeline.cpp \
+    src/utils/idlethreadpool.cpp \
+    src/utils/archiverecompressor.cpp \
+    src/utils/imageview.cpp \
+    src/core/capturepipeline.cpp \
+    src/core/framestream.cpp \
+    src/core/frameserver.cpp \
+    src/utils/palettequantizer.cpp \
+    src/utils/clipencoder.cpp \
+    src/capture/tools/cliprecordertool.cpp \
+    src/capture/workers/cliprecorder.cpp \
+    src/core/burstcapture.cpp \
+    src/utils/timelapsewriter.cpp \
+    src/utils/timelapsereader.cpp \
+    src/core/regionwatcher.cpp
 
 HEADERS  += \
     src/capture/widget/buttonhandler.h \
@@ -138,7 +173,40 @@ HEADERS  += \
     src/core/resourceexporter.h \
     src/capture/widget/notifierbox.h \
     src/utils/desktopinfo.h \
-    src/utils/dbusutils.h
+    src/utils/dbusutils.h \
+    src/utils/windowindex.h \
+    src/utils/imagestitcher.h \
+    src/utils/tilehasher.h \
+    src/utils/imagediff.h \
+    src/capture/workers/scrollcapture.h \
+    src/capture/tools/scrollcapturetool.h \
+    src/capture/tools/filltool.h \
+    src/capture/tools/texttool.h \
+    src/utils/glyphcache.h \
+    src/utils/pngencoder.h \
+    src/utils/imageencoder.h \
+    src/utils/clipboardmimedata.h \
+    src/utils/savequeue.h \
+    src/utils/filenametemplate.h \
+    src/utils/filenameindex.h \
+    src/utils/encoderselector.h \
+    src/utils/dedupindex.h \
+    src/utils/mipmapcache.h \
+    src/core/exportpipeline.h \
+    src/utils/idlethreadpool.h \
+    src/utils/archiverecompressor.h \
+    src/utils/imageview.h \
+    src/core/capturepipeline.h \
+    src/core/framestream.h \
+    src/core/frameserver.h \
+    src/utils/palettequantizer.h \
+    src/utils/clipencoder.h \
+    src/capture/tools/cliprecordertool.h \
+    src/capture/workers/cliprecorder.h \
+    src/core/burstcapture.h \
+    src/utils/timelapsewriter.h \
+    src/utils/timelapsereader.h \
+    src/core/regionwatcher.h
 
 RESOURCES += \
     graphics.qrc
@@ -62,6 +62,16 @@ int CaptureModification::thickness() const {
     return m_thickness;
 }
 
+// setColor and setThickness change the style of a vector modification,
+// the rest are already painted in the screenshot
+void CaptureModification::setColor(const QColor &color) {
+    m_color = color;
+}
+
+void CaptureModification::setThickness(const int thickness) {
+    m_thickness = thickness;
+}
+
 // addPoint adds a point to the vector of points
 void CaptureModification::addPoint(const QPoint p) {
     if (m_tool->toolType() == CaptureTool::TYPE_LINE_DRAWER) {
@@ -42,6 +42,8 @@ public:
     int thickness() const;
     CaptureButton::ButtonType buttonType() const;
     void addPoint(const QPoint);
+    void setColor(const QColor &color);
+    void setThickness(const int thickness);
 
 protected:
     QColor m_color;
@@ -54,32 +54,54 @@ QPixmap Screenshot::baseScreenshot() const {
 
 //  getScreenshot returns the screenshot with all the modifications
 QPixmap Screenshot::screenshot() const {
+    if (m_vectorModifications.isEmpty()) {
+        return m_modifiedScreenshot;
+    }
+    QPixmap res(m_modifiedScreenshot);
+    QPainter painter(&res);
+    paintVectorModifications(painter);
+    return res;
+}
+
+// rasterScreenshot returns the screenshot without the vector modifications
+QPixmap Screenshot::rasterScreenshot() const {
     return m_modifiedScreenshot;
 }
 
 QPixmap Screenshot::croppedScreenshot(const QRect &selection) const {
-    return m_modifiedScreenshot.copy(selection);
+    return screenshot().copy(selection);
 }
 
-// paintModification adds a new modification to the screenshot
+// paintModification adds a new modification to the screenshot. The vector
+// modifications stay over the pixels only while they are the last ones, a
+// raster modification paints them first so the history order is kept.
 QPixmap Screenshot::paintModification(const CaptureModification *modification) {
+    if (modification->tool()->isVector()) {
+        if (!m_vectorModifications.contains(modification)) {
+            m_vectorModifications.append(modification);
+        }
+        return m_modifiedScreenshot;
+    }
     QPainter painter(&m_modifiedScreenshot);
-    painter.setRenderHint(QPainter::Antialiasing);
+    paintVectorModifications(painter);
+    m_vectorModifications.clear();
     paintInPainter(painter, modification);
     return m_modifiedScreenshot;
 }
 
-// paintTemporalModification paints a modification without updating the
-// member pixmap
+// paintTemporalModification paints a modification over the vector ones
+// without updating the member pixmap
 QPixmap Screenshot::paintTemporalModification(
         const CaptureModification *modification)
 {
     QPixmap tempPix(m_modifiedScreenshot);
     QPainter painter(&tempPix);
-    if (modification->buttonType() != CaptureButton::TYPE_PENCIL) {
-        painter.setRenderHint(QPainter::Antialiasing);
+    paintVectorModifications(painter);
+    painter.setRenderHint(QPainter::Antialiasing,
+                          modification->buttonType() != CaptureButton::TYPE_PENCIL);
+    if (!m_vectorModifications.contains(modification)) {
+        paintInPainter(painter, modification);
     }
-    paintInPainter(painter, modification);
     return tempPix;
 }
 
@@ -89,16 +111,32 @@ QPixmap Screenshot::overrideModifications(
         const QVector<CaptureModification*> &m)
 {
     m_modifiedScreenshot = m_baseScreenshot;
+    m_vectorModifications.clear();
     for (const CaptureModification *const modification: m) {
         paintModification(modification);
     }
     return m_modifiedScreenshot;
 }
 
+// removeVectorModification removes one of the last vector modifications
+// without repainting the rest of them
+void Screenshot::removeVectorModification(
+        const CaptureModification *modification)
+{
+    m_vectorModifications.removeOne(modification);
+}
+
+void Screenshot::paintVectorModifications(QPainter &painter) const {
+    painter.setRenderHint(QPainter::Antialiasing);
+    for (const CaptureModification *const modification: m_vectorModifications) {
+        paintInPainter(painter, modification);
+    }
+}
+
 // paintInPainter is an aux method to prevent duplicated code, it draws the
 // passed modification to the painter.
 void Screenshot::paintInPainter(QPainter &painter,
-                                const CaptureModification *modification)
+                                const CaptureModification *modification) const
 {
     const QVector<QPoint> &points = modification->points();
     QColor color = modification->color();
@@ -25,6 +25,7 @@
 
 class QString;
 class CaptureModification;
+class QPainter;
 class QNetworkAccessManager;
 
 class Screenshot : public QObject {
@@ -36,17 +37,23 @@ public:
     void setScreenshot(const QPixmap &);
     QPixmap baseScreenshot() const;
     QPixmap screenshot() const;
+    QPixmap rasterScreenshot() const;
     QPixmap croppedScreenshot(const QRect &selection) const;
 
     QPixmap paintModification(const CaptureModification*);
     QPixmap paintTemporalModification(const CaptureModification*);
     QPixmap overrideModifications(const QVector<CaptureModification*> &);
+    void removeVectorModification(const CaptureModification*);
+    void paintVectorModifications(QPainter &) const;
 
 private:
     QPixmap m_baseScreenshot;
     QPixmap m_modifiedScreenshot;
+    // vector modifications after the last raster one, painted over the
+    // screenshot, see CaptureTool::isVector
+    QVector<const CaptureModification*> m_vectorModifications;
 
-    void paintInPainter(QPainter &, const CaptureModification *);
+    void paintInPainter(QPainter &, const CaptureModification *) const;
 
 };
 
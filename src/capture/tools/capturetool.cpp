@@ -20,3 +20,9 @@
 CaptureTool::CaptureTool(QObject *parent) : QObject(parent)
 {
 }
+
+// isVector defines if the modifications of the tool are painted over the
+// screenshot instead of being added to it, so they can change later
+bool CaptureTool::isVector() const {
+    return false;
+}
@@ -45,6 +45,8 @@ public:
         REQ_TO_CLIPBOARD,
         REQ_UPLOAD_TO_IMGUR,
         REQ_MOVE_MODE,
+        REQ_SCROLL_CAPTURE,
+        REQ_RECORD_CLIP,
     };
 
     explicit CaptureTool(QObject *parent = nullptr);
@@ -52,6 +54,7 @@ public:
     virtual int id() const = 0;
     virtual bool isSelectable() const = 0;
     virtual ToolWorkType toolType() const = 0;
+    virtual bool isVector() const;
 
     virtual QString iconName() const = 0;
     virtual QString name() const = 0;
@@ -0,0 +1,63 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cliprecordertool.h"
+#include <QPainter>
+
+ClipRecorderTool::ClipRecorderTool(QObject *parent) : CaptureTool(parent) {
+
+}
+
+int ClipRecorderTool::id() const {
+    return 0;
+}
+
+bool ClipRecorderTool::isSelectable() const {
+    return false;
+}
+
+QString ClipRecorderTool::iconName() const {
+    return "record-clip.png";
+}
+
+QString ClipRecorderTool::name() const {
+    return tr("Record Clip");
+}
+
+QString ClipRecorderTool::description() const {
+    return tr("Record a short animation of the selection");
+}
+
+CaptureTool::ToolWorkType ClipRecorderTool::toolType() const {
+    return TYPE_WORKER;
+}
+
+void ClipRecorderTool::processImage(
+        QPainter &painter,
+        const QVector<QPoint> &points,
+        const QColor &color,
+        const int thickness)
+{
+    Q_UNUSED(painter);
+    Q_UNUSED(points);
+    Q_UNUSED(color);
+    Q_UNUSED(thickness);
+}
+
+void ClipRecorderTool::onPressed() {
+    Q_EMIT requestAction(REQ_RECORD_CLIP);
+}
@@ -0,0 +1,204 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "filltool.h"
+#include <QPainter>
+#include <QPixmap>
+#include <algorithm>
+#include <cstring>
+
+// FillTool fills the area connected to the clicked pixel whose colors are
+// similar to it. The area is computed from the image under the modification,
+// which never changes for a given modification as they are only added or
+// removed at the end, so the spans are computed once and reused while the
+// modifications are repainted.
+
+namespace {
+
+struct Span {
+    int y;
+    int left;
+    int right;
+};
+
+// the thickness (0-100) sets the maximum difference per channel
+int toleranceFor(const int thickness) {
+    return thickness * 255 / 100;
+}
+
+inline bool isSimilar(const QRgb a, const QRgb b, const int tolerance) {
+    return qAbs(qRed(a) - qRed(b)) <= tolerance &&
+            qAbs(qGreen(a) - qGreen(b)) <= tolerance &&
+            qAbs(qBlue(a) - qBlue(b)) <= tolerance &&
+            qAbs(qAlpha(a) - qAlpha(b)) <= tolerance;
+}
+
+// fillSpans is a scanline flood fill, every row is filled as a whole span
+// and only one seed per run of matching pixels is pushed for the rows above
+// and below it
+QVector<Span> fillSpans(const QImage &image, const QPoint &seed,
+                        const int tolerance)
+{
+    QVector<Span> res;
+    const int width = image.width();
+    const int height = image.height();
+    const QRgb target = image.pixel(seed);
+    QVector<uchar> visited(width * height, 0);
+
+    auto matches = [target, tolerance](const QRgb *line, const uchar *done,
+            const int x)
+    {
+        return !done[x] && isSimilar(line[x], target, tolerance);
+    };
+
+    QVector<QPoint> pending = { seed };
+    while (!pending.isEmpty()) {
+        const QPoint p = pending.takeLast();
+        const int y = p.y();
+        auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        uchar *done = visited.data() + y * width;
+        if (!matches(line, done, p.x())) {
+            continue;
+        }
+        int left = p.x();
+        int right = p.x();
+        while (left > 0 && matches(line, done, left - 1)) {
+            --left;
+        }
+        while (right < width - 1 && matches(line, done, right + 1)) {
+            ++right;
+        }
+        std::memset(done + left, 1, right - left + 1);
+        res.append({ y, left, right });
+
+        for (const int ny: { y - 1, y + 1 }) {
+            if (ny < 0 || ny >= height) {
+                continue;
+            }
+            auto nextLine = reinterpret_cast<const QRgb *>(image.constScanLine(ny));
+            const uchar *nextDone = visited.constData() + ny * width;
+            bool inRun = false;
+            for (int x = left; x <= right; ++x) {
+                bool match = matches(nextLine, nextDone, x);
+                if (match && !inRun) {
+                    pending.append(QPoint(x, ny));
+                }
+                inRun = match;
+            }
+        }
+    }
+    return res;
+}
+
+} // unnamed namespace
+
+FillTool::FillTool(QObject *parent) : CaptureTool(parent), m_computed(false) {
+
+}
+
+int FillTool::id() const {
+    return 0;
+}
+
+bool FillTool::isSelectable() const {
+    return true;
+}
+
+QString FillTool::iconName() const {
+    return "fill.png";
+}
+
+QString FillTool::name() const {
+    return tr("Fill");
+}
+
+QString FillTool::description() const {
+    return tr("Sets the Fill as the paint tool, the thickness sets the color tolerance");
+}
+
+CaptureTool::ToolWorkType FillTool::toolType() const {
+    return TYPE_LINE_DRAWER;
+}
+
+void FillTool::processImage(
+        QPainter &painter,
+        const QVector<QPoint> &points,
+        const QColor &color,
+        const int thickness)
+{
+    if (!m_computed) {
+        m_computed = true;
+        QPaintDevice *device = painter.device();
+        QImage image;
+        if (device->devType() == QInternal::Pixmap) {
+            image = static_cast<QPixmap *>(device)->toImage();
+        } else if (device->devType() == QInternal::Image) {
+            image = *static_cast<QImage *>(device);
+        }
+        if (image.isNull()) {
+            return;
+        }
+        const qreal ratio = image.devicePixelRatio();
+        computeFill(image, (QPointF(points.first()) * ratio).toPoint(),
+                    color, toleranceFor(thickness));
+        m_fill.setDevicePixelRatio(ratio);
+    }
+    if (!m_fill.isNull()) {
+        painter.drawImage(QPointF(m_fillRect.topLeft()) / m_fill.devicePixelRatio(),
+                          m_fill);
+    }
+}
+
+void FillTool::onPressed() {
+}
+
+// computeFill renders the spans of the filled area in an image covering
+// just their bounding rect
+void FillTool::computeFill(const QImage &source, const QPoint &seed,
+                           const QColor &color, const int tolerance)
+{
+    if (!source.rect().contains(seed)) {
+        return;
+    }
+    QImage image = source;
+    if (image.format() != QImage::Format_RGB32 &&
+            image.format() != QImage::Format_ARGB32 &&
+            image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+    const QVector<Span> spans = fillSpans(image, seed, tolerance);
+    int left = image.width(), right = -1;
+    int top = image.height(), bottom = -1;
+    for (const Span &s: spans) {
+        left = qMin(left, s.left);
+        right = qMax(right, s.right);
+        top = qMin(top, s.y);
+        bottom = qMax(bottom, s.y);
+    }
+    if (right < 0) {
+        return;
+    }
+    m_fillRect = QRect(QPoint(left, top), QPoint(right, bottom));
+    m_fill = QImage(m_fillRect.size(), QImage::Format_ARGB32_Premultiplied);
+    m_fill.fill(Qt::transparent);
+    const QRgb value = qPremultiply(color.rgba());
+    for (const Span &s: spans) {
+        auto line = reinterpret_cast<QRgb *>(m_fill.scanLine(s.y - top));
+        std::fill(line + s.left - left, line + s.right - left + 1, value);
+    }
+}
@@ -0,0 +1,63 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "scrollcapturetool.h"
+#include <QPainter>
+
+ScrollCaptureTool::ScrollCaptureTool(QObject *parent) : CaptureTool(parent) {
+
+}
+
+int ScrollCaptureTool::id() const {
+    return 0;
+}
+
+bool ScrollCaptureTool::isSelectable() const {
+    return false;
+}
+
+QString ScrollCaptureTool::iconName() const {
+    return "scroll-capture.png";
+}
+
+QString ScrollCaptureTool::name() const {
+    return tr("Scrolling Capture");
+}
+
+QString ScrollCaptureTool::description() const {
+    return tr("Capture the selection while its content is scrolled");
+}
+
+CaptureTool::ToolWorkType ScrollCaptureTool::toolType() const {
+    return TYPE_WORKER;
+}
+
+void ScrollCaptureTool::processImage(
+        QPainter &painter,
+        const QVector<QPoint> &points,
+        const QColor &color,
+        const int thickness)
+{
+    Q_UNUSED(painter);
+    Q_UNUSED(points);
+    Q_UNUSED(color);
+    Q_UNUSED(thickness);
+}
+
+void ScrollCaptureTool::onPressed() {
+    Q_EMIT requestAction(REQ_SCROLL_CAPTURE);
+}
@@ -0,0 +1,100 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "texttool.h"
+#include "src/utils/glyphcache.h"
+#include <QPainter>
+
+// TextTool draws a label from the glyph cache. It is a vector tool, its
+// text is painted over the screenshot instead of being rasterized into it.
+
+TextTool::TextTool(QObject *parent) : CaptureTool(parent), m_editing(false) {
+
+}
+
+int TextTool::id() const {
+    return 0;
+}
+
+bool TextTool::isSelectable() const {
+    return true;
+}
+
+bool TextTool::isVector() const {
+    return true;
+}
+
+QString TextTool::iconName() const {
+    return "format-text.png";
+}
+
+QString TextTool::name() const {
+    return tr("Text");
+}
+
+QString TextTool::description() const {
+    return tr("Sets the Text as the paint tool");
+}
+
+CaptureTool::ToolWorkType TextTool::toolType() const {
+    return TYPE_LINE_DRAWER;
+}
+
+void TextTool::processImage(
+        QPainter &painter,
+        const QVector<QPoint> &points,
+        const QColor &color,
+        const int thickness)
+{
+    QFont f = font(thickness);
+    QPoint end = GlyphCache::getInstance()->drawText(
+                painter, points.first(), m_text, f, color);
+    if (m_editing) {
+        QFontMetrics fm(f);
+        painter.setPen(QPen(color, 1));
+        painter.drawLine(end.x() + 1, end.y() - fm.ascent(),
+                         end.x() + 1, end.y() + fm.descent());
+    }
+}
+
+QString TextTool::text() const {
+    return m_text;
+}
+
+void TextTool::setText(const QString &text) {
+    m_text = text;
+}
+
+// setEditing shows or hides the caret at the end of the text
+void TextTool::setEditing(const bool editing) {
+    m_editing = editing;
+}
+
+QRect TextTool::boundingRect(const QPoint &pos, const int thickness) const {
+    // the caret may be after the last glyph
+    return GlyphCache::getInstance()->boundingRect(
+                pos, m_text, font(thickness)).adjusted(0, 0, 3, 0);
+}
+
+void TextTool::onPressed() {
+}
+
+QFont TextTool::font(const int thickness) const {
+    QFont f;
+    f.setPixelSize(12 + thickness);
+    return f;
+}
@@ -0,0 +1,60 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXTTOOL_H
+#define TEXTTOOL_H
+
+#include "capturetool.h"
+#include <QRect>
+#include <QFont>
+
+class TextTool : public CaptureTool
+{
+    Q_OBJECT
+public:
+    explicit TextTool(QObject *parent = nullptr);
+
+    int id() const override;
+    bool isSelectable() const override;
+    bool isVector() const override;
+    ToolWorkType toolType() const override;
+
+    QString iconName() const override;
+    QString name() const override;
+    QString description() const override;
+
+    void processImage(
+            QPainter &painter,
+            const QVector<QPoint> &points,
+            const QColor &color,
+            const int thickness) override;
+
+    QString text() const;
+    void setText(const QString &text);
+    void setEditing(const bool editing);
+    QRect boundingRect(const QPoint &pos, const int thickness) const;
+
+    void onPressed() override;
+
+private:
+    QString m_text;
+    bool m_editing;
+
+    QFont font(const int thickness) const;
+};
+
+#endif // TEXTTOOL_H
@@ -20,6 +20,7 @@
 #include "circletool.h"
 #include "copytool.h"
 #include "exittool.h"
+#include "filltool.h"
 #include "imguruploadertool.h"
 #include "linetool.h"
 #include "markertool.h"
@@ -27,8 +28,11 @@
 #include "penciltool.h"
 #include "rectangletool.h"
 #include "savetool.h"
+#include "scrollcapturetool.h"
+#include "cliprecordertool.h"
 #include "selectiontool.h"
 #include "sizeindicatortool.h"
+#include "texttool.h"
 #include "undotool.h"
 
 ToolFactory::ToolFactory(QObject *parent) : QObject(parent)
@@ -84,6 +88,18 @@ CaptureTool* ToolFactory::CreateTool(
     case CaptureButton::TYPE_UNDO:
         tool = new UndoTool(parent);
         break;
+    case CaptureButton::TYPE_SCROLLCAPTURE:
+        tool = new ScrollCaptureTool(parent);
+        break;
+    case CaptureButton::TYPE_FILL:
+        tool = new FillTool(parent);
+        break;
+    case CaptureButton::TYPE_TEXT:
+        tool = new TextTool(parent);
+        break;
+    case CaptureButton::TYPE_CLIPRECORDER:
+        tool = new ClipRecorderTool(parent);
+        break;
     default:
         tool = nullptr;
         break;
@@ -190,6 +190,10 @@ static std::map<CaptureButton::ButtonType, int> buttonTypeOrder {
     { CaptureButton::TYPE_SAVE,              11 },
     { CaptureButton::TYPE_EXIT,              12 },
     { CaptureButton::TYPE_IMAGEUPLOADER,     13 },
+    { CaptureButton::TYPE_SCROLLCAPTURE,     14 },
+    { CaptureButton::TYPE_FILL,              15 },
+    { CaptureButton::TYPE_TEXT,              16 },
+    { CaptureButton::TYPE_CLIPRECORDER,      17 },
 };
 
 int CaptureButton::getPriorityByButton(CaptureButton::ButtonType b) {
@@ -213,4 +217,8 @@ QVector<CaptureButton::ButtonType> CaptureButton::iterableButtonTypes = {
     CaptureButton::TYPE_SAVE,
     CaptureButton::TYPE_EXIT,
     CaptureButton::TYPE_IMAGEUPLOADER,
+    CaptureButton::TYPE_SCROLLCAPTURE,
+    CaptureButton::TYPE_FILL,
+    CaptureButton::TYPE_TEXT,
+    CaptureButton::TYPE_CLIPRECORDER,
 };
@@ -48,6 +48,10 @@ public:
         TYPE_SAVE,
         TYPE_EXIT,
         TYPE_IMAGEUPLOADER,
+        TYPE_SCROLLCAPTURE,
+        TYPE_FILL,
+        TYPE_TEXT,
+        TYPE_CLIPRECORDER,
     };
 
     CaptureButton() = delete;
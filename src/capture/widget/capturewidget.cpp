@@ -31,6 +31,11 @@
 #include "src/utils/confighandler.h"
 #include "src/utils/systemnotification.h"
 #include "src/core/resourceexporter.h"
+#include "src/core/exportpipeline.h"
+#include "src/core/controller.h"
+#include "src/capture/workers/scrollcapture.h"
+#include "src/capture/workers/cliprecorder.h"
+#include "src/capture/tools/texttool.h"
 #include <QScreen>
 #include <QGuiApplication>
 #include <QApplication>
@@ -38,7 +43,7 @@
 #include <QPainter>
 #include <QPaintEvent>
 #include <QMouseEvent>
-#include <QBuffer>
+#include <QTimer>
 
 // CaptureWidget is the main component used to capture the screen. It contains an
 // are of selection with its respective buttons.
@@ -47,6 +52,8 @@ namespace {
 
 // size of the handlers at the corners of the selection
 const int HANDLE_SIZE = 9;
+// time without input before encoding the capture in advance
+const int SPECULATION_DELAY = 600;
 
 } // unnamed namespace
 
@@ -55,7 +62,9 @@ CaptureWidget::CaptureWidget(const uint id, const QString &forcedSavePath,
                              QWidget *parent) :
     QWidget(parent), m_screenshot(nullptr), m_mouseOverHandle(0),
     m_mouseIsClicked(false), m_rightClick(false), m_newSelection(false),
-    m_grabbing(false), m_captureDone(false), m_forcedSavePath(forcedSavePath),
+    m_grabbing(false), m_captureDone(false), m_generation(0),
+    m_speculationGeneration(0), m_captureHandedOver(false),
+    m_forcedSavePath(forcedSavePath),
     m_id(id), m_state(CaptureButton::TYPE_MOVESELECTION)
 {
     ConfigHandler config;
@@ -91,6 +100,11 @@ CaptureWidget::CaptureWidget(const uint id, const QString &forcedSavePath,
         this->close();
     }
     m_screenshot = new Screenshot(fullScreenshot, this);
+    QRect desktopGeometry;
+    for (QScreen *const screen : QGuiApplication::screens()) {
+        desktopGeometry = desktopGeometry.united(screen->geometry());
+    }
+    m_windowIndex.build(desktopGeometry, fullScreenshot.devicePixelRatio());
     QSize size = fullScreenshot.size();
     // we need to increase by 1 the size to reach to the end of the screen
     setGeometry(0 ,0 , size.width()+1, size.height()+1);
@@ -107,15 +121,21 @@ CaptureWidget::CaptureWidget(const uint id, const QString &forcedSavePath,
     auto geometry = QGuiApplication::primaryScreen()->geometry();
     m_notifierBox->move(geometry.left() +20, geometry.left() +20);
     m_notifierBox->hide();
+
+    m_idleTimer = new QTimer(this);
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(SPECULATION_DELAY);
+    connect(m_idleTimer, &QTimer::timeout, this, &CaptureWidget::speculate);
 }
 
 CaptureWidget::~CaptureWidget() {
+    // the id is 0 when nobody asked for the raw image, the encoding of
+    // the capture is done by the Controller in a worker thread
     if (m_captureDone) {
-        QByteArray byteArray;
-        QBuffer buffer(&byteArray);
-        this->pixmap().save(&buffer, "PNG");
-        Q_EMIT captureTaken(m_id, byteArray);
-    } else {
+        if (m_id != 0) {
+            Q_EMIT captureTaken(m_id, result());
+        }
+    } else if (!m_captureHandedOver) {
         Q_EMIT captureFailed(m_id);
     }
     ConfigHandler().setdrawThickness(m_thickness);
@@ -147,6 +167,7 @@ void CaptureWidget::updateButtons() {
 }
 
 QPixmap CaptureWidget::pixmap() {
+    commitText();
     if (m_selection.isNull()) { // copy full screen when no selection
         return m_screenshot->screenshot();
     } else {
@@ -154,6 +175,51 @@ QPixmap CaptureWidget::pixmap() {
     }
 }
 
+// capture exports the selection as a view of the screenshot, unlike
+// pixmap() it doesn't copy it
+QSharedPointer<ExportPipeline> CaptureWidget::capture() {
+    commitText();
+    const QPixmap screenshot = m_screenshot->screenshot();
+    const QRect area = m_selection.isNull() ?
+                screenshot.rect() : extendedSelection();
+    return ExportPipeline::forCrop(screenshot, area);
+}
+
+// result returns the final capture, always the same one so the raw output
+// shares the encodings of the other destinations
+QSharedPointer<ExportPipeline> CaptureWidget::result() {
+    if (!m_result) {
+        const bool current = m_speculation &&
+                m_speculationGeneration == m_generation;
+        m_result = current ? m_speculation : capture();
+    }
+    return m_result;
+}
+
+// speculate encodes the current capture while the user is idle, the
+// destinations use it if nothing changes
+void CaptureWidget::speculate() {
+    // capture() would commit the text being edited
+    if (m_captureDone || m_editedText ||
+            (m_speculation && m_speculationGeneration == m_generation))
+    {
+        return;
+    }
+    // an outdated encoding ends on its own, it owns what it uses
+    m_speculation = capture();
+    m_speculationGeneration = m_generation;
+    m_speculation->prefetch(true);
+}
+
+// markChanged outdates the capture encoded in advance, a new one is encoded
+// once the user is idle again
+void CaptureWidget::markChanged() {
+    ++m_generation;
+    if (!m_captureDone) {
+        m_idleTimer->start();
+    }
+}
+
 void CaptureWidget::paintEvent(QPaintEvent *) {
     QPainter painter(this);
 
@@ -164,7 +230,8 @@ void CaptureWidget::paintEvent(QPaintEvent *) {
         painter.drawPixmap(0, 0, m_screenshot->paintTemporalModification(
                                m_modifications.last()));
     } else {
-        painter.drawPixmap(0, 0, m_screenshot->screenshot());
+        painter.drawPixmap(0, 0, m_screenshot->rasterScreenshot());
+        m_screenshot->paintVectorModifications(painter);
     }
 
     QColor overlayColor(0, 0, 0, 190);
@@ -172,6 +239,11 @@ void CaptureWidget::paintEvent(QPaintEvent *) {
     QRect r = m_selection.normalized().adjusted(0, 0, -1, -1);
     QRegion grey(rect());
     grey = grey.subtracted(r);
+    // preview the window under the mouse while there is no selection
+    bool showHoveredWindow = m_selection.isNull() && !m_hoveredWindow.isNull();
+    if (showHoveredWindow) {
+        grey = grey.subtracted(m_hoveredWindow);
+    }
 
     painter.setClipRegion(grey);
     painter.drawRect(-1, -1, rect().width() + 1, rect().height() + 1);
@@ -207,6 +279,12 @@ void CaptureWidget::paintEvent(QPaintEvent *) {
         painter.drawText(helpRect, Qt::AlignCenter, helpTxt);
     }
 
+    if (showHoveredWindow) {
+        painter.setPen(m_uiColor);
+        painter.setBrush(Qt::NoBrush);
+        painter.drawRect(m_hoveredWindow.adjusted(0, 0, -1, -1));
+    }
+
     if (!m_selection.isNull()) {
         // paint selection rect
         painter.setPen(m_uiColor);
@@ -234,12 +312,22 @@ void CaptureWidget::mousePressEvent(QMouseEvent *e) {
     else if (e->button() == Qt::LeftButton)
     {
         m_showInitialMsg = false;
+        // a click out of the edited text finishes it
+        if (m_editedText) {
+            commitText();
+            return;
+        }
         m_mouseIsClicked = true;
         if (m_state != CaptureButton::TYPE_MOVESELECTION)
         {
             auto mod = new CaptureModification(m_state, e->pos(),
                                                m_colorPicker->drawColor(), m_thickness, this);
             m_modifications.append(mod);
+            markChanged();
+            if (m_state == CaptureButton::TYPE_TEXT) {
+                m_editedText = mod;
+                editedTextTool()->setEditing(true);
+            }
             return;
         }
         m_dragStartPoint = e->pos();
@@ -248,6 +336,7 @@ void CaptureWidget::mousePressEvent(QMouseEvent *e) {
         {
             m_newSelection = true;
             m_selection = QRect();
+            markChanged();
             m_buttonHandler->hide();
             update();
         }
@@ -269,6 +358,7 @@ void CaptureWidget::mouseMoveEvent(QMouseEvent *e)
         {
             m_buttonHandler->hide();
         }
+        markChanged();
         if (m_newSelection)
         {
             m_selection = QRect(m_dragStartPoint, m_mousePos).normalized();
@@ -348,6 +438,7 @@ void CaptureWidget::mouseMoveEvent(QMouseEvent *e)
     {
         // drawing with a tool
         m_modifications.last()->addPoint(e->pos());
+        markChanged();
         update();
         // hides the group of buttons under the mouse, if you leave
         if (m_buttonHandler->buttonsAreInside())
@@ -366,6 +457,11 @@ void CaptureWidget::mouseMoveEvent(QMouseEvent *e)
     {
         if (m_selection.isNull())
         {
+            QRect hovered = m_windowIndex.windowAt(e->pos());
+            if (hovered != m_hoveredWindow) {
+                m_hoveredWindow = hovered;
+                update();
+            }
             return;
         }
         bool found = false;
@@ -392,14 +488,34 @@ void CaptureWidget::mouseReleaseEvent(QMouseEvent *e)
     {
         m_colorPicker->hide();
         m_rightClick = false;
+        if (m_editedText) {
+            m_editedText->setColor(m_colorPicker->drawColor());
+            markChanged();
+            update(editedTextRect());
+        }
     // when we end the drawing of a modification in the capture we have to
     // register the last point and add the whole modification to the screenshot
     }
     else if (m_mouseIsClicked && m_state != CaptureButton::TYPE_MOVESELECTION)
     {
         m_screenshot->paintModification(m_modifications.last());
+        markChanged();
         update();
     }
+    else if (m_newSelection &&
+             (e->pos() - m_dragStartPoint).manhattanLength() <
+             QApplication::startDragDistance())
+    {
+        // a click without dragging selects the window under the mouse, the
+        // hovered one isn't tracked while there is a selection
+        const QRect window = m_windowIndex.windowAt(e->pos());
+        if (!window.isNull()) {
+            m_selection = window;
+            m_hoveredWindow = window;
+            markChanged();
+            update();
+        }
+    }
 
     if (!m_buttonHandler->isVisible() && !m_selection.isNull())
     {
@@ -415,27 +531,33 @@ void CaptureWidget::mouseReleaseEvent(QMouseEvent *e)
 }
 //zanshiwuyong
 void CaptureWidget::keyPressEvent(QKeyEvent *e) {
-    if (m_selection.isNull()) {
+    if (m_editedText) {
+        editText(e);
+    } else if (m_selection.isNull()) {
         return;
     } else if (e->key() == Qt::Key_Up
                && m_selection.top() > rect().top()) {
         m_selection.moveTop(m_selection.top()-1);
         m_buttonHandler->updatePosition(m_selection, rect());
+        markChanged();
         update();
     } else if (e->key() == Qt::Key_Down
                && m_selection.bottom() < rect().bottom()) {
         m_selection.moveBottom(m_selection.bottom()+1);
         m_buttonHandler->updatePosition(m_selection, rect());
+        markChanged();
         update();
     } else if (e->key() == Qt::Key_Left
                && m_selection.left() > rect().left()) {
         m_selection.moveLeft(m_selection.left()-1);
         m_buttonHandler->updatePosition(m_selection, rect());
+        markChanged();
         update();
     } else if (e->key() == Qt::Key_Right
                && m_selection.right() < rect().right()) {
         m_selection.moveRight(m_selection.right()+1);
         m_buttonHandler->updatePosition(m_selection, rect());
+        markChanged();
         update();
     }
 }
@@ -444,21 +566,108 @@ void CaptureWidget::wheelEvent(QWheelEvent *e) {
     m_thickness += e->delta() / 120;
     m_thickness = qBound(0, m_thickness, 100);
     m_notifierBox->showMessage(QString::number(m_thickness));
+    // the edited text changes its size without repainting the rest
+    if (m_editedText) {
+        QRect oldRect = editedTextRect();
+        m_editedText->setThickness(m_thickness);
+        markChanged();
+        update(oldRect.united(editedTextRect()));
+    }
+}
+
+// while a text is edited the keys without Control reach keyPressEvent
+// instead of triggering the shortcuts
+bool CaptureWidget::event(QEvent *e) {
+    if (e->type() == QEvent::ShortcutOverride && m_editedText) {
+        auto keyEvent = static_cast<QKeyEvent *>(e);
+        if (!(keyEvent->modifiers() & Qt::ControlModifier)) {
+            e->accept();
+            return true;
+        }
+    }
+    return QWidget::event(e);
 }
 
 bool CaptureWidget::undo() {
+    markChanged();
+    // undoing an empty edited text just drops it
+    if (m_editedText && editedTextTool()->text().isEmpty()) {
+        commitText();
+        return true;
+    }
+    commitText();
     bool itemRemoved = false;
     if (!m_modifications.isEmpty()) {
-        m_modifications.last()->deleteLater();
-        m_modifications.pop_back();
-        m_screenshot->overrideModifications(m_modifications);
+        CaptureModification *last = m_modifications.takeLast();
+        // vector modifications are not part of the screenshot pixels
+        if (last->tool()->isVector()) {
+            m_screenshot->removeVectorModification(last);
+        } else {
+            m_screenshot->overrideModifications(m_modifications);
+        }
+        last->deleteLater();
         update();
         itemRemoved = true;
     }
     return itemRemoved;
 }
 
+TextTool* CaptureWidget::editedTextTool() const {
+    return m_editedText ?
+                qobject_cast<TextTool *>(m_editedText->tool()) : nullptr;
+}
+
+QRect CaptureWidget::editedTextRect() const {
+    return editedTextTool()->boundingRect(m_editedText->points().first(),
+                                          m_editedText->thickness());
+}
+
+// editText updates the edited text and repaints just its area
+void CaptureWidget::editText(QKeyEvent *e) {
+    if (e->key() == Qt::Key_Escape) {
+        commitText();
+        return;
+    }
+    TextTool *tool = editedTextTool();
+    QString text = tool->text();
+    if (e->key() == Qt::Key_Backspace) {
+        int n = text.size() > 1 && text.at(text.size() - 1).isLowSurrogate() ?
+                    2 : 1;
+        text.chop(n);
+    } else if (e->key() == Qt::Key_Return || e->key() == Qt::Key_Enter) {
+        text.append('\n');
+    } else if (!e->text().isEmpty() && e->text().at(0).isPrint()) {
+        text.append(e->text());
+    } else {
+        return;
+    }
+    QRect oldRect = editedTextRect();
+    tool->setText(text);
+    markChanged();
+    update(oldRect.united(editedTextRect()));
+}
+
+// commitText finishes the edition of the text, empty texts are dropped
+void CaptureWidget::commitText() {
+    if (!m_editedText) {
+        return;
+    }
+    CaptureModification *mod = m_editedText;
+    m_editedText = nullptr;
+    TextTool *tool = qobject_cast<TextTool *>(mod->tool());
+    QRect r = tool->boundingRect(mod->points().first(), mod->thickness());
+    tool->setEditing(false);
+    markChanged();
+    if (tool->text().isEmpty()) {
+        m_modifications.removeOne(mod);
+        m_screenshot->removeVectorModification(mod);
+        mod->deleteLater();
+    }
+    update(r);
+}
+
 void CaptureWidget::setState(CaptureButton *b) {
+    commitText();
     CaptureButton::ButtonType t = b->buttonType();
     if (b->tool()->isSelectable()) {
         if (t != m_state) {
@@ -488,6 +697,7 @@ void CaptureWidget::handleButtonSignal(CaptureTool::Request r) {
     case CaptureTool::REQ_HIDE_SELECTION:
         m_newSelection = true;
         m_selection = QRect();
+        markChanged();
         updateCursor();
         break;
     case CaptureTool::REQ_SAVE_SCREENSHOT:
@@ -495,6 +705,7 @@ void CaptureWidget::handleButtonSignal(CaptureTool::Request r) {
         break;
     case CaptureTool::REQ_SELECT_ALL:
         m_selection = rect();
+        markChanged();
         break;
     case CaptureTool::REQ_TO_CLIPBOARD:
         copyScreenshot();
@@ -505,6 +716,12 @@ void CaptureWidget::handleButtonSignal(CaptureTool::Request r) {
     case CaptureTool::REQ_UPLOAD_TO_IMGUR:
         uploadToImgur();
         break;
+    case CaptureTool::REQ_SCROLL_CAPTURE:
+        scrollCapture();
+        break;
+    case CaptureTool::REQ_RECORD_CLIP:
+        recordClip();
+        break;
     case CaptureTool::REQ_MOVE_MODE:
         m_state = CaptureButton::TYPE_MOVESELECTION;
         if (m_lastPressedButton) {
@@ -518,6 +735,7 @@ void CaptureWidget::handleButtonSignal(CaptureTool::Request r) {
 }
 
 void CaptureWidget::leftResize() {
+    markChanged();
     if (!m_selection.isNull() && m_selection.right() > m_selection.left()) {
         m_selection.setRight(m_selection.right()-1);
         m_buttonHandler->updatePosition(m_selection, rect());
@@ -527,6 +745,7 @@ void CaptureWidget::leftResize() {
 }
 
 void CaptureWidget::rightResize() {
+    markChanged();
     if (!m_selection.isNull() && m_selection.right() < rect().right()) {
         m_selection.setRight(m_selection.right()+1);
         m_buttonHandler->updatePosition(m_selection, rect());
@@ -536,6 +755,7 @@ void CaptureWidget::rightResize() {
 }
 
 void CaptureWidget::upResize() {
+    markChanged();
     if (!m_selection.isNull() && m_selection.bottom() > m_selection.top()) {
         m_selection.setBottom(m_selection.bottom()-1);
         m_buttonHandler->updatePosition(m_selection, rect());
@@ -545,6 +765,7 @@ void CaptureWidget::upResize() {
 }
 
 void CaptureWidget::downResize() {
+    markChanged();
     if (!m_selection.isNull() && m_selection.bottom() < rect().bottom()) {
         m_selection.setBottom(m_selection.bottom()+1);
         m_buttonHandler->updatePosition(m_selection, rect());
@@ -628,30 +849,63 @@ QRegion CaptureWidget::handleMask() const {
 
 void CaptureWidget::copyScreenshot() {
     m_captureDone = true;
-    ResourceExporter().captureToClipboard(pixmap());
+    ResourceExporter(result()).captureToClipboard();
     close();
 }
 
 void CaptureWidget::saveScreenshot() {
     m_captureDone = true;
+    // the position of the selection for the filename pattern
+    QRect geometry = m_selection.isNull() ?
+                m_screenshot->baseScreenshot().rect() : extendedSelection();
     if (m_forcedSavePath.isEmpty()) {
-        ResourceExporter().captureToFileUi(pixmap());
+        ResourceExporter(result()).captureToFileUi(geometry);
     } else {
-        ResourceExporter().captureToFile(pixmap(), m_forcedSavePath);
+        ResourceExporter(result()).captureToFile(m_forcedSavePath, geometry);
     }
     close();
 }
 
 void CaptureWidget::uploadToImgur() {
     m_captureDone = true;
-    ResourceExporter().captureToImgur(pixmap());
+    ResourceExporter(result()).captureToImgur();
+    close();
+}
+
+// scrollCapture hands the selected area over to a ScrollCapture, which
+// reports the result of the capture instead of this widget
+void CaptureWidget::scrollCapture() {
+    QRect area = m_selection.isNull() ? rect() : m_selection.normalized();
+    auto w = new ScrollCapture(area, m_id, m_forcedSavePath);
+    auto controller = Controller::getInstance();
+    connect(w, &ScrollCapture::captureTaken,
+            controller, &Controller::encodeCapture);
+    connect(w, &ScrollCapture::captureFailed,
+            controller, &Controller::handleCaptureFailed);
+    m_captureHandedOver = true;
+    close();
+    w->start();
+}
+
+// recordClip hands the selected area over to a ClipRecorder, the last
+// frame of the clip is the result of the capture
+void CaptureWidget::recordClip() {
+    QRect area = m_selection.isNull() ? rect() : m_selection.normalized();
+    auto w = new ClipRecorder(area, m_id, m_forcedSavePath);
+    auto controller = Controller::getInstance();
+    connect(w, &ClipRecorder::captureTaken,
+            controller, &Controller::encodeCapture);
+    connect(w, &ClipRecorder::captureFailed,
+            controller, &Controller::handleCaptureFailed);
+    m_captureHandedOver = true;
     close();
+    w->start();
 }
 
 QRect CaptureWidget::extendedSelection() const {
     if (m_selection.isNull())
         return QRect();
-    auto devicePixelRatio = m_screenshot->screenshot().devicePixelRatio();
+    auto devicePixelRatio = m_screenshot->baseScreenshot().devicePixelRatio();
 
     return QRect(m_selection.left()   * devicePixelRatio,
                  m_selection.top()    * devicePixelRatio,
@@ -27,8 +27,10 @@
 #include "capturebutton.h"
 #include "src/capture/tools/capturetool.h"
 #include "buttonhandler.h"
+#include "src/utils/windowindex.h"
 #include <QWidget>
 #include <QPointer>
+#include <QSharedPointer>
 
 class QPaintEvent;
 class QResizeEvent;
@@ -39,6 +41,9 @@ class QNetworkReply;
 class ColorPicker;
 class Screenshot;
 class NotifierBox;
+class TextTool;
+class ExportPipeline;
+class QTimer;
 
 class CaptureWidget : public QWidget {
     Q_OBJECT
@@ -53,19 +58,22 @@ public:
     QPixmap pixmap();
 
 signals:
-    void captureTaken(uint id, QByteArray p);
+    void captureTaken(uint id, QSharedPointer<ExportPipeline> capture);
     void captureFailed(uint id);
 
 private slots:
     void copyScreenshot();
     void saveScreenshot();
     void uploadToImgur();
+    void scrollCapture();
+    void recordClip();
     bool undo();
 
     void leftResize();
     void rightResize();
     void upResize();
     void downResize();
+    void speculate();
 
     void setState(CaptureButton *);
     void handleButtonSignal(CaptureTool::Request r);
@@ -77,6 +85,7 @@ protected:
     void mouseReleaseEvent(QMouseEvent *);
     void keyPressEvent(QKeyEvent *);
     void wheelEvent(QWheelEvent *);
+    bool event(QEvent *);
 
     QRegion handleMask() const;
 
@@ -89,6 +98,9 @@ protected:
     QRect *m_mouseOverHandle;
     QRect m_selection;
     QRect m_selectionBeforeDrag;
+    // geometry of the visible windows and the one under the mouse
+    WindowIndex m_windowIndex;
+    QRect m_hoveredWindow;
     // utility flags
     bool m_mouseIsClicked;
     bool m_rightClick;
@@ -96,6 +108,16 @@ protected:
     bool m_grabbing;
     bool m_showInitialMsg;
     bool m_captureDone;
+    QSharedPointer<ExportPipeline> m_result;
+    // capture encoded while the user was idle, it is the result if nothing
+    // changed since then
+    QTimer *m_idleTimer;
+    QSharedPointer<ExportPipeline> m_speculation;
+    // bumped on every change of the selection or of the modifications, a
+    // speculation of an older generation is outdated
+    quint64 m_generation;
+    quint64 m_speculationGeneration;
+    bool m_captureHandedOver;
 
     const QString m_forcedSavePath;
 
@@ -119,7 +141,17 @@ private:
     void updateCursor();
 
     QRect extendedSelection() const;
+    QSharedPointer<ExportPipeline> capture();
+    QSharedPointer<ExportPipeline> result();
+    void markChanged();
     QVector<CaptureModification*> m_modifications;
+    // text modification receiving the typed keys
+    QPointer<CaptureModification> m_editedText;
+
+    TextTool* editedTextTool() const;
+    QRect editedTextRect() const;
+    void editText(QKeyEvent *e);
+    void commitText();
     QPointer<CaptureButton> m_sizeIndButton;
     QPointer<CaptureButton> m_lastPressedButton;
 
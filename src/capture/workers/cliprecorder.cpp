@@ -0,0 +1,291 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cliprecorder.h"
+#include "src/capture/workers/scrollcapture.h"
+#include "src/core/exportpipeline.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/filenamehandler.h"
+#include "src/utils/systemnotification.h"
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QScreen>
+#include <QTimer>
+#include <QLabel>
+#include <QPushButton>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QShortcut>
+#include <QStandardPaths>
+#include <QSaveFile>
+#include <QDir>
+#include <QThread>
+#include <QtConcurrent>
+
+// ClipRecorder grabs the selected area at the configured rate and saves the
+// last seconds as an animated GIF or APNG. Only the tiles which changed
+// since the previous frame are encoded, in the global thread pool, and the
+// encoded frames are kept in a bounded ring of key frame groups.
+
+namespace {
+
+// wait for the capture widget to disappear before the first grab
+const int START_DELAY = 250;
+// a key frame every second lets the ring drop the oldest frames
+const qint64 KEY_INTERVAL = 1000;
+// the encoded frames never take more memory than this
+const qint64 MAX_CLIP_BYTES = 64 * 1024 * 1024;
+const int TILE_SIZE = 16;
+
+} // unnamed namespace
+
+ClipRecorder::ClipRecorder(const QRect &area, const uint id,
+                           const QString &forcedSavePath, QWidget *parent) :
+    QWidget(parent), m_area(area), m_id(id),
+    m_forcedSavePath(forcedSavePath), m_finished(false),
+    m_encoder(ClipEncoder::FORMAT_GIF), m_hasher(TILE_SIZE), m_lastKey(0),
+    m_end(0), m_bytes(0), m_dropped(0)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("Clip Recorder"));
+    setWindowFlags(Qt::WindowStaysOnTopHint | Qt::Tool);
+
+    ConfigHandler config;
+    ClipEncoder::Format format;
+    if (ClipEncoder::parseFormat(config.clipFormatValue(), format)) {
+        m_encoder = ClipEncoder(format);
+    }
+    m_maxLength = config.clipLengthValue() * 1000;
+
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    m_timer->setInterval(1000 / config.clipFpsValue());
+    connect(m_timer, &QTimer::timeout, this, &ClipRecorder::grabFrame);
+
+    m_infoLabel = new QLabel(this);
+    QPushButton *doneButton = new QPushButton(tr("Done"), this);
+    QPushButton *cancelButton = new QPushButton(tr("Cancel"), this);
+    connect(doneButton, &QPushButton::clicked, this, &ClipRecorder::finish);
+    connect(cancelButton, &QPushButton::clicked, this, &ClipRecorder::close);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addWidget(doneButton);
+    buttonLayout->addWidget(cancelButton);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_infoLabel);
+    layout->addLayout(buttonLayout);
+    updateInfo();
+
+    new QShortcut(Qt::Key_Escape, this, SLOT(close()));
+    new QShortcut(Qt::Key_Return, this, SLOT(finish()));
+}
+
+ClipRecorder::~ClipRecorder() {
+    // the cancelled encodings are short, they must not outlive the watchers
+    for (QFutureWatcher<ClipEncoder::Frame> *watcher: m_pending) {
+        watcher->disconnect(this);
+        watcher->waitForFinished();
+    }
+    if (!m_finished) {
+        Q_EMIT captureFailed(m_id);
+    }
+}
+
+void ClipRecorder::start() {
+    adjustSize();
+    ScrollCapture::placeOutside(this, m_area);
+    show();
+    QTimer *delay = new QTimer(this);
+    delay->setSingleShot(true);
+    connect(delay, &QTimer::timeout, this, [this, delay](){
+        m_clock.start();
+        grabFrame();
+        m_timer->start();
+        delay->deleteLater();
+    });
+    delay->start(START_DELAY);
+}
+
+void ClipRecorder::grabFrame() {
+    // the pool is behind, skipping the grab keeps the memory bounded
+    if (m_pending.size() > QThread::idealThreadCount()) {
+        ++m_dropped;
+        return;
+    }
+    const qint64 timestamp = m_clock.elapsed();
+    QPixmap pixmap(QApplication::primaryScreen()->grabWindow(
+                       QApplication::desktop()->winId(),
+                       m_area.x(),
+                       m_area.y(),
+                       m_area.width(),
+                       m_area.height()));
+    const QImage frame = pixmap.toImage().convertToFormat(QImage::Format_RGB32);
+    if (frame.isNull()) {
+        return;
+    }
+    const QVector<quint64> hashes = m_hasher.hashTiles(frame);
+
+    QImage previous = m_lastFrame;
+    QRect rect;
+    if (previous.size() != frame.size() ||
+            timestamp - m_lastKey >= KEY_INTERVAL)
+    {
+        previous = QImage();
+        rect = frame.rect();
+        m_lastKey = timestamp;
+    } else {
+        rect = dirtyRect(hashes, frame.size());
+        if (rect.isEmpty()) {
+            return;
+        }
+    }
+    m_lastFrame = frame;
+    m_lastHashes = hashes;
+
+    const ClipEncoder encoder = m_encoder;
+    auto watcher = new QFutureWatcher<ClipEncoder::Frame>(this);
+    connect(watcher, &QFutureWatcher<ClipEncoder::Frame>::finished,
+            this, &ClipRecorder::handleEncoded);
+    m_pending.append(watcher);
+    watcher->setFuture(QtConcurrent::run([=]() {
+        return encoder.encodeFrame(frame, previous, rect, timestamp);
+    }));
+}
+
+// handleEncoded moves the finished encodings to the ring keeping the order
+// of the frames, a frame which finishes early waits for the previous ones
+void ClipRecorder::handleEncoded() {
+    while (!m_pending.isEmpty() && m_pending.first()->isFinished()) {
+        QFutureWatcher<ClipEncoder::Frame> *watcher = m_pending.takeFirst();
+        const ClipEncoder::Frame frame = watcher->result();
+        watcher->deleteLater();
+        m_frames.append(frame);
+        m_bytes += frame.data.size();
+    }
+    trimFrames();
+    updateInfo();
+    if (m_finished && m_pending.isEmpty()) {
+        save();
+    }
+}
+
+void ClipRecorder::finish() {
+    if (m_finished) {
+        return;
+    }
+    m_timer->stop();
+    hide();
+    m_end = m_clock.isValid() ? m_clock.elapsed() : 0;
+    m_finished = true;
+    if (m_pending.isEmpty()) {
+        save();
+    }
+}
+
+// dirtyRect returns the box of the tiles which changed since the last frame
+QRect ClipRecorder::dirtyRect(const QVector<quint64> &hashes,
+                              const QSize &size) const
+{
+    QRect res;
+    for (int i = 0; i < hashes.size(); ++i) {
+        if (hashes.at(i) != m_lastHashes.at(i)) {
+            res = res.united(m_hasher.tileRect(i, size));
+        }
+    }
+    return res;
+}
+
+// trimFrames drops whole groups of frames from the front, the clip always
+// starts with a key frame
+void ClipRecorder::trimFrames() {
+    while (m_frames.size() > 1) {
+        const qint64 length = m_frames.last().timestamp -
+                m_frames.first().timestamp;
+        if (length <= m_maxLength && m_bytes <= MAX_CLIP_BYTES) {
+            break;
+        }
+        int nextKey = 1;
+        while (nextKey < m_frames.size() && !m_frames.at(nextKey).key) {
+            ++nextKey;
+        }
+        if (nextKey == m_frames.size()) {
+            break;
+        }
+        for (int i = 0; i < nextKey; ++i) {
+            m_bytes -= m_frames.takeFirst().data.size();
+        }
+    }
+}
+
+void ClipRecorder::updateInfo() {
+    qint64 length = m_frames.isEmpty() ? 0 :
+            m_frames.last().timestamp - m_frames.first().timestamp;
+    QString text = tr("Recording the selection\n%1 s, %2 KiB")
+            .arg(length / 1000.0, 0, 'f', 1).arg(m_bytes / 1024);
+    if (m_dropped > 0) {
+        text += tr("\n%1 frames dropped").arg(m_dropped);
+    }
+    m_infoLabel->setText(text);
+}
+
+// save joins the frames and writes the clip in a worker thread
+void ClipRecorder::save() {
+    if (m_frames.isEmpty()) {
+        Q_EMIT captureFailed(m_id);
+        close();
+        return;
+    }
+    QString directory = m_forcedSavePath;
+    if (directory.isEmpty()) {
+        directory = ConfigHandler().savePathValue();
+    }
+    if (directory.isEmpty() || !QDir(directory).exists()) {
+        directory = QStandardPaths::writableLocation(
+                    QStandardPaths::PicturesLocation);
+    }
+    const QString suffix = m_encoder.suffix();
+    const QString path = FileNameHandler().generateAbsolutePath(
+                directory, m_area, suffix) + suffix;
+
+    const ClipEncoder encoder = m_encoder;
+    const QSize size = m_lastFrame.size();
+    const QList<ClipEncoder::Frame> frames = m_frames;
+    const qint64 end = qMax(m_end, m_frames.last().timestamp);
+    auto watcher = new QFutureWatcher<bool>();
+    connect(watcher, &QFutureWatcher<bool>::finished, [watcher, path](){
+        SystemNotification().sendMessage(watcher->result() ?
+                    QObject::tr("Clip saved as ") + path :
+                    QObject::tr("Error trying to save as ") + path);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([=]() {
+        const QByteArray data = encoder.assemble(size, frames, end);
+        QSaveFile file(path);
+        if (data.isEmpty() || !file.open(QIODevice::WriteOnly) ||
+                file.write(data) != data.size())
+        {
+            return false;
+        }
+        return file.commit();
+    }));
+
+    if (m_id != 0) {
+        QSharedPointer<ExportPipeline> capture(new ExportPipeline(m_lastFrame));
+        Q_EMIT captureTaken(m_id, capture);
+    }
+    close();
+}
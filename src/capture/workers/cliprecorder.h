@@ -0,0 +1,82 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CLIPRECORDER_H
+#define CLIPRECORDER_H
+
+#include "src/utils/clipencoder.h"
+#include "src/utils/tilehasher.h"
+#include <QWidget>
+#include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+class QLabel;
+class QTimer;
+class ExportPipeline;
+
+class ClipRecorder : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ClipRecorder(const QRect &area,
+                          const uint id = 0,
+                          const QString &forcedSavePath = QString(),
+                          QWidget *parent = nullptr);
+    ~ClipRecorder();
+
+    void start();
+
+signals:
+    void captureTaken(uint id, QSharedPointer<ExportPipeline> capture);
+    void captureFailed(uint id);
+
+private slots:
+    void grabFrame();
+    void handleEncoded();
+    void finish();
+
+private:
+    QRect m_area;
+    uint m_id;
+    const QString m_forcedSavePath;
+    bool m_finished;
+
+    ClipEncoder m_encoder;
+    qint64 m_maxLength;
+    TileHasher m_hasher;
+    QVector<quint64> m_lastHashes;
+    QImage m_lastFrame;
+    qint64 m_lastKey;
+    qint64 m_end;
+    QElapsedTimer m_clock;
+    // encodings in the pool, in the order of the frames
+    QList<QFutureWatcher<ClipEncoder::Frame> *> m_pending;
+    QList<ClipEncoder::Frame> m_frames;
+    qint64 m_bytes;
+    int m_dropped;
+
+    QTimer *m_timer;
+    QLabel *m_infoLabel;
+
+    QRect dirtyRect(const QVector<quint64> &hashes, const QSize &size) const;
+    void trimFrames();
+    void updateInfo();
+    void save();
+};
+
+#endif // CLIPRECORDER_H
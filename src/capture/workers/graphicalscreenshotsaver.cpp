@@ -19,6 +19,7 @@
 #include "src/utils/confighandler.h"
 #include "src/utils/systemnotification.h"
 #include "src/utils/filenamehandler.h"
+#include "src/utils/pngencoder.h"
 #include <QFileDialog>
 #include <QImageWriter>
 #include <QMessageBox>
@@ -31,8 +32,10 @@
  */
 
 GraphicalScreenshotSaver::GraphicalScreenshotSaver(const QPixmap &capture,
+                                                   const QRect &geometry,
                                                    QWidget *parent) :
-    QWidget(parent), m_pixmap(capture)
+    QWidget(parent), m_pixmap(capture),
+    m_geometry(geometry.isNull() ? capture.rect() : geometry)
 {
     setAttribute(Qt::WA_DeleteOnClose);
     setWindowTitle(QObject::tr("Save As"));
@@ -51,7 +54,7 @@ void GraphicalScreenshotSaver::initFileDialog() {
     m_fileDialog->setFileMode(QFileDialog::AnyFile);
     m_fileDialog->setAcceptMode(QFileDialog::AcceptSave);
     QString fileName, directory;
-    FileNameHandler().absoluteSavePath(directory, fileName);
+    FileNameHandler().absoluteSavePath(directory, fileName, m_geometry);
     m_fileDialog->selectFile(fileName);
     m_fileDialog->setDirectory(directory);
 
@@ -80,10 +83,16 @@ void GraphicalScreenshotSaver::showErrorMessage(const QString &msg) {
 void GraphicalScreenshotSaver::checkSaveAcepted() {
     m_fileDialog->show();
     QString path = m_fileDialog->selectedFiles().first();
-    bool ok = m_pixmap.save(path);
+    // other formats chosen in the dialog are still written by Qt
+    bool ok = path.endsWith(".png", Qt::CaseInsensitive) ?
+                PngEncoder().save(m_pixmap.toImage(), path) :
+                m_pixmap.save(path);
     if (ok) {
+        FileNameHandler().reserveSavePath(path);
         QString pathNoFile = path.left(path.lastIndexOf("/"));
-        ConfigHandler().setSavePath(pathNoFile);
+        ConfigHandler config;
+        config.setSavePath(pathNoFile);
+        config.setLastCapturePath(path);
         QString msg = QObject::tr("Capture saved as ") + path;
         SystemNotification().sendMessage(msg);
         close();
@@ -28,10 +28,12 @@ class GraphicalScreenshotSaver : public QWidget
     Q_OBJECT
 public:
     explicit GraphicalScreenshotSaver(const QPixmap &capture,
+                                      const QRect &geometry = QRect(),
                                       QWidget *parent = nullptr);
 
 private:
     QPixmap m_pixmap;
+    QRect m_geometry;
     QFileDialog *m_fileDialog;
     QVBoxLayout *m_layout;
 
@@ -19,6 +19,7 @@
 // /src/Gui/KSImageWidget.cpp commit cbbd6d45f6426ccbf1a82b15fdf98613ccccbbe9
 
 #include "imagelabel.h"
+#include "src/utils/mipmapcache.h"
 
 ImageLabel::ImageLabel(QWidget *parent):
     QLabel(parent), m_pixmap(QPixmap())
@@ -45,8 +46,9 @@ void ImageLabel::setScreenshot(const QPixmap &pixmap) {
 
 void ImageLabel::setScaledPixmap() {
     const qreal scale = qApp->devicePixelRatio();
-    QPixmap scaledPixmap = m_pixmap.scaled(size() * scale, Qt::KeepAspectRatio,
-                                           Qt::SmoothTransformation);
+    // the nearest level of the mipmap is scaled instead of the capture
+    QPixmap scaledPixmap = MipmapCache::getInstance()->scaled(
+                m_pixmap, size() * scale, Qt::KeepAspectRatio);
     scaledPixmap.setDevicePixelRatio(scale);
     setPixmap(scaledPixmap);
 }
@@ -22,7 +22,11 @@
 #include "src/capture/workers/imgur/imagelabel.h"
 #include "src/capture/workers/imgur/notificationwidget.h"
 #include "src/utils/confighandler.h"
+#include "src/utils/encoderselector.h"
+#include "src/utils/mipmapcache.h"
+#include "src/utils/clipboardmimedata.h"
 #include <QApplication>
+#include <QFutureWatcher>
 #include <QClipboard>
 #include <QDesktopServices>
 #include <QShortcut>
@@ -32,15 +36,16 @@
 #include <QPushButton>
 #include <QDrag>
 #include <QMimeData>
-#include <QBuffer>
 #include <QUrlQuery>
 #include <QNetworkRequest>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QTimer>
 
-ImgurUploader::ImgurUploader(const QPixmap &capture, QWidget *parent) :
-    QWidget(parent), m_pixmap(capture)
+ImgurUploader::ImgurUploader(const QPixmap &p,
+                             const QSharedPointer<ExportPipeline> &capture,
+                             QWidget *parent) :
+    QWidget(parent), m_pixmap(p), m_capture(capture)
 {
     setWindowTitle(tr("Upload to Imgur"));
 
@@ -86,15 +91,28 @@ void ImgurUploader::startDrag() {
 
     QDrag *dragHandler = new QDrag(this);
     dragHandler->setMimeData(mimeData);
-    dragHandler->setPixmap(m_pixmap.scaled(256, 256, Qt::KeepAspectRatioByExpanding,
-                                           Qt::SmoothTransformation));
+    dragHandler->setPixmap(MipmapCache::getInstance()->scaled(
+                               m_pixmap, QSize(256, 256),
+                               Qt::KeepAspectRatioByExpanding));
     dragHandler->exec();
 }
 
+// upload waits for the encoding without blocking the window, it can be
+// shared with the other destinations of the capture
 void ImgurUploader::upload() {
-    QByteArray byteArray;
-    QBuffer buffer(&byteArray);
-    m_pixmap.save(&buffer, "PNG");
+    // imgur doesn't keep WebP images, they are converted
+    EncoderSelector::Choice choice = m_capture->choice(false);
+    auto watcher = new QFutureWatcher<ExportPipeline::Encoded>(this);
+    connect(watcher, &QFutureWatcher<ExportPipeline::Encoded>::finished,
+            this, [this, watcher]()
+    {
+        watcher->deleteLater();
+        post(watcher->result().data);
+    });
+    watcher->setFuture(m_capture->encoding(choice));
+}
+
+void ImgurUploader::post(const QByteArray &byteArray) {
 
     QUrlQuery urlQuery;
     urlQuery.addQueryItem("title", "flameshot_screenshot");
@@ -155,7 +173,7 @@ void ImgurUploader::copyURL() {
 }
 
 void ImgurUploader::copyImage() {
-    QApplication::clipboard()->setPixmap(m_pixmap);
+    ClipboardMimeData::copyToClipboard(m_capture);
     m_notification->showMessage(tr("Screenshot copied to clipboard."));
 }
 
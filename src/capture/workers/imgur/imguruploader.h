@@ -18,8 +18,10 @@
 #ifndef IMGURUPLOADER_H
 #define IMGURUPLOADER_H
 
+#include "src/core/exportpipeline.h"
 #include <QWidget>
 #include <QUrl>
+#include <QSharedPointer>
 
 class QNetworkReply;
 class QNetworkAccessManager;
@@ -35,7 +37,9 @@ class ImgurUploader : public QWidget
 {
     Q_OBJECT
 public:
-    explicit ImgurUploader(const QPixmap &p, QWidget *parent = nullptr);
+    explicit ImgurUploader(const QPixmap &p,
+                           const QSharedPointer<ExportPipeline> &capture,
+                           QWidget *parent = nullptr);
 
 private slots:
     void handleReply(QNetworkReply *reply);
@@ -47,6 +51,7 @@ private slots:
 
 private:
     QPixmap m_pixmap;
+    QSharedPointer<ExportPipeline> m_capture;
     QNetworkAccessManager *m_NetworkAM;
 
     QVBoxLayout *m_vLayout;
@@ -62,6 +67,7 @@ private:
     NotificationWidget *m_notification;
 
     void upload();
+    void post(const QByteArray &byteArray);
     void onUploadOk();
 };
 
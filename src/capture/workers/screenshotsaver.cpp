@@ -16,10 +16,9 @@
 //     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "screenshotsaver.h"
-#include "src/utils/systemnotification.h"
 #include "src/utils/filenamehandler.h"
-#include "src/utils/confighandler.h"
-#include <QClipboard>
+#include "src/utils/savequeue.h"
+#include "src/utils/clipboardmimedata.h"
 #include <QApplication>
 #include <QMessageBox>
 
@@ -27,24 +26,25 @@ ScreenshotSaver::ScreenshotSaver()
 {
 }
 
-void ScreenshotSaver::saveToClipboard(const QPixmap &capture) {
-    QApplication::clipboard()->setPixmap(capture);
+void ScreenshotSaver::saveToClipboard(
+        const QSharedPointer<ExportPipeline> &capture)
+{
+    ClipboardMimeData::copyToClipboard(capture);
 }
 
-void ScreenshotSaver::saveToFilesystem(const QPixmap &capture,
-                                       const QString &path)
+// saveToFilesystem uses the geometry in the filename pattern, when it
+// isn't known the capture covers the whole desktop
+void ScreenshotSaver::saveToFilesystem(
+        const QSharedPointer<ExportPipeline> &capture, const QString &path,
+        const QRect &geometry)
 {
-    QString completePath = FileNameHandler().generateAbsolutePath(path);
+    QRect area = geometry.isNull() ? capture->image().rect() : geometry;
+    // the format depends on the content, the queue chooses it in its thread
+    // and changes the suffix of the file if it isn't PNG
+    QString completePath = FileNameHandler().generateAbsolutePath(path, area);
     completePath += ".png";
-    bool ok = capture.save(completePath);
-    QString saveMessage;
-    if (ok) {
-        ConfigHandler().setSavePath(path);
-        saveMessage = QObject::tr("Capture saved as ") + completePath;
-    } else {
-        saveMessage = QObject::tr("Error trying to save as ") + completePath;
-    }
-    SystemNotification().sendMessage(saveMessage);
+    // the queue writes the file and notifies the result
+    SaveQueue::getInstance()->enqueue(capture, completePath);
 }
 
 
@@ -18,16 +18,20 @@
 #ifndef SCREENSHOTSAVER_H
 #define SCREENSHOTSAVER_H
 
-class QPixmap;
+#include "src/core/exportpipeline.h"
+#include <QSharedPointer>
+
 class QString;
+class QRect;
 
 class ScreenshotSaver
 {
 public:
     ScreenshotSaver();
 
-    void saveToClipboard(const QPixmap &capture);
-    void saveToFilesystem(const QPixmap &capture, const QString &path);
+    void saveToClipboard(const QSharedPointer<ExportPipeline> &capture);
+    void saveToFilesystem(const QSharedPointer<ExportPipeline> &capture,
+                          const QString &path, const QRect &geometry);
 
 };
 
@@ -0,0 +1,239 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "scrollcapture.h"
+#include "src/core/resourceexporter.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/filenamehandler.h"
+#include "src/utils/pngencoder.h"
+#include "src/utils/systemnotification.h"
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QScreen>
+#include <QTimer>
+#include <QLabel>
+#include <QPushButton>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QShortcut>
+#include <QSaveFile>
+#include <QDir>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+// ScrollCapture grabs the selected area periodically while the user scrolls
+// its content and joins the frames in a single tall capture.
+
+namespace {
+
+// time between grabs in milliseconds
+const int GRAB_INTERVAL = 100;
+// wait for the capture widget to disappear before the first grab
+const int START_DELAY = 250;
+// space between the area and the control window
+const int MARGIN = 10;
+
+} // unnamed namespace
+
+ScrollCapture::ScrollCapture(const QRect &area, const uint id,
+                             const QString &forcedSavePath, QWidget *parent) :
+    QWidget(parent), m_area(area), m_id(id),
+    m_forcedSavePath(forcedSavePath), m_finished(false),
+    m_discontinuities(0)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(tr("Scrolling Capture"));
+    setWindowFlags(Qt::WindowStaysOnTopHint | Qt::Tool);
+
+    m_timer = new QTimer(this);
+    m_timer->setInterval(GRAB_INTERVAL);
+    connect(m_timer, &QTimer::timeout, this, &ScrollCapture::grabFrame);
+
+    m_infoLabel = new QLabel(tr("Scroll the content of the selection"), this);
+    QPushButton *doneButton = new QPushButton(tr("Done"), this);
+    QPushButton *cancelButton = new QPushButton(tr("Cancel"), this);
+    connect(doneButton, &QPushButton::clicked, this, &ScrollCapture::finish);
+    connect(cancelButton, &QPushButton::clicked, this, &ScrollCapture::close);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addWidget(doneButton);
+    buttonLayout->addWidget(cancelButton);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_infoLabel);
+    layout->addLayout(buttonLayout);
+
+    new QShortcut(Qt::Key_Escape, this, SLOT(close()));
+    new QShortcut(Qt::Key_Return, this, SLOT(finish()));
+}
+
+ScrollCapture::~ScrollCapture() {
+    if (!m_finished) {
+        Q_EMIT captureFailed(m_id);
+    }
+}
+
+void ScrollCapture::start() {
+    adjustSize();
+    placeOutside(this, m_area);
+    show();
+    QTimer *delay = new QTimer(this);
+    delay->setSingleShot(true);
+    connect(delay, &QTimer::timeout, this, [this, delay](){
+        grabFrame();
+        m_timer->start();
+        delay->deleteLater();
+    });
+    delay->start(START_DELAY);
+}
+
+void ScrollCapture::grabFrame() {
+    QPixmap frame(QApplication::primaryScreen()->grabWindow(
+                      QApplication::desktop()->winId(),
+                      m_area.x(),
+                      m_area.y(),
+                      m_area.width(),
+                      m_area.height()));
+    switch (m_stitcher.append(frame.toImage())) {
+    case ImageStitcher::APPEND_NOTHING:
+        return;
+    case ImageStitcher::APPEND_DISCONTINUITY:
+        ++m_discontinuities;
+        break;
+    default:
+        break;
+    }
+    QString text = tr("Scroll the content of the selection\n"
+                      "%1 px captured").arg(m_stitcher.height());
+    if (m_discontinuities > 0) {
+        text += tr("\nScrolled too fast %1 times, some content may be "
+                   "missing. Scroll slower").arg(m_discontinuities);
+    }
+    m_infoLabel->setText(text);
+}
+
+void ScrollCapture::finish() {
+    if (m_finished) {
+        return;
+    }
+    m_timer->stop();
+    hide();
+    grabFrame();
+    m_finished = true;
+
+    if (m_stitcher.height() == 0) {
+        Q_EMIT captureFailed(m_id);
+        close();
+        return;
+    }
+    if (m_stitcher.isSpilled()) {
+        saveSpilled();
+        return;
+    }
+    const QImage result = m_stitcher.result();
+    if (result.isNull()) {
+        Q_EMIT captureFailed(m_id);
+        close();
+        return;
+    }
+    // the tall image is encoded as it is, without a pixmap copy
+    QSharedPointer<ExportPipeline> capture(new ExportPipeline(result));
+    if (m_forcedSavePath.isEmpty()) {
+        ResourceExporter(capture).captureToFileUi();
+    } else {
+        ResourceExporter(capture).captureToFile(m_forcedSavePath);
+    }
+    if (m_id != 0) {
+        Q_EMIT captureTaken(m_id, capture);
+    }
+    close();
+}
+
+// saveSpilled streams a capture which didn't fit in memory to a file, a
+// strip of rows at a time, without the preview of the save dialog
+void ScrollCapture::saveSpilled() {
+    QString directory = m_forcedSavePath;
+    if (directory.isEmpty()) {
+        directory = ConfigHandler().savePathValue();
+    }
+    if (directory.isEmpty() || !QDir(directory).exists()) {
+        directory = QStandardPaths::writableLocation(
+                    QStandardPaths::PicturesLocation);
+    }
+    const QString path = FileNameHandler().generateAbsolutePath(
+                directory, m_area) + ".png";
+
+    ImageStitcher *stitcher = &m_stitcher;
+    auto watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this,
+            [this, watcher, path]()
+    {
+        const bool ok = watcher->result();
+        SystemNotification().sendMessage(ok ?
+                    tr("Capture saved as ") + path :
+                    tr("Error trying to save as ") + path);
+        if (!ok) {
+            Q_EMIT captureFailed(m_id);
+        } else if (m_id != 0) {
+            // the caller asked for the whole image
+            QSharedPointer<ExportPipeline> capture(
+                        new ExportPipeline(m_stitcher.result()));
+            Q_EMIT captureTaken(m_id, capture);
+        }
+        close();
+    });
+    watcher->setFuture(QtConcurrent::run([stitcher, path]() {
+        auto strip = [stitcher](const int first, const int rows) {
+            return first > 0 ? stitcher->rows(first - 1, rows + 1) :
+                               stitcher->rows(first, rows);
+        };
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        if (!PngEncoder().writeStrips(
+                    QSize(stitcher->width(), stitcher->height()), strip,
+                    &file))
+        {
+            file.cancelWriting();
+            return false;
+        }
+        return file.commit();
+    }));
+}
+
+// placeOutside moves the window next to the captured area, it would
+// appear in the frames otherwise
+void ScrollCapture::placeOutside(QWidget *window, const QRect &area) {
+    QRect screen = QApplication::desktop()->availableGeometry(area.center());
+    QRect r = window->frameGeometry();
+    QVector<QPoint> candidates = {
+        QPoint(area.center().x() - r.width() / 2, area.bottom() + MARGIN),
+        QPoint(area.center().x() - r.width() / 2,
+               area.top() - MARGIN - r.height()),
+        QPoint(area.right() + MARGIN, area.center().y() - r.height() / 2),
+        QPoint(area.left() - MARGIN - r.width(),
+               area.center().y() - r.height() / 2),
+    };
+    for (const QPoint &p: candidates) {
+        r.moveTopLeft(p);
+        if (screen.contains(r)) {
+            window->move(p);
+            return;
+        }
+    }
+    window->move(screen.topLeft());
+}
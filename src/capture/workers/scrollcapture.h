@@ -0,0 +1,66 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SCROLLCAPTURE_H
+#define SCROLLCAPTURE_H
+
+#include "src/utils/imagestitcher.h"
+#include <QWidget>
+#include <QSharedPointer>
+
+class QLabel;
+class QTimer;
+class ExportPipeline;
+
+class ScrollCapture : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ScrollCapture(const QRect &area,
+                           const uint id = 0,
+                           const QString &forcedSavePath = QString(),
+                           QWidget *parent = nullptr);
+    ~ScrollCapture();
+
+    void start();
+
+    static void placeOutside(QWidget *window, const QRect &area);
+
+signals:
+    void captureTaken(uint id, QSharedPointer<ExportPipeline> capture);
+    void captureFailed(uint id);
+
+private slots:
+    void grabFrame();
+    void finish();
+
+private:
+    QRect m_area;
+    uint m_id;
+    const QString m_forcedSavePath;
+    bool m_finished;
+    // frames added without finding the scroll offset
+    int m_discontinuities;
+
+    ImageStitcher m_stitcher;
+    QTimer *m_timer;
+    QLabel *m_infoLabel;
+
+    void saveSpilled();
+};
+
+#endif // SCROLLCAPTURE_H
@@ -65,4 +65,7 @@ QMap<QString, QString> StrftimeChooserWidget::m_buttonData {
     { QT_TR_NOOP("Second (00-59)"),         "%S"},
     { QT_TR_NOOP("Full Date (%m/%d/%y)"),   "%D"},
     { QT_TR_NOOP("Full Date (%Y-%m-%d)"),   "%F"},
+    { QT_TR_NOOP("Sequence (1, 2, 3...)"),  "%{seq}"},
+    { QT_TR_NOOP("Size (WxH)"),             "%{size}"},
+    { QT_TR_NOOP("Geometry (WxH+X+Y)"),     "%{geometry}"},
 };
@@ -0,0 +1,192 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "burstcapture.h"
+#include "src/utils/screengrabber.h"
+#include "src/utils/pngencoder.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/filenamehandler.h"
+#include "src/utils/systemnotification.h"
+#include <QTimer>
+#include <QPixmap>
+#include <QDir>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <cstring>
+
+// BurstCapture grabs frames at a fixed interval into a ring of images which
+// are allocated once, with the first frame, and then overwritten in place.
+// Nothing is encoded while grabbing; a flush hands the frames grabbed since
+// the previous flush to the thread pool and saves them as numbered PNGs in
+// a new directory named like a screenshot.
+// The ring and a flush share the images, a slot overwritten while its frame
+// is still being encoded gets a new buffer instead of corrupting the file.
+// Without @ring the burst ends after the given number of frames, otherwise
+// it keeps the last ones until stop.
+
+BurstCapture::BurstCapture(const uint id, const QRect &area, const int frames,
+                           const int interval, const bool ring,
+                           const QString &path, QObject *parent) :
+    QObject(parent), m_id(id), m_area(area), m_interval(qMax(interval, 1)),
+    m_ring(ring), m_directory(path), m_slots(qMax(frames, 1)), m_frames(0),
+    m_dropped(0), m_unflushed(0), m_lastGrab(0), m_flushAgain(false),
+    m_stopping(false)
+{
+    if (m_directory.isEmpty()) {
+        m_directory = ConfigHandler().savePathValue();
+    }
+    if (m_directory.isEmpty() || !QDir(m_directory).exists()) {
+        m_directory = QStandardPaths::writableLocation(
+                    QStandardPaths::PicturesLocation);
+    }
+    m_writer = new QFutureWatcher<void>(this);
+    connect(m_writer, &QFutureWatcher<void>::finished,
+            this, &BurstCapture::handleFlushed);
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &BurstCapture::grabFrame);
+    m_clock.start();
+    m_timer->start(m_interval);
+}
+
+uint BurstCapture::id() const {
+    return m_id;
+}
+
+void BurstCapture::grabFrame() {
+    if (m_stopping) {
+        return;
+    }
+    // the ticks the event loop missed are frames lost, not delayed
+    const qint64 now = m_clock.elapsed();
+    if (m_frames > 0) {
+        const qint64 late = (now - m_lastGrab - m_interval / 2) / m_interval;
+        if (late > 0) {
+            m_dropped += late;
+        }
+    }
+    m_lastGrab = now;
+
+    bool ok = true;
+    ScreenGrabber grabber;
+    QPixmap p = m_area.isEmpty() ? grabber.grabEntireDesktop(ok) :
+                                   grabber.grabArea(m_area, ok);
+    if (!ok) {
+        SystemNotification().sendMessage(tr("Unable to capture screen"));
+        stop();
+        return;
+    }
+    QImage frame = p.toImage();
+    if (frame.format() != QImage::Format_RGB32) {
+        frame = frame.convertToFormat(QImage::Format_RGB32);
+    }
+
+    Slot &slot = m_slots[m_frames % m_slots.size()];
+    if (slot.image.size() != frame.size()) {
+        // the first frame, or the screens changed
+        for (Slot &s: m_slots) {
+            s.image = QImage(frame.size(), QImage::Format_RGB32);
+        }
+    }
+    const int rowBytes = frame.width() * 4;
+    uchar *bits = slot.image.bits();
+    const int bytesPerLine = slot.image.bytesPerLine();
+    for (int y = 0; y < frame.height(); ++y) {
+        std::memcpy(bits + y * bytesPerLine, frame.constScanLine(y), rowBytes);
+    }
+    slot.sequence = m_frames++;
+
+    if (!m_ring && m_frames == static_cast<quint32>(m_slots.size())) {
+        stop();
+    }
+}
+
+// flush saves the frames still in the ring which weren't saved by a
+// previous flush, a flush during another one runs when it ends
+void BurstCapture::flush() {
+    if (isFlushing()) {
+        m_flushAgain = true;
+        return;
+    }
+    const quint32 size = m_slots.size();
+    quint32 first = m_frames > size ? m_frames - size : 0;
+    first = qMax(first, m_unflushed);
+    if (first == m_frames) {
+        if (m_stopping) {
+            Q_EMIT finished(m_id, m_frames, m_dropped);
+            deleteLater();
+        }
+        return;
+    }
+    // every burst saves its frames in a directory of its own, the name is
+    // reserved like the one of a screenshot so no burst overwrites another
+    if (m_frameDirectory.isEmpty()) {
+        m_frameDirectory = FileNameHandler().generateAbsolutePath(
+                    m_directory, m_area, QString());
+        QDir().mkpath(m_frameDirectory);
+    }
+    const QDir frameDirectory(m_frameDirectory);
+    for (quint32 seq = first; seq < m_frames; ++seq) {
+        const Slot &slot = m_slots.at(seq % size);
+        m_flushing.append({ slot.image, frameDirectory.filePath(
+                                QString("%1.png").arg(seq, 4, 10, QChar('0'))),
+                            false });
+    }
+    m_unflushed = m_frames;
+    m_writer->setFuture(QtConcurrent::map(m_flushing, [](FlushedFrame &f) {
+        f.saved = PngEncoder().save(f.image, f.path);
+        // release the buffer, the ring may be waiting to reuse it
+        f.image = QImage();
+    }));
+}
+
+// stop saves the remaining frames and ends the burst
+void BurstCapture::stop() {
+    if (m_stopping) {
+        return;
+    }
+    m_stopping = true;
+    m_timer->stop();
+    flush();
+}
+
+void BurstCapture::handleFlushed() {
+    QStringList paths;
+    int failed = 0;
+    for (const FlushedFrame &f: m_flushing) {
+        if (f.saved) {
+            paths << f.path;
+        } else {
+            ++failed;
+        }
+    }
+    m_flushing.clear();
+    if (failed > 0) {
+        SystemNotification().sendMessage(
+                    tr("Error trying to save %1 frames of the burst")
+                    .arg(failed));
+    }
+    Q_EMIT flushed(m_id, paths);
+    if (m_flushAgain || m_stopping) {
+        m_flushAgain = false;
+        flush();
+    }
+}
+
+bool BurstCapture::isFlushing() const {
+    return !m_flushing.isEmpty();
+}
@@ -0,0 +1,88 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BURSTCAPTURE_H
+#define BURSTCAPTURE_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+
+class QTimer;
+
+class BurstCapture : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BurstCapture(const uint id, const QRect &area, const int frames,
+                          const int interval, const bool ring,
+                          const QString &path, QObject *parent = nullptr);
+
+    uint id() const;
+
+signals:
+    void flushed(uint id, QStringList paths);
+    void finished(uint id, uint frames, uint dropped);
+
+public slots:
+    void flush();
+    void stop();
+
+private slots:
+    void grabFrame();
+    void handleFlushed();
+
+private:
+    struct Slot {
+        QImage image;
+        quint32 sequence;
+    };
+    // a flushed frame, encoded in the thread pool
+    struct FlushedFrame {
+        QImage image;
+        QString path;
+        bool saved;
+    };
+
+    uint m_id;
+    QRect m_area;
+    int m_interval;
+    bool m_ring;
+    QString m_directory;
+    // directory of the frames, created by the first flush
+    QString m_frameDirectory;
+    QVector<Slot> m_slots;
+    quint32 m_frames;
+    quint32 m_dropped;
+    // first sequence number which wasn't flushed yet
+    quint32 m_unflushed;
+    qint64 m_lastGrab;
+    QElapsedTimer m_clock;
+    QTimer *m_timer;
+    QVector<FlushedFrame> m_flushing;
+    QFutureWatcher<void> *m_writer;
+    bool m_flushAgain;
+    bool m_stopping;
+
+    bool isFlushing() const;
+};
+
+#endif // BURSTCAPTURE_H
@@ -0,0 +1,303 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "capturepipeline.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/screengrabber.h"
+#include "src/utils/imageview.h"
+#include "src/utils/filenamehandler.h"
+#include "src/utils/savequeue.h"
+#include "src/utils/clipboardmimedata.h"
+#include "src/utils/systemnotification.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QCursor>
+#include <QScreen>
+#include <QPainter>
+#include <QImageWriter>
+#include <QStandardPaths>
+#include <QDir>
+#include <QRegExp>
+#include <QtConcurrent>
+
+// CapturePipeline is a capture defined in the config which runs without
+// the interface. It is a chain of stages: a grab, any number of transforms,
+// an encoding and the deliveries. The screen is grabbed in the GUI thread,
+// the transforms and the choice of the encoding run in a worker thread and
+// the deliveries share the encoding through an ExportPipeline.
+
+namespace {
+
+// parseGeometry reads the X11 geometry format WxH+X+Y
+bool parseGeometry(const QString &text, QRect &rect) {
+    QRegExp geometry("(\\d+)x(\\d+)\\+(-?\\d+)\\+(-?\\d+)");
+    if (!geometry.exactMatch(text)) {
+        return false;
+    }
+    rect = QRect(geometry.cap(3).toInt(), geometry.cap(4).toInt(),
+                 geometry.cap(1).toInt(), geometry.cap(2).toInt());
+    return !rect.isEmpty();
+}
+
+} // unnamed namespace
+
+CapturePipeline::CapturePipeline(const QString &name, const QString &stages,
+                                 QObject *parent) :
+    QObject(parent), m_name(name), m_grab(GRAB_DESKTOP),
+    m_encoding(ENCODE_AUTO), m_save(false), m_copy(false), m_copyPath(false)
+{
+    parse(stages);
+}
+
+QString CapturePipeline::name() const {
+    return m_name;
+}
+
+bool CapturePipeline::isValid() const {
+    return m_error.isEmpty();
+}
+
+QString CapturePipeline::errorString() const {
+    return m_error;
+}
+
+// run grabs the screen and hands the rest over to a worker thread, an
+// invalid pipeline only reports its error
+void CapturePipeline::run() {
+    if (!isValid()) {
+        SystemNotification().sendMessage(
+                    tr("Pipeline %1: %2").arg(m_name, m_error));
+        return;
+    }
+    bool ok = true;
+    const QPixmap desktop = ScreenGrabber().grabEntireDesktop(ok);
+    if (!ok) {
+        SystemNotification().sendMessage(tr("Unable to capture screen"));
+        return;
+    }
+    const QRect area = grabArea(desktop);
+    const QImage grabbed = ImageView::crop(desktop.toImage(), area);
+    const QVector<Transform> transforms = m_transforms;
+    const Encoding encoding = m_encoding;
+
+    auto watcher = new QFutureWatcher<Processed>(this);
+    connect(watcher, &QFutureWatcher<Processed>::finished, this,
+            [this, watcher, area]()
+    {
+        Processed processed = watcher->result();
+        watcher->deleteLater();
+        if (processed.capture->image().isNull()) {
+            SystemNotification().sendMessage(
+                        tr("Pipeline %1: the capture is empty").arg(m_name));
+            return;
+        }
+        deliver(processed, area);
+    });
+    watcher->setFuture(QtConcurrent::run([grabbed, transforms, encoding]() {
+        return process(grabbed, transforms, encoding);
+    }));
+}
+
+// parse reads the stages separated by '|', their order is enforced: grab,
+// transforms, encode and the deliveries
+bool CapturePipeline::parse(const QString &stages) {
+    const QStringList list = stages.split('|', QString::SkipEmptyParts);
+    if (list.isEmpty()) {
+        m_error = tr("no stages");
+        return false;
+    }
+    int order = 0;
+    for (int i = 0; i < list.size(); ++i) {
+        QStringList args = list.at(i).split(' ', QString::SkipEmptyParts);
+        if (args.isEmpty()) {
+            m_error = tr("empty stage");
+            return false;
+        }
+        const QString verb = args.takeFirst();
+        const int stageOrder = verb == "grab" ? 0 :
+                (verb == "crop" || verb == "redact") ? 1 :
+                verb == "encode" ? 2 : 3;
+        if ((i == 0) != (stageOrder == 0) || stageOrder < order) {
+            m_error = tr("\"%1\" is out of place").arg(verb);
+            return false;
+        }
+        order = stageOrder;
+        if (!parseStage(verb, args)) {
+            return false;
+        }
+    }
+    if (!m_save && !m_copy && !m_copyPath) {
+        m_error = tr("nothing to deliver");
+    } else if (m_copy && m_copyPath) {
+        m_error = tr("copy and copy-path share the clipboard");
+    } else if (m_copyPath && !m_save) {
+        m_error = tr("copy-path needs a save stage");
+    } else if (m_encoding == ENCODE_WEBP &&
+               !QImageWriter::supportedImageFormats().contains("webp"))
+    {
+        m_error = tr("WebP isn't supported");
+    }
+    return m_error.isEmpty();
+}
+
+bool CapturePipeline::parseStage(const QString &verb,
+                                 const QStringList &args)
+{
+    const QString arg = args.value(0);
+    if (verb == "grab") {
+        if (arg == "desktop" && args.size() == 1) {
+            m_grab = GRAB_DESKTOP;
+        } else if (arg == "screen" && args.size() == 1) {
+            m_grab = GRAB_SCREEN;
+        } else if (arg == "area" && args.size() == 2 &&
+                   parseGeometry(args.at(1), m_area))
+        {
+            m_grab = GRAB_AREA;
+        } else {
+            m_error = tr("unknown grab \"%1\"").arg(args.join(' '));
+        }
+    } else if (verb == "crop" || verb == "redact") {
+        Transform t { verb == "redact", QVector<QRect>() };
+        for (const QString &geometry: args) {
+            QRect r;
+            if (!parseGeometry(geometry, r)) {
+                m_error = tr("invalid rectangle \"%1\"").arg(geometry);
+                return false;
+            }
+            t.rects.append(r);
+        }
+        if (t.rects.isEmpty() || (!t.redact && t.rects.size() > 1)) {
+            m_error = tr("\"%1\" needs one rectangle").arg(verb);
+        }
+        m_transforms.append(t);
+    } else if (verb == "encode") {
+        if (arg == "auto" && args.size() == 1) {
+            m_encoding = ENCODE_AUTO;
+        } else if (arg == "png" && args.size() == 1) {
+            m_encoding = ENCODE_PNG;
+        } else if (arg == "webp" && args.size() == 1) {
+            m_encoding = ENCODE_WEBP;
+        } else {
+            m_error = tr("unknown encoding \"%1\"").arg(args.join(' '));
+        }
+    } else if (verb == "save") {
+        // the directory may contain spaces
+        m_save = true;
+        m_saveDirectory = args.join(' ');
+        if (m_saveDirectory.startsWith("~")) {
+            m_saveDirectory.replace(0, 1, QDir::homePath());
+        }
+    } else if (verb == "copy" && args.isEmpty()) {
+        m_copy = true;
+    } else if (verb == "copy-path" && args.isEmpty()) {
+        m_copyPath = true;
+    } else {
+        m_error = tr("unknown stage \"%1\"").arg(verb);
+    }
+    return m_error.isEmpty();
+}
+
+// grabArea returns the grabbed part of the desktop pixmap in its pixels,
+// the screens and the area use the logical coordinates of the desktop
+QRect CapturePipeline::grabArea(const QPixmap &desktop) const {
+    if (m_grab == GRAB_DESKTOP) {
+        return desktop.rect();
+    }
+    QRect desktopGeometry;
+    for (QScreen *const screen : QGuiApplication::screens()) {
+        desktopGeometry = desktopGeometry.united(screen->geometry());
+    }
+    QRect area = m_area;
+    if (m_grab == GRAB_SCREEN) {
+        area = QGuiApplication::primaryScreen()->geometry();
+        for (QScreen *const screen : QGuiApplication::screens()) {
+            if (screen->geometry().contains(QCursor::pos())) {
+                area = screen->geometry();
+                break;
+            }
+        }
+    }
+    area.translate(-desktopGeometry.topLeft());
+    const qreal ratio = desktop.devicePixelRatio();
+    return QRect(area.topLeft() * ratio, area.size() * ratio)
+            .intersected(desktop.rect());
+}
+
+// deliver saves and copies the capture, the encoding was already started
+// by the worker and is shared by the file and the clipboard
+void CapturePipeline::deliver(const Processed &processed, const QRect &area) {
+    QString path;
+    if (m_save) {
+        QString directory = m_saveDirectory;
+        if (directory.isEmpty()) {
+            directory = ConfigHandler().savePathValue();
+        }
+        if (directory.isEmpty() || !QDir(directory).exists()) {
+            directory = QStandardPaths::writableLocation(
+                        QStandardPaths::PicturesLocation);
+        }
+        const QString suffix = processed.choice.suffix;
+        path = FileNameHandler().generateAbsolutePath(directory, area, suffix)
+                + suffix;
+        SaveQueue::getInstance()->enqueue(processed.capture, path,
+                                          processed.choice);
+    }
+    if (m_copy) {
+        ClipboardMimeData::copyToClipboard(processed.capture);
+    }
+    if (m_copyPath) {
+        QApplication::clipboard()->setText(path);
+    }
+}
+
+// process applies the transforms and chooses the encoding, it runs in a
+// worker thread
+CapturePipeline::Processed CapturePipeline::process(
+        const QImage &image, const QVector<Transform> &transforms,
+        const Encoding encoding)
+{
+    QImage res = image;
+    for (const Transform &t: transforms) {
+        if (t.redact) {
+            // painting detaches the view of the screenshot
+            QPainter painter(&res);
+            for (const QRect &r: t.rects) {
+                painter.fillRect(r, Qt::black);
+            }
+        } else {
+            res = ImageView::crop(res, t.rects.first());
+        }
+    }
+    Processed processed;
+    processed.capture = QSharedPointer<ExportPipeline>(new ExportPipeline(res));
+    switch (encoding) {
+    case ENCODE_PNG:
+        processed.choice = { EncoderSelector::ENCODING_PNG, QVector<QRgb>(),
+                             ".png", QString() };
+        break;
+    case ENCODE_WEBP:
+        processed.choice = { EncoderSelector::ENCODING_LOSSLESS_WEBP,
+                             QVector<QRgb>(), ".webp", QString() };
+        break;
+    default:
+        processed.choice = processed.capture->choice(true);
+        break;
+    }
+    // the deliveries join the encoding
+    processed.capture->encoding(processed.choice);
+    return processed;
+}
@@ -0,0 +1,86 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CAPTUREPIPELINE_H
+#define CAPTUREPIPELINE_H
+
+#include "src/core/exportpipeline.h"
+#include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QRect>
+
+class CapturePipeline : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CapturePipeline(const QString &name, const QString &stages,
+                             QObject *parent = nullptr);
+
+    QString name() const;
+    bool isValid() const;
+    QString errorString() const;
+
+public slots:
+    void run();
+
+private:
+    enum Grab {
+        GRAB_DESKTOP,
+        GRAB_SCREEN,
+        GRAB_AREA,
+    };
+
+    struct Transform {
+        bool redact;
+        QVector<QRect> rects;
+    };
+
+    enum Encoding {
+        ENCODE_AUTO,
+        ENCODE_PNG,
+        ENCODE_WEBP,
+    };
+
+    // result of the headless part of a run
+    struct Processed {
+        QSharedPointer<ExportPipeline> capture;
+        EncoderSelector::Choice choice;
+    };
+
+    QString m_name;
+    QString m_error;
+    Grab m_grab;
+    QRect m_area;
+    QVector<Transform> m_transforms;
+    Encoding m_encoding;
+    bool m_save;
+    QString m_saveDirectory;
+    bool m_copy;
+    bool m_copyPath;
+
+    bool parse(const QString &stages);
+    bool parseStage(const QString &verb, const QStringList &args);
+    QRect grabArea(const QPixmap &desktop) const;
+    void deliver(const Processed &processed, const QRect &area);
+
+    static Processed process(const QImage &image,
+                             const QVector<Transform> &transforms,
+                             const Encoding encoding);
+};
+
+#endif // CAPTUREPIPELINE_H
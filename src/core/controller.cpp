@@ -18,6 +18,9 @@
 #include "controller.h"
 #include "src/capture/widget/capturewidget.h"
 #include "src/utils/confighandler.h"
+#include "src/utils/archiverecompressor.h"
+#include "src/core/frameserver.h"
+#include "src/core/capturepipeline.h"
 #include "src/infowindow.h"
 #include "src/config/configwindow.h"
 #include "src/capture/widget/capturebutton.h"
@@ -26,11 +29,13 @@
 #include <QSystemTrayIcon>
 #include <QAction>
 #include <QMenu>
+#include <QFutureWatcher>
 
 // Controller is the core component of Flameshot, creates the trayIcon and
 // launches the capture widget
 
-Controller::Controller() : m_captureWindow(nullptr)
+
+Controller::Controller() : m_captureWindow(nullptr), m_lastCaptureToken(0)
 {
     qApp->setQuitOnLastWindowClosed(false);
 
@@ -41,6 +46,14 @@ Controller::Controller() : m_captureWindow(nullptr)
 
     initDefaults();
 
+    if (ConfigHandler().idleRecompressionValue()) {
+        ArchiveRecompressor::getInstance()->start();
+    }
+    if (ConfigHandler().frameServerValue()) {
+        FrameServer::getInstance()->start();
+    }
+    loadPipelines();
+
     QString StyleSheet = CaptureButton::globalStyleSheet();
     qApp->setStyleSheet(StyleSheet);
 }
@@ -67,15 +80,135 @@ void Controller::showScreenShot()
 }
 
 // creation of a new capture in GUI mode
-void Controller::createVisualCapture(const uint id, const QString &forcedSavePath)
+void Controller::createVisualCapture(const uint id,
+                                     const QString &forcedSavePath,
+                                     const ImageEncoder::Format format)
+{
+    openCaptureWindow({ id, false, format }, forcedSavePath);
+}
+
+// createExportCapture makes a GUI capture which is sent as an exportTaken
+// signal, the caller encodes it. A failure is sent as exportFailed.
+void Controller::createExportCapture(const uint id,
+                                     const QString &forcedSavePath)
+{
+    openCaptureWindow({ id, true, ImageEncoder::FORMAT_PNG }, forcedSavePath);
+}
+
+void Controller::openCaptureWindow(const CaptureRequest &request,
+                                   const QString &forcedSavePath)
 {
-    if (!m_captureWindow) {
-        m_captureWindow = new CaptureWidget(id, forcedSavePath);
-        connect(m_captureWindow, SIGNAL(CaptureWidget::captureFailed),
-                this, SIGNAL(Controller::captureFailed));
-        connect(m_captureWindow, SIGNAL(CaptureWidget::captureTaken),
-                this, SIGNAL(Controller::captureTaken));
-        m_captureWindow->showFullScreen();
+    if (m_captureWindow) {
+        // only one capture can be open at once
+        failRequest(request);
+        return;
+    }
+    // the token 0 tells the widget that the raw image isn't needed
+    uint token = 0;
+    if (request.id != 0 || request.exported) {
+        if (++m_lastCaptureToken == 0) {
+            ++m_lastCaptureToken;
+        }
+        token = m_lastCaptureToken;
+        m_captureRequests.insert(token, request);
+    }
+    m_captureWindow = new CaptureWidget(token, forcedSavePath);
+    connect(m_captureWindow, &CaptureWidget::captureFailed,
+            this, &Controller::handleCaptureFailed);
+    connect(m_captureWindow, &CaptureWidget::captureTaken,
+            this, &Controller::encodeCapture);
+    m_captureWindow->showFullScreen();
+}
+
+// encodeCapture sends the capture of the token as its caller requested
+void Controller::encodeCapture(const uint id,
+                               const QSharedPointer<ExportPipeline> &capture)
+{
+    if (!m_captureRequests.contains(id)) {
+        return;
+    }
+    const CaptureRequest request = m_captureRequests.take(id);
+    if (request.exported) {
+        Q_EMIT exportTaken(request.id, capture);
+        return;
+    }
+    encodeExport(request.id, capture, request.format);
+}
+
+// handleCaptureFailed forgets the pending request of the token
+void Controller::handleCaptureFailed(const uint id) {
+    if (m_captureRequests.contains(id)) {
+        failRequest(m_captureRequests.take(id));
+    } else {
+        Q_EMIT captureFailed(0);
+    }
+}
+
+void Controller::failRequest(const CaptureRequest &request) {
+    if (request.exported) {
+        Q_EMIT exportFailed(request.id);
+    } else {
+        Q_EMIT captureFailed(request.id);
+    }
+}
+
+// encodeExport emits captureTaken when the encoding, which runs in a
+// worker thread, is ready
+void Controller::encodeExport(const uint id,
+                              const QSharedPointer<ExportPipeline> &capture,
+                              const ImageEncoder::Format format)
+{
+    using Encoded = ExportPipeline::Encoded;
+    auto watcher = new QFutureWatcher<Encoded>(this);
+    // the watcher keeps the pipeline alive until the signal is sent
+    connect(watcher, &QFutureWatcher<Encoded>::finished, this,
+            [this, watcher, id, capture]()
+    {
+        Q_EMIT captureTaken(id, watcher->result().data);
+        watcher->deleteLater();
+    });
+    watcher->setFuture(capture->encoding(format));
+}
+
+// runPipeline runs the pipeline of the config with that name, it returns
+// false if there is none. An unknown name is looked up again in the config,
+// it may have been added since the start. The loaded pipelines are kept, they
+// may be running.
+bool Controller::runPipeline(const QString &name) {
+    if (!m_pipelines.contains(name)) {
+        ConfigHandler config;
+        if (config.pipelineNamesValue().contains(name)) {
+            addPipeline(config, name);
+        }
+    }
+    CapturePipeline *pipeline = m_pipelines.value(name);
+    if (!pipeline) {
+        return false;
+    }
+    pipeline->run();
+    return true;
+}
+
+// loadPipelines reads the pipelines of the config and binds their global
+// shortcuts, the shortcuts are released with the old pipelines
+void Controller::loadPipelines() {
+    qDeleteAll(m_pipelines);
+    m_pipelines.clear();
+    ConfigHandler config;
+    for (const QString &name: config.pipelineNamesValue()) {
+        addPipeline(config, name);
+    }
+}
+
+void Controller::addPipeline(ConfigHandler &config, const QString &name) {
+    auto pipeline = new CapturePipeline(
+                name, config.pipelineStagesValue(name), this);
+    m_pipelines.insert(name, pipeline);
+    const QString shortcut = config.pipelineShortcutValue(name);
+    if (!shortcut.isEmpty()) {
+        auto sc = new QxtGlobalShortcut(QKeySequence(shortcut), pipeline);
+        connect(sc, &QxtGlobalShortcut::activated,
+                pipeline, &CapturePipeline::run);
     }
 }
 
@@ -21,9 +21,15 @@
 #include <QObject>
 #include <QPointer>
 #include <QPixmap>
+#include <QHash>
+#include "src/utils/imageencoder.h"
+#include "src/core/exportpipeline.h"
+#include <QSharedPointer>
 #include "../third-party/qxtglobalshortcut5/gui/qxtglobalshortcut.h"
 
 class CaptureWidget;
+class CapturePipeline;
+class ConfigHandler;
 class ConfigWindow;
 class InfoWindow;
 class QSystemTrayIcon;
@@ -40,10 +46,24 @@ public:
 signals:
     void captureTaken(uint id, QByteArray p);
     void captureFailed(uint id);
+    void exportTaken(uint id, QSharedPointer<ExportPipeline> capture);
+    void exportFailed(uint id);
 
 public slots:
     void createVisualCapture(const uint id = 0,
+                             const QString &forcedSavePath = QString(),
+                             const ImageEncoder::Format format =
+            ImageEncoder::FORMAT_PNG);
+    void encodeCapture(const uint id,
+                       const QSharedPointer<ExportPipeline> &capture);
+    void encodeExport(const uint id,
+                      const QSharedPointer<ExportPipeline> &capture,
+                      const ImageEncoder::Format format);
+    void createExportCapture(const uint id,
                              const QString &forcedSavePath = QString());
+    bool runPipeline(const QString &name);
+    void loadPipelines();
+    void handleCaptureFailed(const uint id);
 
     void openConfigWindow();
     void openInfoWindow();
@@ -65,6 +85,23 @@ private:
     QPointer<InfoWindow> m_infoWindow;
     QPointer<ConfigWindow> m_configWindow;
     QPointer<QSystemTrayIcon> m_trayIcon;
+    // what the caller of a pending GUI capture gets. The capture widget
+    // only knows a token, so the ids of the callers and the ids of the
+    // exports, which come from different sources, never mix.
+    struct CaptureRequest {
+        uint id;
+        // sent as exportTaken instead of being encoded
+        bool exported;
+        ImageEncoder::Format format;
+    };
+    QHash<uint, CaptureRequest> m_captureRequests;
+    uint m_lastCaptureToken;
+
+    void openCaptureWindow(const CaptureRequest &request,
+                           const QString &forcedSavePath);
+    void failRequest(const CaptureRequest &request);
+    void addPipeline(ConfigHandler &config, const QString &name);
+    QHash<QString, CapturePipeline*> m_pipelines;
 
 };
 
@@ -0,0 +1,280 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "exportpipeline.h"
+#include "src/utils/imageview.h"
+#include "src/utils/idlethreadpool.h"
+#include <QtConcurrent>
+#include <QLoggingCategory>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QStringList>
+
+// ExportPipeline holds one capture shared by all its destinations. Each
+// encoding is started once in the thread pool and every destination asking
+// for it gets the same future, so a capture copied, saved and sent through
+// D-Bus as PNG is only encoded once. A selection is exported as a view of
+// the screenshot, so it isn't copied before being encoded. The time of
+// every stage and the growth of the resident memory during the export are
+// logged in the flameshot.export category when the last destination and
+// the last job are done, the pipeline doesn't wait for its jobs.
+
+Q_LOGGING_CATEGORY(exportTimings, "flameshot.export")
+
+namespace {
+
+// the prefetches run in a thread of their own at the idle priority, the
+// threads of the global pool are never lowered. It isn't destroyed so the
+// exit doesn't wait for a prefetch.
+IdleThreadPool *prefetchPool() {
+    static IdleThreadPool *pool = new IdleThreadPool();
+    return pool;
+}
+
+// pipelines still in use by some destination, a copy of the same pixmap
+// exported elsewhere joins them
+QHash<qint64, QWeakPointer<ExportPipeline>> livePipelines;
+
+ExportPipeline::Encoded encodeChoice(const QImage &image,
+                                     EncoderSelector::Choice choice)
+{
+    QByteArray data = EncoderSelector().encode(image, choice);
+    return ExportPipeline::Encoded { data, choice.reason };
+}
+
+// residentMemory returns the resident memory of the process in KiB, -1
+// where /proc isn't available
+qint64 residentMemory() {
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray &line: status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+    return -1;
+}
+
+} // unnamed namespace
+
+// Timings also samples the resident memory when the export starts and after
+// every stage, only while the category is enabled. The growth logged is the
+// memory the export itself kept, the peak of the daemon says nothing about
+// one export.
+class ExportPipeline::Timings {
+public:
+    explicit Timings(const QSize &size) :
+        m_size(size), m_sampled(exportTimings().isDebugEnabled()),
+        m_startRss(m_sampled ? residentMemory() : -1), m_peakRss(m_startRss)
+    {
+        m_lifetime.start();
+    }
+
+    ~Timings() {
+        sampleMemory();
+        qCDebug(exportTimings) << qPrintable(
+                QString("%1x%2 capture: %3, total %4 ms, RSS growth %5 KiB")
+                .arg(m_size.width()).arg(m_size.height())
+                .arg(m_stages.join(", ")).arg(m_lifetime.elapsed())
+                .arg(m_startRss < 0 ? -1 : m_peakRss - m_startRss));
+    }
+
+    void add(const QString &stage, const qint64 msec) {
+        sampleMemory();
+        QMutexLocker locker(&m_mutex);
+        m_stages << QString("%1 %2 ms").arg(stage).arg(msec);
+    }
+
+private:
+    QMutex m_mutex;
+    QStringList m_stages;
+    QElapsedTimer m_lifetime;
+    QSize m_size;
+    const bool m_sampled;
+    const qint64 m_startRss;
+    qint64 m_peakRss;
+
+    void sampleMemory() {
+        if (!m_sampled) {
+            return;
+        }
+        const qint64 rss = residentMemory();
+        QMutexLocker locker(&m_mutex);
+        m_peakRss = qMax(m_peakRss, rss);
+    }
+};
+
+ExportPipeline::ExportPipeline(const QPixmap &p) :
+    m_timings(new Timings(p.size()))
+{
+    QElapsedTimer timer;
+    timer.start();
+    // the only conversion of the pixmap, it can't leave the GUI thread
+    m_image = p.toImage();
+    addTiming("convert", timer.elapsed());
+}
+
+ExportPipeline::ExportPipeline(const QImage &image) :
+    m_image(image), m_timings(new Timings(image.size()))
+{
+}
+
+// the running jobs keep the capture and the timings, they are left to end
+// in the pool
+ExportPipeline::~ExportPipeline() {
+}
+
+// forPixmap returns the pipeline of the pixmap if a destination still
+// holds it or a new one, it is only called from the GUI thread
+QSharedPointer<ExportPipeline> ExportPipeline::forPixmap(const QPixmap &p) {
+    for (auto it = livePipelines.begin(); it != livePipelines.end();) {
+        it = it.value().isNull() ? livePipelines.erase(it) : it + 1;
+    }
+    QSharedPointer<ExportPipeline> res = livePipelines.value(p.cacheKey());
+    if (!res) {
+        res = QSharedPointer<ExportPipeline>(new ExportPipeline(p));
+        livePipelines.insert(p.cacheKey(), res);
+    }
+    return res;
+}
+
+// forCrop returns a pipeline for an area of the pixmap, its image is a view
+// of the pixmap pixels. The pipeline isn't shared through forPixmap as no
+// pixmap of the area exists.
+QSharedPointer<ExportPipeline> ExportPipeline::forCrop(const QPixmap &p,
+                                                       const QRect &area)
+{
+    QElapsedTimer timer;
+    timer.start();
+    // a raster pixmap shares its pixels with the image
+    const QImage view = ImageView::crop(p.toImage(), area);
+    QSharedPointer<ExportPipeline> res(new ExportPipeline(view));
+    res->addTiming("crop", timer.elapsed());
+    return res;
+}
+
+const QImage &ExportPipeline::image() const {
+    return m_image;
+}
+
+// pixmap converts the capture for the destinations which show it, it isn't
+// kept as the pipeline may be released in a worker thread. It is only
+// called from the GUI thread.
+QPixmap ExportPipeline::pixmap() const {
+    return QPixmap::fromImage(m_image);
+}
+
+// choice picks the encoding for the content once, the histogram is shared
+// by the file and the upload
+EncoderSelector::Choice ExportPipeline::choice(const bool allowWebp) {
+    QMutexLocker locker(&m_mutex);
+    if (!m_choices.contains(allowWebp)) {
+        QElapsedTimer timer;
+        timer.start();
+        m_choices.insert(allowWebp,
+                         EncoderSelector(allowWebp).choose(m_image));
+        m_timings->add("choose", timer.elapsed());
+    }
+    return m_choices.value(allowWebp);
+}
+
+QFuture<ExportPipeline::Encoded> ExportPipeline::encoding(
+        const EncoderSelector::Choice &choice)
+{
+    const QImage image = m_image;
+    return run(EncoderSelector::encodingKey(choice), [image, choice]() {
+        return encodeChoice(image, choice);
+    });
+}
+
+QFuture<ExportPipeline::Encoded> ExportPipeline::encoding(
+        const ImageEncoder::Format format)
+{
+    const QImage image = m_image;
+    // the plain PNG of the raw output is the same as the PNG of the files
+    const QString key = format == ImageEncoder::FORMAT_PNG ? QString("png") :
+            ImageEncoder::formatNames().at(format);
+    return run(key, [image, format]() {
+        return Encoded { ImageEncoder(format).encode(image), QString() };
+    });
+}
+
+QFuture<ExportPipeline::Encoded> ExportPipeline::encoding(
+        const QString &key, std::function<QByteArray(const QImage &)> encode)
+{
+    const QImage image = m_image;
+    return run(key, [image, encode]() {
+        return Encoded { encode(image), QString() };
+    });
+}
+
+// prefetch starts the encoding a destination would choose at idle priority,
+// a destination asking for it later gets the same future once it is done
+void ExportPipeline::prefetch(const bool allowWebp) {
+    const EncoderSelector::Choice c = choice(allowWebp);
+    const QImage image = m_image;
+    run(EncoderSelector::encodingKey(c), [image, c]() {
+        return encodeChoice(image, c);
+    }, true);
+}
+
+bool ExportPipeline::isRunning() {
+    QMutexLocker locker(&m_mutex);
+    for (const QFuture<Encoded> &f: m_encodings) {
+        if (f.isRunning()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ExportPipeline::addTiming(const QString &stage, const qint64 msec) {
+    m_timings->add(stage, msec);
+}
+
+QFuture<ExportPipeline::Encoded> ExportPipeline::run(
+        const QString &key, std::function<Encoded()> job, const bool background)
+{
+    QMutexLocker locker(&m_mutex);
+    // a destination doesn't wait for a prefetch still in the idle thread,
+    // the encoding starts again at the normal priority
+    const bool joinable = m_encodings.contains(key) &&
+            (background || !m_prefetched.contains(key) ||
+             m_encodings.value(key).isFinished());
+    if (!joinable) {
+        const QSharedPointer<Timings> timings = m_timings;
+        std::function<Encoded()> timed = [timings, key, job, background]() {
+            QElapsedTimer timer;
+            timer.start();
+            Encoded res = job();
+            timings->add((background ? "prefetch " : "encode ") + key,
+                         timer.elapsed());
+            return res;
+        };
+        if (background) {
+            m_prefetched.insert(key);
+            m_encodings.insert(key, prefetchPool()->run(timed));
+        } else {
+            m_prefetched.remove(key);
+            m_encodings.insert(key, QtConcurrent::run(timed));
+        }
+    }
+    return m_encodings.value(key);
+}
@@ -0,0 +1,80 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef EXPORTPIPELINE_H
+#define EXPORTPIPELINE_H
+
+#include "src/utils/encoderselector.h"
+#include "src/utils/imageencoder.h"
+#include <QImage>
+#include <QPixmap>
+#include <QHash>
+#include <QSet>
+#include <QFuture>
+#include <QMutex>
+#include <QSharedPointer>
+#include <functional>
+
+class ExportPipeline
+{
+public:
+    struct Encoded {
+        QByteArray data;
+        // reason of the encoding shown to the user, if any
+        QString reason;
+    };
+
+    explicit ExportPipeline(const QPixmap &p);
+    explicit ExportPipeline(const QImage &image);
+    ~ExportPipeline();
+
+    static QSharedPointer<ExportPipeline> forPixmap(const QPixmap &p);
+    static QSharedPointer<ExportPipeline> forCrop(const QPixmap &p,
+                                                  const QRect &area);
+
+    const QImage &image() const;
+    QPixmap pixmap() const;
+    EncoderSelector::Choice choice(const bool allowWebp);
+    QFuture<Encoded> encoding(const EncoderSelector::Choice &choice);
+    QFuture<Encoded> encoding(const ImageEncoder::Format format);
+    QFuture<Encoded> encoding(const QString &key,
+                              std::function<QByteArray(const QImage &)> encode);
+
+    void prefetch(const bool allowWebp);
+    bool isRunning();
+
+    void addTiming(const QString &stage, const qint64 msec);
+
+private:
+    // timings of the stages, shared with the jobs so the last one to end
+    // logs them
+    class Timings;
+
+    QImage m_image;
+    QMutex m_mutex;
+    QHash<QString, QFuture<Encoded>> m_encodings;
+    // keys of the encodings started by prefetch
+    QSet<QString> m_prefetched;
+    QHash<bool, EncoderSelector::Choice> m_choices;
+    QSharedPointer<Timings> m_timings;
+
+    QFuture<Encoded> run(const QString &key, std::function<Encoded()> job,
+                         const bool background = false);
+};
+
+#endif // EXPORTPIPELINE_H
@@ -21,9 +21,23 @@
 #include "src/core/controller.h"
 #include "src/core/resourceexporter.h"
 #include "src/utils/systemnotification.h"
+#include "src/utils/filenamehandler.h"
+#include "src/utils/imagediff.h"
+#include "src/utils/savequeue.h"
+#include "src/core/framestream.h"
+#include "src/core/burstcapture.h"
+#include "src/core/regionwatcher.h"
 #include <QTimer>
 #include <functional>
-#include <QBuffer>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QTemporaryFile>
+#include <QDBusConnection>
+#include <QDBusServiceWatcher>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace {
     using std::function;
@@ -38,16 +52,79 @@ namespace {
         timer->setInterval(msec);
         timer->start();
     }
+
+    // writeSealedImage writes the encoded image in a memfd sealed against
+    // further changes, or in an unlinked temporary file where memfd isn't
+    // available. It returns the descriptor positioned at the start or -1.
+    int writeSealedImage(const QByteArray &data) {
+        int fd = -1;
+#if defined(Q_OS_LINUX) && defined(MFD_ALLOW_SEALING)
+        fd = memfd_create("flameshot-capture", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+        QTemporaryFile tmp;
+        if (tmp.open()) {
+            fd = ::dup(tmp.handle());
+        }
+#endif
+        if (fd < 0) {
+            return -1;
+        }
+        QFile file;
+        bool ok = !data.isEmpty() && file.open(fd, QIODevice::WriteOnly) &&
+                file.write(data) == data.size() && file.flush();
+        file.close();
+        if (!ok) {
+            ::close(fd);
+            return -1;
+        }
+#if defined(Q_OS_LINUX) && defined(F_ADD_SEALS)
+        fcntl(fd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#endif
+        ::lseek(fd, 0, SEEK_SET);
+        return fd;
+    }
+
+    // every frame of a burst stays in memory, 8 MB each at 1080p
+    const int MAX_BURST_FRAMES = 300;
+
+    struct DiffResult {
+        QImage annotated;
+        QStringList rects;
+    };
+
+    // compareCaptures runs in a worker thread, a null image means that one
+    // of the captures couldn't be loaded
+    DiffResult compareCaptures(const QString &beforePath,
+                               const QString &afterPath,
+                               const QImage &afterCapture)
+    {
+        DiffResult res;
+        QImage before(beforePath);
+        QImage after = afterCapture.isNull() ? QImage(afterPath) : afterCapture;
+        if (before.isNull() || after.isNull()) {
+            return res;
+        }
+        ImageDiff diff(before, after);
+        res.annotated = diff.annotatedImage();
+        res.rects = diff.changedRectsAsText();
+        return res;
+    }
 }
 
 FlameshotDBusAdapter::FlameshotDBusAdapter(QObject *parent)
-    : QDBusAbstractAdaptor(parent)
+    : QDBusAbstractAdaptor(parent), m_lastReplyId(0), m_lastStreamId(0),
+      m_lastBurstId(0), m_lastWatchId(0)
 {
     auto controller =  Controller::getInstance();
     connect(controller, &Controller::captureFailed,
             this, &FlameshotDBusAdapter::captureFailed);
+    connect(controller, &Controller::exportFailed,
+            this, &FlameshotDBusAdapter::handleExportFailed);
     connect(controller, &Controller::captureTaken,
             this, &FlameshotDBusAdapter::captureTaken);
+    connect(controller, &Controller::exportTaken,
+            this, &FlameshotDBusAdapter::handleExportTaken);
 }
 
 FlameshotDBusAdapter::~FlameshotDBusAdapter() {
@@ -55,19 +132,43 @@ FlameshotDBusAdapter::~FlameshotDBusAdapter() {
 }
 
 void FlameshotDBusAdapter::graphicCapture(QString path, int delay, uint id) {
+    graphicCaptureAs(path, delay, id, "png");
+}
+
+void FlameshotDBusAdapter::fullScreen(
+        QString path, bool toClipboard, int delay, uint id)
+{
+    fullScreenAs(path, toClipboard, delay, id, "png");
+}
+
+// graphicCaptureAs and fullScreenAs send the raw image in @format, one of
+// the names of ImageEncoder::formatNames
+void FlameshotDBusAdapter::graphicCaptureAs(
+        QString path, int delay, uint id, QString format)
+{
+    ImageEncoder::Format imageFormat;
+    if (!ImageEncoder::parseFormat(format, imageFormat)) {
+        Q_EMIT captureFailed(id);
+        return;
+    }
     auto controller =  Controller::getInstance();
 
-    auto f = [controller, id, path, this]() {
-       controller->createVisualCapture(id, path);
+    auto f = [controller, id, path, imageFormat, this]() {
+       controller->createVisualCapture(id, path, imageFormat);
     };
     // QTimer::singleShot(delay, controller, f); // requires Qt 5.4
     doLater(delay, controller, f);
 }
 
-void FlameshotDBusAdapter::fullScreen(
-        QString path, bool toClipboard, int delay, uint id)
+void FlameshotDBusAdapter::fullScreenAs(
+        QString path, bool toClipboard, int delay, uint id, QString format)
 {
-    auto f = [id, path, toClipboard, this]() {
+    ImageEncoder::Format imageFormat;
+    if (!ImageEncoder::parseFormat(format, imageFormat)) {
+        Q_EMIT captureFailed(id);
+        return;
+    }
+    auto f = [id, path, toClipboard, imageFormat, this]() {
         bool ok = true;
         QPixmap p(ScreenGrabber().grabEntireDesktop(ok));
         if (!ok) {
@@ -75,21 +176,331 @@ void FlameshotDBusAdapter::fullScreen(
             Q_EMIT captureFailed(id);
             return;
         }
+        // every destination shares the encodings of the capture
+        ResourceExporter exporter(p);
         if(toClipboard) {
-            ResourceExporter().captureToClipboard(p);
+            exporter.captureToClipboard();
         }
         if(!path.isEmpty()) {
-            ResourceExporter().captureToFile(p, path);
+            exporter.captureToFile(path);
+        }
+        if (id != 0) {
+            exporter.captureToRaw(id, imageFormat);
         }
-        QByteArray byteArray;
-        QBuffer buffer(&byteArray);
-        p.save(&buffer, "PNG");
-        Q_EMIT captureTaken(id, byteArray);
     };
     //QTimer::singleShot(delay, this, f); // // requires Qt 5.4
     doLater(delay, this, f);
 }
 
+// graphicCaptureFd and fullScreenFd reply when the capture is ready with a
+// file descriptor of the image in @format and its size, the image goes only
+// to the caller and without copies through the bus
+QDBusUnixFileDescriptor FlameshotDBusAdapter::graphicCaptureFd(
+        QString path, int delay, QString format, const QDBusMessage &message,
+        QString &, int &, int &)
+{
+    message.setDelayedReply(true);
+    ImageEncoder::Format imageFormat;
+    if (!ImageEncoder::parseFormat(format, imageFormat)) {
+        QDBusConnection::sessionBus().send(message.createErrorReply(
+                QDBusError::InvalidArgs, tr("Unknown format ") + format));
+        return QDBusUnixFileDescriptor();
+    }
+    // the ids of the pending replies are only used with exportTaken and
+    // exportFailed, apart from the ids chosen by the callers
+    const uint id = ++m_lastReplyId;
+    m_pendingReplies.insert(id, { message, imageFormat });
+    auto controller =  Controller::getInstance();
+
+    auto f = [controller, id, path]() {
+       controller->createExportCapture(id, path);
+    };
+    doLater(delay, controller, f);
+    return QDBusUnixFileDescriptor();
+}
+
+QDBusUnixFileDescriptor FlameshotDBusAdapter::fullScreenFd(
+        QString path, bool toClipboard, int delay, QString format,
+        const QDBusMessage &message, QString &, int &, int &)
+{
+    message.setDelayedReply(true);
+    ImageEncoder::Format imageFormat;
+    if (!ImageEncoder::parseFormat(format, imageFormat)) {
+        QDBusConnection::sessionBus().send(message.createErrorReply(
+                QDBusError::InvalidArgs, tr("Unknown format ") + format));
+        return QDBusUnixFileDescriptor();
+    }
+    auto f = [message, path, toClipboard, imageFormat, this]() {
+        bool ok = true;
+        QPixmap p(ScreenGrabber().grabEntireDesktop(ok));
+        if (!ok) {
+            SystemNotification().sendMessage(tr("Unable to capture screen"));
+            QDBusConnection::sessionBus().send(message.createErrorReply(
+                    QDBusError::Failed, tr("Unable to capture screen")));
+            return;
+        }
+        ResourceExporter exporter(p);
+        if(toClipboard) {
+            exporter.captureToClipboard();
+        }
+        if(!path.isEmpty()) {
+            exporter.captureToFile(path);
+        }
+        replyWithImage(message, exporter.pipeline(), imageFormat);
+    };
+    doLater(delay, this, f);
+    return QDBusUnixFileDescriptor();
+}
+
+// diffCaptureFd compares two captures, an empty @after means the current
+// desktop and an empty @before the last saved capture. It replies like
+// graphicCaptureFd with the annotated image as PNG and the changed areas.
+QDBusUnixFileDescriptor FlameshotDBusAdapter::diffCaptureFd(
+        QString before, QString after, QString path,
+        const QDBusMessage &message, QString &, int &, int &, QStringList &)
+{
+    message.setDelayedReply(true);
+    QImage afterCapture;
+    if (after.isEmpty()) {
+        bool ok = true;
+        afterCapture = ScreenGrabber().grabEntireDesktop(ok).toImage();
+        if (!ok) {
+            SystemNotification().sendMessage(tr("Unable to capture screen"));
+            QDBusConnection::sessionBus().send(message.createErrorReply(
+                    QDBusError::Failed, tr("Unable to capture screen")));
+            return QDBusUnixFileDescriptor();
+        }
+    }
+    if (before.isEmpty()) {
+        before = ConfigHandler().lastCapturePathValue();
+    }
+
+    auto watcher = new QFutureWatcher<DiffResult>(this);
+    connect(watcher, &QFutureWatcher<DiffResult>::finished, this,
+            [this, watcher, message, path]()
+    {
+        DiffResult res = watcher->result();
+        watcher->deleteLater();
+        if (res.annotated.isNull()) {
+            SystemNotification().sendMessage(tr("Unable to load the captures"));
+            QDBusConnection::sessionBus().send(message.createErrorReply(
+                    QDBusError::Failed, tr("Unable to load the captures")));
+            return;
+        }
+        // the file and the reply share the PNG encoding
+        QSharedPointer<ExportPipeline> capture(
+                    new ExportPipeline(res.annotated));
+        if (!path.isEmpty()) {
+            const EncoderSelector::Choice png {
+                EncoderSelector::ENCODING_PNG, QVector<QRgb>(), ".png",
+                QString()
+            };
+            const QString completePath =
+                    FileNameHandler().generateAbsolutePath(path) + ".png";
+            SaveQueue::getInstance()->enqueue(capture, completePath, png);
+        }
+        replyWithImage(message, capture, ImageEncoder::FORMAT_PNG,
+                       QVariantList() << res.rects);
+    });
+    watcher->setFuture(QtConcurrent::run(compareCaptures, before, after,
+                                         afterCapture));
+    return QDBusUnixFileDescriptor();
+}
+
+void FlameshotDBusAdapter::handleExportTaken(
+        uint id, QSharedPointer<ExportPipeline> capture)
+{
+    if (m_pendingReplies.contains(id)) {
+        PendingReply pending = m_pendingReplies.take(id);
+        replyWithImage(pending.message, capture, pending.format);
+    }
+}
+
+void FlameshotDBusAdapter::handleExportFailed(uint id) {
+    if (m_pendingReplies.contains(id)) {
+        QDBusConnection::sessionBus().send(
+                    m_pendingReplies.take(id).message.createErrorReply(
+                        QDBusError::Failed, tr("Screenshot failed")));
+    }
+}
+
+// replyWithImage encodes the capture in a worker thread and sends its file
+// descriptor as the reply of the call, followed by @extraArguments
+void FlameshotDBusAdapter::replyWithImage(
+        const QDBusMessage &message,
+        const QSharedPointer<ExportPipeline> &capture,
+        const ImageEncoder::Format format, const QVariantList &extraArguments)
+{
+    const int width = capture->image().width();
+    const int height = capture->image().height();
+    auto watcher = new QFutureWatcher<int>(this);
+    connect(watcher, &QFutureWatcher<int>::finished, this,
+            [watcher, message, format, width, height, extraArguments]()
+    {
+        const int fd = watcher->result();
+        watcher->deleteLater();
+        if (fd < 0) {
+            QDBusConnection::sessionBus().send(message.createErrorReply(
+                    QDBusError::Failed, tr("Unable to encode the capture")));
+            return;
+        }
+        // the descriptor is duplicated by QDBusUnixFileDescriptor
+        QDBusUnixFileDescriptor descriptor(fd);
+        ::close(fd);
+        QDBusMessage reply = message.createReply();
+        reply << QVariant::fromValue(descriptor)
+              << ImageEncoder::formatNames().at(format) << width << height;
+        for (const QVariant &argument: extraArguments) {
+            reply << argument;
+        }
+        QDBusConnection::sessionBus().send(reply);
+    });
+    // the encoding may be shared with other destinations of the capture,
+    // waiting for it in the pool is fine as Qt runs it here if not started
+    watcher->setFuture(QtConcurrent::run([capture, format]() {
+        return writeSealedImage(capture->encoding(format).result().data);
+    }));
+}
+
+// streamFrames writes raw frames of the area to @output until the caller
+// stops the stream, closes the descriptor or leaves the bus. An empty area
+// means the whole desktop and @fps 0 a frame per triggerFrame call. It
+// returns the id of the stream, or 0 when it can't start.
+uint FlameshotDBusAdapter::streamFrames(
+        QDBusUnixFileDescriptor output, int x, int y, int width, int height,
+        int fps, const QDBusMessage &message)
+{
+    const int fd = output.isValid() ? ::dup(output.fileDescriptor()) : -1;
+    if (fd < 0 || fps < 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return 0;
+    }
+    if (++m_lastStreamId == 0) {
+        ++m_lastStreamId;
+    }
+    const uint id = m_lastStreamId;
+    auto stream = new FrameStream(id, fd, QRect(x, y, width, height), fps,
+                                  this);
+    m_streams.insert(id, stream);
+    connect(stream, &FrameStream::finished, this,
+            [this, id](uint, uint frames, uint dropped)
+    {
+        m_streams.remove(id);
+        Q_EMIT streamFinished(id, frames, dropped);
+    });
+    auto watcher = new QDBusServiceWatcher(
+                message.service(), QDBusConnection::sessionBus(),
+                QDBusServiceWatcher::WatchForUnregistration, stream);
+    connect(watcher, &QDBusServiceWatcher::serviceUnregistered,
+            stream, &FrameStream::stop);
+    return id;
+}
+
+void FlameshotDBusAdapter::triggerFrame(uint stream) {
+    if (FrameStream *s = m_streams.value(stream)) {
+        s->trigger();
+    }
+}
+
+void FlameshotDBusAdapter::stopStream(uint stream) {
+    if (FrameStream *s = m_streams.value(stream)) {
+        s->stop();
+    }
+}
+
+// startBurst grabs @frames frames of the area every @interval ms, with
+// @ring it keeps the last ones until stopBurst or until the caller leaves
+// the bus. It returns the id of the burst, or 0 when it can't start.
+uint FlameshotDBusAdapter::startBurst(
+        QString path, int x, int y, int width, int height, int frames,
+        int interval, bool ring, const QDBusMessage &message)
+{
+    if (frames < 1 || frames > MAX_BURST_FRAMES || interval < 1) {
+        return 0;
+    }
+    if (++m_lastBurstId == 0) {
+        ++m_lastBurstId;
+    }
+    const uint id = m_lastBurstId;
+    auto burst = new BurstCapture(id, QRect(x, y, width, height), frames,
+                                  interval, ring, path, this);
+    m_bursts.insert(id, burst);
+    connect(burst, &BurstCapture::flushed,
+            this, &FlameshotDBusAdapter::burstFlushed);
+    connect(burst, &BurstCapture::finished, this,
+            [this, id](uint, uint frames, uint dropped)
+    {
+        m_bursts.remove(id);
+        Q_EMIT burstFinished(id, frames, dropped);
+    });
+    auto watcher = new QDBusServiceWatcher(
+                message.service(), QDBusConnection::sessionBus(),
+                QDBusServiceWatcher::WatchForUnregistration, burst);
+    connect(watcher, &QDBusServiceWatcher::serviceUnregistered,
+            burst, &BurstCapture::stop);
+    return id;
+}
+
+void FlameshotDBusAdapter::flushBurst(uint burst) {
+    if (BurstCapture *b = m_bursts.value(burst)) {
+        b->flush();
+    }
+}
+
+void FlameshotDBusAdapter::stopBurst(uint burst) {
+    if (BurstCapture *b = m_bursts.value(burst)) {
+        b->stop();
+    }
+}
+
+// watchRegion saves the area every time more than @threshold percent of
+// its tiles change, as PNG files in @path or as frames of the @timelapse
+// file when it isn't empty. It returns the id of the watch, or 0 when it
+// can't start.
+uint FlameshotDBusAdapter::watchRegion(
+        QString path, QString timelapse, int x, int y, int width, int height,
+        int interval, int threshold, const QDBusMessage &message)
+{
+    if (interval < 1 || threshold < 0 || threshold > 100) {
+        return 0;
+    }
+    if (++m_lastWatchId == 0) {
+        ++m_lastWatchId;
+    }
+    const uint id = m_lastWatchId;
+    auto watch = new RegionWatcher(id, QRect(x, y, width, height), interval,
+                                   threshold, path, timelapse, this);
+    m_watchers.insert(id, watch);
+    connect(watch, &RegionWatcher::saved,
+            this, &FlameshotDBusAdapter::watchSaved);
+    connect(watch, &RegionWatcher::finished, this,
+            [this, id](uint, uint grabs, uint saved)
+    {
+        m_watchers.remove(id);
+        Q_EMIT watchFinished(id, grabs, saved);
+    });
+    auto watcher = new QDBusServiceWatcher(
+                message.service(), QDBusConnection::sessionBus(),
+                QDBusServiceWatcher::WatchForUnregistration, watch);
+    connect(watcher, &QDBusServiceWatcher::serviceUnregistered,
+            watch, &RegionWatcher::stop);
+    return id;
+}
+
+void FlameshotDBusAdapter::stopWatch(uint watch) {
+    if (RegionWatcher *w = m_watchers.value(watch)) {
+        w->stop();
+    }
+}
+
+// runPipeline returns false when the config has no pipeline with that name,
+// the pipeline reports its own errors
+bool FlameshotDBusAdapter::runPipeline(QString name) {
+    return Controller::getInstance()->runPipeline(name);
+}
+
 void FlameshotDBusAdapter::openConfig() {
     Controller::getInstance()->openConfigWindow();
 }
@@ -19,8 +19,16 @@
 #define FLAMESHOTDBUSADAPTER_H
 
 #include <QtDBus/QDBusAbstractAdaptor>
+#include <QtDBus/QDBusMessage>
+#include <QtDBus/QDBusUnixFileDescriptor>
+#include <QHash>
+#include <QPointer>
 #include "src/core/controller.h"
 
+class FrameStream;
+class BurstCapture;
+class RegionWatcher;
+
 class FlameshotDBusAdapter : public QDBusAbstractAdaptor
 {
     Q_OBJECT
@@ -33,13 +41,73 @@ public:
 signals:
     void captureTaken(uint id, QByteArray rawImage);
     void captureFailed(uint id);
+    void streamFinished(uint stream, uint frames, uint dropped);
+    void burstFlushed(uint burst, QStringList paths);
+    void burstFinished(uint burst, uint frames, uint dropped);
+    void watchSaved(uint watch, uint frame, QString path);
+    void watchFinished(uint watch, uint grabs, uint saved);
 
 public slots:
     Q_NOREPLY void graphicCapture(QString path, int delay, uint id);
     Q_NOREPLY void fullScreen(QString path, bool toClipboard, int delay, uint id);
+    Q_NOREPLY void graphicCaptureAs(QString path, int delay, uint id,
+                                    QString format);
+    Q_NOREPLY void fullScreenAs(QString path, bool toClipboard, int delay,
+                                uint id, QString format);
+    QDBusUnixFileDescriptor graphicCaptureFd(
+            QString path, int delay, QString format,
+            const QDBusMessage &message,
+            QString &imageFormat, int &width, int &height);
+    QDBusUnixFileDescriptor fullScreenFd(
+            QString path, bool toClipboard, int delay, QString format,
+            const QDBusMessage &message,
+            QString &imageFormat, int &width, int &height);
+    QDBusUnixFileDescriptor diffCaptureFd(
+            QString before, QString after, QString path,
+            const QDBusMessage &message,
+            QString &imageFormat, int &width, int &height,
+            QStringList &rects);
+    uint streamFrames(QDBusUnixFileDescriptor output, int x, int y,
+                      int width, int height, int fps,
+                      const QDBusMessage &message);
+    Q_NOREPLY void triggerFrame(uint stream);
+    Q_NOREPLY void stopStream(uint stream);
+    uint startBurst(QString path, int x, int y, int width, int height,
+                    int frames, int interval, bool ring,
+                    const QDBusMessage &message);
+    Q_NOREPLY void flushBurst(uint burst);
+    Q_NOREPLY void stopBurst(uint burst);
+    uint watchRegion(QString path, QString timelapse, int x, int y,
+                     int width, int height, int interval, int threshold,
+                     const QDBusMessage &message);
+    Q_NOREPLY void stopWatch(uint watch);
+    bool runPipeline(QString name);
     Q_NOREPLY void openConfig();
     Q_NOREPLY void trayIconEnabled(bool enabled);
 
+private slots:
+    void handleExportTaken(uint id, QSharedPointer<ExportPipeline> capture);
+    void handleExportFailed(uint id);
+
+private:
+    // GUI captures waiting to be returned by graphicCaptureFd
+    struct PendingReply {
+        QDBusMessage message;
+        ImageEncoder::Format format;
+    };
+    QHash<uint, PendingReply> m_pendingReplies;
+    uint m_lastReplyId;
+    QHash<uint, QPointer<FrameStream>> m_streams;
+    uint m_lastStreamId;
+    QHash<uint, QPointer<BurstCapture>> m_bursts;
+    uint m_lastBurstId;
+    QHash<uint, QPointer<RegionWatcher>> m_watchers;
+    uint m_lastWatchId;
+
+    void replyWithImage(const QDBusMessage &message,
+                        const QSharedPointer<ExportPipeline> &capture,
+                        const ImageEncoder::Format format,
+                        const QVariantList &extraArguments = QVariantList());
 };
 
 #endif // FLAMESHOTDBUSADAPTER_H
@@ -0,0 +1,374 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "frameserver.h"
+#include "src/utils/screengrabber.h"
+#include "src/utils/systemnotification.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QScreen>
+#include <QFile>
+#include <QImage>
+#include <QPixmap>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QRegExp>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cstring>
+
+// FrameServer shares fresh desktop frames between local clients. A client
+// connects to the socket and sends a single line:
+//
+//     subscribe desktop|screen N|area WxH+X+Y FPS [SLOTS]
+//
+// and the server answers "ok PATH" or "error MESSAGE". PATH is a file in
+// shared memory with a ring of SLOTS frames, 3 by default, and the line
+// "frame SEQUENCE" is sent after writing each frame.
+//
+// The file starts with a header of 64 bytes with native endian fields: the
+// magic "FSRB", the version, the number of slots, the size of a slot, the
+// maximum width and height and the bytes per line of the frames, and at
+// offset 32 the sequence of the latest frame (64 bit). The frame N, from 1,
+// is in the slot (N - 1) % SLOTS. A slot starts with 32 bytes: its sequence
+// (64 bit), the microseconds since the server started (64 bit), the width
+// and the height of the frame, followed by the BGRA rows. The sequence of
+// a slot is 0 while it is being written, a reader copies the frame and then
+// checks that the sequence didn't change.
+//
+// All the subscriptions due at a tick share a single grab of their areas.
+
+namespace {
+
+const char RING_MAGIC[4] = { 'F', 'S', 'R', 'B' };
+const quint32 RING_VERSION = 1;
+const int HEADER_SIZE = 64;
+const int LATEST_OFFSET = 32;
+const int SLOT_HEADER_SIZE = 32;
+const int DEFAULT_SLOTS = 3;
+const int MAX_SLOTS = 16;
+const int MAX_FPS = 60;
+const int MAX_REQUEST_LENGTH = 256;
+// notifications waiting for a client which doesn't read them, the frames
+// are still written
+const int MAX_PENDING_NOTIFICATIONS = 4096;
+
+// parseGeometry reads the X11 geometry format WxH+X+Y
+bool parseGeometry(const QString &text, QRect &rect) {
+    QRegExp geometry("(\\d+)x(\\d+)\\+(-?\\d+)\\+(-?\\d+)");
+    if (!geometry.exactMatch(text)) {
+        return false;
+    }
+    rect = QRect(geometry.cap(3).toInt(), geometry.cap(4).toInt(),
+                 geometry.cap(1).toInt(), geometry.cap(2).toInt());
+    return !rect.isEmpty();
+}
+
+// the sequences are read by the clients while the frames are written
+void storeSequence(uchar *at, const quint64 sequence) {
+    __atomic_store_n(reinterpret_cast<quint64 *>(at), sequence,
+                     __ATOMIC_RELEASE);
+}
+
+} // unnamed namespace
+
+FrameServer::FrameServer(QObject *parent) :
+    QObject(parent), m_server(nullptr), m_lastRing(0)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &FrameServer::tick);
+}
+
+FrameServer *FrameServer::getInstance() {
+    static FrameServer s;
+    return &s;
+}
+
+// start listens in the runtime folder, only the user can connect
+bool FrameServer::start() {
+    if (m_server) {
+        return true;
+    }
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    // the socket of a previous instance may be left
+    QLocalServer::removeServer(socketPath());
+    if (!m_server->listen(socketPath())) {
+        SystemNotification().sendMessage(
+                    tr("Unable to start the frame server: ") +
+                    m_server->errorString());
+        delete m_server;
+        m_server = nullptr;
+        return false;
+    }
+    connect(m_server, &QLocalServer::newConnection,
+            this, &FrameServer::handleConnection);
+    m_clock.start();
+    return true;
+}
+
+void FrameServer::stop() {
+    m_timer.stop();
+    while (!m_subscriptions.isEmpty()) {
+        unsubscribe(m_subscriptions.first()->socket);
+    }
+    delete m_server;
+    m_server = nullptr;
+}
+
+QString FrameServer::socketPath() const {
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation)
+            + "/flameshot-frames";
+}
+
+void FrameServer::handleConnection() {
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            readRequest(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            unsubscribe(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+// tick grabs the union of the areas due and copies every area to its ring
+void FrameServer::tick() {
+    const qint64 now = m_clock.elapsed();
+    QList<Subscription *> due;
+    QRect united;
+    for (Subscription *s: m_subscriptions) {
+        if (s->nextFrame > now) {
+            continue;
+        }
+        due.append(s);
+        united = united.united(s->area);
+        // a late tick doesn't make the next frames come sooner
+        s->nextFrame += s->interval;
+        if (s->nextFrame <= now) {
+            s->nextFrame = now + s->interval;
+        }
+    }
+    bool ok = !due.isEmpty();
+    const QPixmap p = ok ? ScreenGrabber().grabArea(united, ok) : QPixmap();
+    if (ok) {
+        QImage grab = p.toImage();
+        if (grab.format() != QImage::Format_RGB32) {
+            grab = grab.convertToFormat(QImage::Format_RGB32);
+        }
+        const qreal ratio = p.devicePixelRatio();
+        const quint64 timestamp = m_clock.nsecsElapsed() / 1000;
+        auto copyArea = [&grab, united, ratio, timestamp](Subscription *s) {
+            const QRect r = s->area.translated(-united.topLeft());
+            writeFrame(s, grab, QRect(r.topLeft() * ratio, r.size() * ratio),
+                       timestamp);
+        };
+        QtConcurrent::blockingMap(due, copyArea);
+        for (Subscription *s: due) {
+            if (s->socket->bytesToWrite() < MAX_PENDING_NOTIFICATIONS) {
+                s->socket->write(QString("frame %1\n").arg(s->sequence)
+                                 .toLatin1());
+            }
+        }
+    }
+    scheduleTick();
+}
+
+// readRequest handles the first line of a client, anything after it is
+// ignored
+void FrameServer::readRequest(QLocalSocket *socket) {
+    for (Subscription *s: m_subscriptions) {
+        if (s->socket == socket) {
+            socket->readAll();
+            return;
+        }
+    }
+    if (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > MAX_REQUEST_LENGTH) {
+            socket->disconnectFromServer();
+        }
+        return;
+    }
+    const QString request = QString::fromLatin1(socket->readLine()).trimmed();
+    QString error;
+    if (!subscribe(socket, request, error)) {
+        socket->write(QString("error %1\n").arg(error).toUtf8());
+        socket->disconnectFromServer();
+    }
+}
+
+bool FrameServer::subscribe(QLocalSocket *socket, const QString &request,
+                            QString &error)
+{
+    const QStringList args = request.split(' ', QString::SkipEmptyParts);
+    if (args.value(0) != "subscribe") {
+        error = "unknown request";
+        return false;
+    }
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    QRect desktop;
+    for (QScreen *const screen : screens) {
+        desktop = desktop.united(screen->geometry());
+    }
+    QRect area;
+    // index of the rate, after the target
+    int rateIndex = 3;
+    const QString target = args.value(1);
+    bool ok = true;
+    if (target == "desktop") {
+        area = desktop;
+        rateIndex = 2;
+    } else if (target == "screen") {
+        const int n = args.value(2).toInt(&ok);
+        if (!ok || n < 0 || n >= screens.size()) {
+            error = "unknown screen";
+            return false;
+        }
+        area = screens.at(n)->geometry();
+    } else if (target != "area" || !parseGeometry(args.value(2), area)) {
+        error = "unknown target";
+        return false;
+    }
+    area = area.intersected(desktop);
+    if (area.isEmpty()) {
+        error = "the area is outside of the desktop";
+        return false;
+    }
+    const int fps = args.value(rateIndex).toInt(&ok);
+    if (!ok || fps < 1 || fps > MAX_FPS) {
+        error = QString("the rate must be a number from 1 to %1").arg(MAX_FPS);
+        return false;
+    }
+    int slotCount = DEFAULT_SLOTS;
+    if (args.size() > rateIndex + 1) {
+        slotCount = args.at(rateIndex + 1).toInt(&ok);
+        if (!ok || slotCount < 2 || slotCount > MAX_SLOTS) {
+            error = QString("the slots must be a number from 2 to %1")
+                    .arg(MAX_SLOTS);
+            return false;
+        }
+    }
+    if (args.size() > rateIndex + 2) {
+        error = "too many arguments";
+        return false;
+    }
+
+    const qreal ratio = QApplication::desktop()->devicePixelRatio();
+    const int width = qCeil(area.width() * ratio);
+    const int height = qCeil(area.height() * ratio);
+    auto s = new Subscription;
+    s->socket = socket;
+    s->area = area;
+    s->interval = 1000 / fps;
+    s->nextFrame = m_clock.elapsed();
+    s->slotCount = slotCount;
+    s->bytesPerLine = width * 4;
+    s->maxHeight = height;
+    s->slotSize = SLOT_HEADER_SIZE + static_cast<qint64>(s->bytesPerLine) * height;
+    s->sequence = 0;
+    s->map = nullptr;
+    const qint64 size = HEADER_SIZE + s->slotSize * slotCount;
+    const QString path = QString("%1-%2-%3").arg(socketPath())
+            .arg(QCoreApplication::applicationPid()).arg(++m_lastRing);
+    s->ring = new QFile(path);
+    if (!s->ring->open(QIODevice::ReadWrite | QIODevice::Truncate) ||
+            !s->ring->setPermissions(QFile::ReadOwner | QFile::WriteOwner) ||
+            !s->ring->resize(size) ||
+            !(s->map = s->ring->map(0, size)))
+    {
+        s->ring->remove();
+        delete s->ring;
+        delete s;
+        error = "unable to create the shared memory";
+        return false;
+    }
+    std::memcpy(s->map, RING_MAGIC, sizeof(RING_MAGIC));
+    const quint32 fields[] = {
+        RING_VERSION, static_cast<quint32>(slotCount),
+        static_cast<quint32>(s->slotSize), static_cast<quint32>(width),
+        static_cast<quint32>(height), static_cast<quint32>(s->bytesPerLine)
+    };
+    std::memcpy(s->map + sizeof(RING_MAGIC), fields, sizeof(fields));
+
+    m_subscriptions.append(s);
+    socket->write(QString("ok %1\n").arg(path).toUtf8());
+    scheduleTick();
+    return true;
+}
+
+// unsubscribe removes the ring, the clients which mapped it keep their copy
+void FrameServer::unsubscribe(QLocalSocket *socket) {
+    for (int i = 0; i < m_subscriptions.size(); ++i) {
+        Subscription *s = m_subscriptions.at(i);
+        if (s->socket != socket) {
+            continue;
+        }
+        m_subscriptions.removeAt(i);
+        s->ring->unmap(s->map);
+        s->ring->remove();
+        delete s->ring;
+        delete s;
+        break;
+    }
+    scheduleTick();
+}
+
+// scheduleTick waits for the subscription due first
+void FrameServer::scheduleTick() {
+    if (m_subscriptions.isEmpty()) {
+        m_timer.stop();
+        return;
+    }
+    qint64 next = m_subscriptions.first()->nextFrame;
+    for (Subscription *s: m_subscriptions) {
+        next = qMin(next, s->nextFrame);
+    }
+    m_timer.start(qMax<qint64>(0, next - m_clock.elapsed()));
+}
+
+// writeFrame runs in a worker thread, each subscription has its own ring
+void FrameServer::writeFrame(Subscription *s, const QImage &grab,
+                             const QRect &source, const quint64 timestamp)
+{
+    QRect r = source.intersected(grab.rect());
+    r.setWidth(qMin(r.width(), s->bytesPerLine / 4));
+    r.setHeight(qMin(r.height(), s->maxHeight));
+    const quint64 sequence = s->sequence + 1;
+    uchar *slot = s->map + HEADER_SIZE +
+            ((sequence - 1) % s->slotCount) * s->slotSize;
+    storeSequence(slot, 0);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    std::memcpy(slot + 8, &timestamp, sizeof(timestamp));
+    const quint32 size[] = { static_cast<quint32>(r.width()),
+                             static_cast<quint32>(r.height()) };
+    std::memcpy(slot + 16, size, sizeof(size));
+    uchar *pixels = slot + SLOT_HEADER_SIZE;
+    const size_t rowBytes = r.width() * 4;
+    for (int y = 0; y < r.height(); ++y) {
+        std::memcpy(pixels + static_cast<qint64>(y) * s->bytesPerLine,
+                    grab.constScanLine(r.y() + y) + r.x() * 4, rowBytes);
+    }
+    storeSequence(slot, sequence);
+    storeSequence(s->map + LATEST_OFFSET, sequence);
+    s->sequence = sequence;
+}
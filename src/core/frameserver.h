@@ -0,0 +1,81 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMESERVER_H
+#define FRAMESERVER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QRect>
+#include <QList>
+
+class QLocalServer;
+class QLocalSocket;
+class QFile;
+class QImage;
+
+class FrameServer : public QObject
+{
+    Q_OBJECT
+public:
+    static FrameServer* getInstance();
+
+    bool start();
+    void stop();
+    QString socketPath() const;
+
+private slots:
+    void handleConnection();
+    void tick();
+
+private:
+    // a client and its ring of frames in shared memory
+    struct Subscription {
+        QLocalSocket *socket;
+        // logical desktop coordinates
+        QRect area;
+        int interval;
+        qint64 nextFrame;
+        QFile *ring;
+        uchar *map;
+        int slotCount;
+        qint64 slotSize;
+        int bytesPerLine;
+        int maxHeight;
+        quint64 sequence;
+    };
+
+    explicit FrameServer(QObject *parent = nullptr);
+
+    QLocalServer *m_server;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    QList<Subscription *> m_subscriptions;
+    int m_lastRing;
+
+    void readRequest(QLocalSocket *socket);
+    bool subscribe(QLocalSocket *socket, const QString &request,
+                   QString &error);
+    void unsubscribe(QLocalSocket *socket);
+    void scheduleTick();
+
+    static void writeFrame(Subscription *s, const QImage &grab,
+                           const QRect &source, const quint64 timestamp);
+};
+
+#endif // FRAMESERVER_H
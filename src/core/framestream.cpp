@@ -0,0 +1,247 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "framestream.h"
+#include "src/utils/screengrabber.h"
+#include "src/utils/systemnotification.h"
+#include <QTimer>
+#include <QPixmap>
+#include <QSocketNotifier>
+#include <QtEndian>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// FrameStream writes raw captures to a file descriptor, usually the stdout
+// of a CLI call piped into an encoder. A frame is grabbed on every tick of
+// the timer or on every trigger; while the consumer is still reading the
+// previous frame the new one is dropped instead of queued, so a slow reader
+// never makes the daemon buffer frames. The descriptor is non-blocking and
+// the rest of a frame is written each time it can take more, a stalled
+// reader doesn't hold any thread.
+
+namespace {
+
+// every frame starts with a header of little-endian fields: the magic
+// "FSFR", the payload length, the microseconds since the start of the
+// stream (64 bits), the width, the height, the sequence number and the
+// frames dropped since the previous one. The payload is the BGRA rows of
+// the frame without padding.
+const char FRAME_MAGIC[4] = { 'F', 'S', 'F', 'R' };
+const int HEADER_SIZE = 32;
+// buffers per writev call, the IOV_MAX of Linux
+const int MAX_BUFFERS = 1024;
+
+// writeSome writes the buffers from @first until the descriptor is full, it
+// returns false when the consumer is gone. SIGPIPE is blocked in the thread
+// while writing, a closed pipe is only an EPIPE error and the handler of the
+// process isn't changed.
+bool writeSome(const int fd, QVector<iovec> &buffers, int &first) {
+    sigset_t pipeSignal, oldMask, pending;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &oldMask);
+    sigpending(&pending);
+    const bool wasPending = sigismember(&pending, SIGPIPE);
+    bool ok = true;
+    while (first < buffers.size()) {
+        const int count = qMin(buffers.size() - first, MAX_BUFFERS);
+        ssize_t n = ::writev(fd, buffers.data() + first, count);
+        if (n < 0) {
+            const int error = errno;
+            if (error == EINTR) {
+                continue;
+            }
+            ok = error == EAGAIN || error == EWOULDBLOCK;
+            if (error == EPIPE && !wasPending) {
+                // take the signal raised by this write before unblocking it
+                const timespec noWait = { 0, 0 };
+                sigtimedwait(&pipeSignal, nullptr, &noWait);
+            }
+            break;
+        }
+        // skip the written buffers and advance the one written in part
+        while (first < buffers.size() &&
+               static_cast<size_t>(n) >= buffers.at(first).iov_len)
+        {
+            n -= buffers.at(first).iov_len;
+            ++first;
+        }
+        if (n > 0) {
+            iovec &b = buffers[first];
+            b.iov_base = static_cast<char *>(b.iov_base) + n;
+            b.iov_len -= n;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+    return ok;
+}
+
+// privateDescriptor opens the pipe @fd again with a file description of its
+// own, so making it non-blocking doesn't change the stdout of the CLI and of
+// the shell sharing it. It returns -1 for other files or without /proc.
+int privateDescriptor(const int fd) {
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || !S_ISFIFO(info.st_mode)) {
+        return -1;
+    }
+    const QByteArray path = "/proc/self/fd/" + QByteArray::number(fd);
+    return ::open(path.constData(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+}
+
+} // unnamed namespace
+
+// an empty @area streams the whole desktop and @fps 0 grabs a frame only
+// on each trigger. The stream owns @fd.
+FrameStream::FrameStream(const uint id, const int fd, const QRect &area,
+                         const int fps, QObject *parent) :
+    QObject(parent), m_id(id), m_fd(fd), m_area(area), m_firstBuffer(0),
+    m_writing(false), m_stopping(false), m_frames(0), m_dropped(0),
+    m_pendingDrops(0), m_sharedFlags(-1)
+{
+    const int reopened = privateDescriptor(m_fd);
+    if (reopened >= 0) {
+        ::close(m_fd);
+        m_fd = reopened;
+    } else {
+        // the flags belong to the caller too, they are given back at the end
+        m_sharedFlags = ::fcntl(m_fd, F_GETFL);
+        ::fcntl(m_fd, F_SETFL, m_sharedFlags | O_NONBLOCK);
+    }
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Write, this);
+    m_notifier->setEnabled(false);
+    connect(m_notifier, &QSocketNotifier::activated,
+            this, &FrameStream::writePending);
+    m_timer = new QTimer(this);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &FrameStream::trigger);
+    m_clock.start();
+    if (fps > 0) {
+        m_timer->start(1000 / fps);
+    }
+}
+
+FrameStream::~FrameStream() {
+    // the notifier can't outlive its descriptor
+    delete m_notifier;
+    if (m_sharedFlags >= 0) {
+        ::fcntl(m_fd, F_SETFL, m_sharedFlags);
+    }
+    ::close(m_fd);
+}
+
+uint FrameStream::id() const {
+    return m_id;
+}
+
+void FrameStream::trigger() {
+    if (m_stopping) {
+        return;
+    }
+    if (m_writing) {
+        ++m_dropped;
+        ++m_pendingDrops;
+        return;
+    }
+    const quint64 timestamp = m_clock.nsecsElapsed() / 1000;
+    bool ok = true;
+    ScreenGrabber grabber;
+    QPixmap p = m_area.isEmpty() ? grabber.grabEntireDesktop(ok) :
+                                   grabber.grabArea(m_area, ok);
+    if (!ok) {
+        SystemNotification().sendMessage(tr("Unable to capture screen"));
+        stop();
+        return;
+    }
+    m_frame = p.toImage();
+    if (m_frame.format() != QImage::Format_RGB32) {
+        m_frame = m_frame.convertToFormat(QImage::Format_RGB32);
+    }
+
+    m_header = QByteArray(HEADER_SIZE, 0);
+    uchar *h = reinterpret_cast<uchar *>(m_header.data());
+    std::memcpy(h, FRAME_MAGIC, sizeof(FRAME_MAGIC));
+    qToLittleEndian<quint32>(m_frame.width() * m_frame.height() * 4, h + 4);
+    qToLittleEndian<quint64>(timestamp, h + 8);
+    qToLittleEndian<quint32>(m_frame.width(), h + 16);
+    qToLittleEndian<quint32>(m_frame.height(), h + 20);
+    qToLittleEndian<quint32>(m_frames, h + 24);
+    qToLittleEndian<quint32>(m_pendingDrops, h + 28);
+    ++m_frames;
+    m_pendingDrops = 0;
+
+    // the rows go straight from the image to the descriptor without being
+    // copied in a buffer
+    const size_t rowBytes = m_frame.width() * 4;
+    m_buffers.clear();
+    m_buffers.reserve(m_frame.height() + 1);
+    m_buffers.append({ m_header.data(),
+                       static_cast<size_t>(m_header.size()) });
+    if (m_frame.bytesPerLine() == static_cast<int>(rowBytes)) {
+        m_buffers.append({ const_cast<uchar *>(m_frame.constBits()),
+                           rowBytes * m_frame.height() });
+    } else {
+        for (int y = 0; y < m_frame.height(); ++y) {
+            m_buffers.append({ const_cast<uchar *>(m_frame.constScanLine(y)),
+                               rowBytes });
+        }
+    }
+    m_firstBuffer = 0;
+    m_writing = true;
+    writePending();
+}
+
+// stop ends the stream once the frame being written is complete
+void FrameStream::stop() {
+    if (m_stopping) {
+        return;
+    }
+    m_stopping = true;
+    m_timer->stop();
+    if (!m_writing) {
+        finish();
+    }
+}
+
+// writePending writes what the descriptor takes of the current frame and
+// waits for it to be writable again for the rest
+void FrameStream::writePending() {
+    const bool ok = writeSome(m_fd, m_buffers, m_firstBuffer);
+    if (ok && m_firstBuffer < m_buffers.size()) {
+        m_notifier->setEnabled(true);
+        return;
+    }
+    m_notifier->setEnabled(false);
+    m_writing = false;
+    m_buffers.clear();
+    m_frame = QImage();
+    if (m_stopping) {
+        finish();
+    } else if (!ok) {
+        // the consumer closed the pipe
+        stop();
+    }
+}
+
+void FrameStream::finish() {
+    Q_EMIT finished(m_id, m_frames, m_dropped);
+    deleteLater();
+}
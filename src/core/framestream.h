@@ -0,0 +1,73 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QElapsedTimer>
+#include <QVector>
+#include <sys/uio.h>
+
+class QTimer;
+class QSocketNotifier;
+
+class FrameStream : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameStream(const uint id, const int fd, const QRect &area,
+                         const int fps, QObject *parent = nullptr);
+    ~FrameStream();
+
+    uint id() const;
+
+signals:
+    void finished(uint id, uint frames, uint dropped);
+
+public slots:
+    void trigger();
+    void stop();
+
+private:
+    uint m_id;
+    int m_fd;
+    QRect m_area;
+    QTimer *m_timer;
+    QElapsedTimer m_clock;
+    QSocketNotifier *m_notifier;
+    // frame being written and the buffers of its unwritten part
+    QByteArray m_header;
+    QImage m_frame;
+    QVector<iovec> m_buffers;
+    int m_firstBuffer;
+    bool m_writing;
+    bool m_stopping;
+    quint32 m_frames;
+    quint32 m_dropped;
+    // frames dropped since the last written one
+    quint32 m_pendingDrops;
+    // flags of a descriptor shared with the caller, -1 if it's our own
+    int m_sharedFlags;
+
+    void writePending();
+    void finish();
+};
+
+#endif // FRAMESTREAM_H
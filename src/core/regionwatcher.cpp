@@ -0,0 +1,169 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "regionwatcher.h"
+#include "src/utils/screengrabber.h"
+#include "src/utils/pngencoder.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/filenamehandler.h"
+#include "src/utils/systemnotification.h"
+#include "src/utils/timelapsewriter.h"
+#include <QTimer>
+#include <QPixmap>
+#include <QDir>
+#include <QDateTime>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+// RegionWatcher grabs an area periodically and saves it only when enough
+// of its tiles changed since the last saved frame, so slow changes add up
+// until they reach the threshold. The first grab is always saved. The
+// frames are saved as PNG files or appended to a timelapse as key frames
+// and tile deltas. A grab while the previous frame is still being written
+// is skipped, the change is found again by the next one.
+
+namespace {
+
+// a key frame every this number of deltas bounds the work of a reader
+// seeking in the timelapse
+const int KEY_INTERVAL = 100;
+
+} // unnamed namespace
+
+// @threshold is the percentage of changed tiles needed to save a frame,
+// 0 saves any change. An empty @timelapse saves PNG files in @path.
+RegionWatcher::RegionWatcher(const uint id, const QRect &area,
+                             const int interval, const int threshold,
+                             const QString &path, const QString &timelapse,
+                             QObject *parent) :
+    QObject(parent), m_id(id), m_area(area), m_threshold(threshold),
+    m_directory(path), m_sinceKey(0), m_writing(false), m_stopping(false),
+    m_grabs(0), m_saves(0)
+{
+    if (!timelapse.isEmpty()) {
+        m_timelapse = QSharedPointer<TimelapseWriter>(
+                    new TimelapseWriter(timelapse, m_hasher.tileSize()));
+    }
+    if (m_directory.isEmpty()) {
+        m_directory = ConfigHandler().savePathValue();
+    }
+    if (m_directory.isEmpty() || !QDir(m_directory).exists()) {
+        m_directory = QStandardPaths::writableLocation(
+                    QStandardPaths::PicturesLocation);
+    }
+    m_writer = new QFutureWatcher<bool>(this);
+    connect(m_writer, &QFutureWatcher<bool>::finished,
+            this, &RegionWatcher::handleWritten);
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &RegionWatcher::grabFrame);
+    m_timer->start(qMax(interval, 1));
+}
+
+uint RegionWatcher::id() const {
+    return m_id;
+}
+
+void RegionWatcher::grabFrame() {
+    if (m_writing || m_stopping) {
+        return;
+    }
+    bool ok = true;
+    ScreenGrabber grabber;
+    QPixmap p = m_area.isEmpty() ? grabber.grabEntireDesktop(ok) :
+                                   grabber.grabArea(m_area, ok);
+    if (!ok) {
+        SystemNotification().sendMessage(tr("Unable to capture screen"));
+        stop();
+        return;
+    }
+    ++m_grabs;
+    QImage frame = p.toImage();
+    if (frame.format() != QImage::Format_RGB32) {
+        frame = frame.convertToFormat(QImage::Format_RGB32);
+    }
+    const QVector<quint64> hashes = m_hasher.hashTiles(frame);
+
+    bool key = m_saved.size() != frame.size();
+    QVector<int> changed;
+    if (!key) {
+        for (int i = 0; i < hashes.size(); ++i) {
+            if (hashes.at(i) != m_savedHashes.at(i)) {
+                changed.append(i);
+            }
+        }
+        if (changed.isEmpty() ||
+                changed.size() * 100 < m_threshold * hashes.size())
+        {
+            return;
+        }
+        // a delta of most tiles would be larger than the key frame
+        key = m_sinceKey >= KEY_INTERVAL || changed.size() * 2 > hashes.size();
+    }
+    m_saved = frame;
+    m_savedHashes = hashes;
+    m_writing = true;
+
+    const qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    if (m_timelapse) {
+        m_sinceKey = key ? 0 : m_sinceKey + 1;
+        m_writingPath = m_timelapse->path();
+        auto timelapse = m_timelapse;
+        m_writer->setFuture(QtConcurrent::run([=]() {
+            return key ? timelapse->appendKeyFrame(frame, timestamp) :
+                         timelapse->appendDelta(frame, changed, timestamp);
+        }));
+    } else {
+        m_writingPath = FileNameHandler().generateAbsolutePath(
+                    m_directory, m_area) + ".png";
+        const QString path = m_writingPath;
+        m_writer->setFuture(QtConcurrent::run([=]() {
+            return PngEncoder().save(frame, path);
+        }));
+    }
+}
+
+// stop ends the watch once the frame being written is complete
+void RegionWatcher::stop() {
+    if (m_stopping) {
+        return;
+    }
+    m_stopping = true;
+    m_timer->stop();
+    if (!m_writing) {
+        finish();
+    }
+}
+
+void RegionWatcher::handleWritten() {
+    m_writing = false;
+    if (m_writer->result()) {
+        Q_EMIT saved(m_id, m_saves++, m_writingPath);
+    } else {
+        SystemNotification().sendMessage(
+                    tr("Error trying to save as ") + m_writingPath);
+        m_stopping = true;
+        m_timer->stop();
+    }
+    if (m_stopping) {
+        finish();
+    }
+}
+
+void RegionWatcher::finish() {
+    Q_EMIT finished(m_id, m_grabs, m_saves);
+    deleteLater();
+}
@@ -0,0 +1,75 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef REGIONWATCHER_H
+#define REGIONWATCHER_H
+
+#include "src/utils/tilehasher.h"
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QSharedPointer>
+#include <QFutureWatcher>
+
+class QTimer;
+class TimelapseWriter;
+
+class RegionWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RegionWatcher(const uint id, const QRect &area,
+                           const int interval, const int threshold,
+                           const QString &path, const QString &timelapse,
+                           QObject *parent = nullptr);
+
+    uint id() const;
+
+signals:
+    void saved(uint id, uint frame, QString path);
+    void finished(uint id, uint grabs, uint saved);
+
+public slots:
+    void stop();
+
+private slots:
+    void grabFrame();
+    void handleWritten();
+
+private:
+    uint m_id;
+    QRect m_area;
+    int m_threshold;
+    QString m_directory;
+    QSharedPointer<TimelapseWriter> m_timelapse;
+    TileHasher m_hasher;
+    // the last saved frame, the next ones are compared with it
+    QImage m_saved;
+    QVector<quint64> m_savedHashes;
+    int m_sinceKey;
+    QString m_writingPath;
+    QTimer *m_timer;
+    QFutureWatcher<bool> *m_writer;
+    bool m_writing;
+    bool m_stopping;
+    quint32 m_grabs;
+    quint32 m_saves;
+
+    void finish();
+};
+
+#endif // REGIONWATCHER_H
@@ -19,25 +19,59 @@
 #include "src/capture/workers/imgur/imguruploader.h"
 #include "src/capture/workers/screenshotsaver.h"
 #include "src/capture/workers/graphicalscreenshotsaver.h"
+#include "src/core/controller.h"
 
-ResourceExporter::ResourceExporter() {
+// ResourceExporter sends one capture to any number of destinations, they
+// share the encodings through the ExportPipeline of the capture.
+
+ResourceExporter::ResourceExporter(const QPixmap &p) : m_pixmap(p) {
 
 }
 
-void ResourceExporter::captureToClipboard(const QPixmap &p) {
-    ScreenshotSaver().saveToClipboard(p);
+ResourceExporter::ResourceExporter(
+        const QSharedPointer<ExportPipeline> &capture) : m_pipeline(capture)
+{
+
 }
 
-void ResourceExporter::captureToFile(const QPixmap &p, const QString &path) {
-    ScreenshotSaver().saveToFilesystem(p, path);
+void ResourceExporter::captureToClipboard() {
+    ScreenshotSaver().saveToClipboard(pipeline());
 }
 
-void ResourceExporter::captureToFileUi(const QPixmap &p) {
-    auto w = new GraphicalScreenshotSaver(p);
+void ResourceExporter::captureToFile(const QString &path,
+                                     const QRect &geometry)
+{
+    ScreenshotSaver().saveToFilesystem(pipeline(), path, geometry);
+}
+
+void ResourceExporter::captureToFileUi(const QRect &geometry) {
+    auto w = new GraphicalScreenshotSaver(pixmap(), geometry);
     w->show();
 }
 
-void ResourceExporter::captureToImgur(const QPixmap &p) {
-    auto w = new ImgurUploader(p);
+void ResourceExporter::captureToImgur() {
+    auto w = new ImgurUploader(pixmap(), pipeline());
     w->show();
 }
+
+void ResourceExporter::captureToRaw(const uint id,
+                                    const ImageEncoder::Format format)
+{
+    Controller::getInstance()->encodeExport(id, pipeline(), format);
+}
+
+// pipeline converts the capture the first time a destination needs it
+QSharedPointer<ExportPipeline> ResourceExporter::pipeline() {
+    if (!m_pipeline) {
+        m_pipeline = ExportPipeline::forPixmap(m_pixmap);
+    }
+    return m_pipeline;
+}
+
+// pixmap returns the capture for the destinations which show it
+QPixmap ResourceExporter::pixmap() {
+    if (m_pixmap.isNull()) {
+        m_pixmap = m_pipeline->pixmap();
+    }
+    return m_pixmap;
+}
@@ -18,16 +18,28 @@
 #ifndef RESOURCEEXPORTER_H
 #define RESOURCEEXPORTER_H
 
+#include "src/core/exportpipeline.h"
 #include <QPixmap>
+#include <QSharedPointer>
 
 class ResourceExporter {
 public:
-    ResourceExporter();
+    explicit ResourceExporter(const QPixmap &p);
+    explicit ResourceExporter(const QSharedPointer<ExportPipeline> &capture);
 
-    void captureToClipboard(const QPixmap &p);
-    void captureToFile(const QPixmap &p, const QString &path);
-    void captureToFileUi(const QPixmap &p);
-    void captureToImgur(const QPixmap &p);
+    void captureToClipboard();
+    void captureToFile(const QString &path, const QRect &geometry = QRect());
+    void captureToFileUi(const QRect &geometry = QRect());
+    void captureToImgur();
+    void captureToRaw(const uint id, const ImageEncoder::Format format);
+
+    QSharedPointer<ExportPipeline> pipeline();
+
+private:
+    QPixmap pixmap();
+
+    QPixmap m_pixmap;
+    QSharedPointer<ExportPipeline> m_pipeline;
 };
 
 #endif // RESOURCEEXPORTER_H
@@ -23,13 +23,19 @@
 #include "src/cli/commandlineparser.h"
 #include "src/utils/systemnotification.h"
 #include "src/utils/dbusutils.h"
+#include "src/utils/imageencoder.h"
+#include "src/utils/timelapsereader.h"
 #include <QApplication>
 #include <QTranslator>
 #include <QDBusConnection>
 #include <QDBusMessage>
+#include <QDBusUnixFileDescriptor>
+#include <QRegExp>
 #include <QTextStream>
 #include <QTimer>
 #include <QDir>
+#include <QFileInfo>
+#include <unistd.h>
 
 int main(int argc, char *argv[]) {
     // required for the button serialization
@@ -76,6 +82,9 @@ int main(int argc, char *argv[]) {
     CommandArgument fullArgument("full", "Capture the entire desktop.");
     CommandArgument guiArgument("gui", "Start a manual capture in GUI mode.");
     CommandArgument configArgument("config", "Configure flameshot.");
+    CommandArgument diffArgument("diff", "Compare two captures.");
+    CommandArgument timelapseArgument("timelapse",
+                                      "Expand a timelapse into PNG files.");
 
     // Options
     CommandOption pathOption(
@@ -101,6 +110,10 @@ int main(int argc, char *argv[]) {
                 {"s", "showhelp"},
                 "Show the help message in the capture mode",
                 "bool");
+    CommandOption compressionOption(
+                {"z", "compression"},
+                "Set the PNG compression level, from 0 (fastest) to 9 (smallest)",
+                "level");
     CommandOption mainColorOption(
                 {"m", "maincolor"},
                 "Define the main UI color",
@@ -112,6 +125,66 @@ int main(int argc, char *argv[]) {
     CommandOption rawImageOption(
                 {"r", "raw"},
                 "Print raw PNG capture");
+    CommandOption formatOption(
+                {"F", "format"},
+                "Print the raw capture in this format: " +
+                ImageEncoder::formatNames().join(", "),
+                "format");
+    CommandOption streamOption(
+                {"S", "stream"},
+                "Stream raw frames to stdout, one for each line of stdin "
+                "unless --fps is set");
+    CommandOption fpsOption(
+                "fps",
+                "Frames per second of the stream",
+                "rate");
+    CommandOption regionOption(
+                {"R", "region"},
+                "Stream or burst only this area of the desktop",
+                "WxH+X+Y");
+    CommandOption burstOption(
+                "burst",
+                "Grab this number of frames into memory and save them as PNG "
+                "files in a new directory at the end",
+                "frames");
+    CommandOption intervalOption(
+                "interval",
+                "Milliseconds between the frames of the burst (33 by default) "
+                "or the grabs of the watch (1000 by default)",
+                "ms");
+    CommandOption ringOption(
+                "ring",
+                "Keep grabbing the burst until stdin ends, each line of stdin "
+                "saves the last frames");
+    CommandOption watchOption(
+                "watch",
+                "Save a capture each time the desktop or the region changes, "
+                "until the command is killed");
+    CommandOption thresholdOption(
+                "threshold",
+                "Percentage of changed 32x32 tiles needed to save a capture "
+                "of the watch, 1 by default",
+                "percent");
+    CommandOption timelapseOption(
+                "timelapse",
+                "Append the captures of the watch to this timelapse file "
+                "instead of saving PNG files",
+                "file");
+    CommandOption inputOption(
+                {"i", "input"},
+                "Timelapse file recorded by full --watch",
+                "file");
+    CommandOption beforeOption(
+                {"b", "before"},
+                "First capture, the last saved one by default",
+                "file");
+    CommandOption afterOption(
+                {"a", "after"},
+                "Second capture, the current desktop by default",
+                "file");
+    CommandOption rawDiffOption(
+                {"r", "raw"},
+                "Print the raw PNG annotated image instead of the changed areas");
 
     // Add checkers
     auto colorChecker = [&parser](const QString &colorCode) -> bool {
@@ -141,6 +214,65 @@ int main(int argc, char *argv[]) {
         return res;
     };
 
+    const QString compressionErr = "Invalid level, it must be a number from 0 to 9";
+    auto compressionChecker = [&parser](const QString &levelValue) -> bool {
+        bool ok;
+        int value = levelValue.toInt(&ok);
+        return ok && value >= 0 && value <= 9;
+    };
+
+    const QString formatErr = "Invalid format, it must be one of: " +
+            ImageEncoder::formatNames().join(", ");
+    auto formatChecker = [&parser](const QString &formatValue) -> bool {
+        ImageEncoder::Format format;
+        return ImageEncoder::parseFormat(formatValue, format);
+    };
+
+    const QString fpsErr = "Invalid rate, it must be a number from 1 to 240";
+    auto fpsChecker = [&parser](const QString &fpsValue) -> bool {
+        bool ok;
+        int value = fpsValue.toInt(&ok);
+        return ok && value >= 1 && value <= 240;
+    };
+
+    const QString burstErr = "Invalid number of frames, it must be a number "
+                             "from 1 to 300";
+    auto burstChecker = [&parser](const QString &burstValue) -> bool {
+        bool ok;
+        int value = burstValue.toInt(&ok);
+        return ok && value >= 1 && value <= 300;
+    };
+
+    const QString intervalErr = "Invalid interval, it must be a number from "
+                                "1 to 60000";
+    auto intervalChecker = [&parser](const QString &intervalValue) -> bool {
+        bool ok;
+        int value = intervalValue.toInt(&ok);
+        return ok && value >= 1 && value <= 60000;
+    };
+
+    const QString thresholdErr = "Invalid threshold, it must be a number from "
+                                 "0 to 100";
+    auto thresholdChecker = [&parser](const QString &thresholdValue) -> bool {
+        bool ok;
+        int value = thresholdValue.toInt(&ok);
+        return ok && value >= 0 && value <= 100;
+    };
+
+    // the X11 geometry format, as printed by diff
+    QRegExp geometry("(\\d+)x(\\d+)\\+(-?\\d+)\\+(-?\\d+)");
+    const QString regionErr = "Invalid region, it must be defined as WxH+X+Y";
+    auto regionChecker = [&parser, geometry](const QString &regionValue) -> bool {
+        QRegExp g(geometry);
+        return g.exactMatch(regionValue) && g.cap(1).toInt() > 0 &&
+                g.cap(2).toInt() > 0;
+    };
+
+    const QString fileErr = "Invalid file, it must be an existing image";
+    auto fileChecker = [&parser](const QString &fileValue) -> bool {
+        return QFileInfo(fileValue).isFile();
+    };
+
     const QString booleanErr = "Invalid value, it must be defined as 'true' or 'false'";
     auto booleanChecker = [&parser](const QString &value) -> bool {
         return value == "true" || value == "false";
@@ -152,18 +284,38 @@ int main(int argc, char *argv[]) {
     pathOption.addChecker(pathChecker, pathErr);
     trayOption.addChecker(booleanChecker, booleanErr);
     showHelpOption.addChecker(booleanChecker, booleanErr);
+    compressionOption.addChecker(compressionChecker, compressionErr);
+    formatOption.addChecker(formatChecker, formatErr);
+    fpsOption.addChecker(fpsChecker, fpsErr);
+    regionOption.addChecker(regionChecker, regionErr);
+    burstOption.addChecker(burstChecker, burstErr);
+    intervalOption.addChecker(intervalChecker, intervalErr);
+    thresholdOption.addChecker(thresholdChecker, thresholdErr);
+    inputOption.addChecker(fileChecker, fileErr);
+    beforeOption.addChecker(fileChecker, fileErr);
+    afterOption.addChecker(fileChecker, fileErr);
 
     // Relationships
     parser.AddArgument(guiArgument);
     parser.AddArgument(fullArgument);
     parser.AddArgument(configArgument);
+    parser.AddArgument(diffArgument);
+    parser.AddArgument(timelapseArgument);
     auto helpOption = parser.addHelpOption();
     auto versionOption = parser.addVersionOption();
-    parser.AddOptions({ pathOption, delayOption, rawImageOption }, guiArgument);
-    parser.AddOptions({ pathOption, clipboardOption, delayOption, rawImageOption },
+    parser.AddOptions({ pathOption, delayOption, rawImageOption, formatOption },
+                      guiArgument);
+    parser.AddOptions({ pathOption, clipboardOption, delayOption, rawImageOption,
+                        formatOption, streamOption, fpsOption, regionOption,
+                        burstOption, intervalOption, ringOption, watchOption,
+                        thresholdOption, timelapseOption },
                       fullArgument);
     parser.AddOptions({ filenameOption, trayOption, showHelpOption,
-                        mainColorOption, contrastColorOption }, configArgument);
+                        compressionOption, mainColorOption, contrastColorOption },
+                      configArgument);
+    parser.AddOptions({ beforeOption, afterOption, pathOption, rawDiffOption },
+                      diffArgument);
+    parser.AddOptions({ inputOption, pathOption }, timelapseArgument);
     // Parse
     if (!parser.parse(app.arguments())) {
         goto finish;
@@ -176,43 +328,157 @@ int main(int argc, char *argv[]) {
     else if (parser.isSet(guiArgument)) { // GUI
         QString pathValue = parser.value(pathOption);
         int delay = parser.value(delayOption).toInt();
-        bool isRaw = parser.isSet(rawImageOption);
-        uint id = qHash(app.arguments().join(" "));
-        DBusUtils utils(id);
+        // a format implies the raw output
+        bool isRaw = parser.isSet(rawImageOption) || parser.isSet(formatOption);
+        QString formatValue = parser.isSet(formatOption) ?
+                    parser.value(formatOption) : "png";
+        DBusUtils utils;
+        QDBusConnection sessionBus = QDBusConnection::sessionBus();
+        utils.checkDBusConnection(sessionBus);
 
-        // Send message
+        if (isRaw) {
+            // the reply holds the capture, there is no signal to wait for
+            QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                               "/", "", "graphicCaptureFd");
+            m << pathValue << delay << formatValue;
+            // 15 minutes timeout
+            utils.printImageReply(sessionBus.call(m, QDBus::Block,
+                                                  delay + 1000 * 60 * 15));
+        } else {
+            // the id 0 tells the daemon that the raw image isn't needed
+            QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                               "/", "", "graphicCapture");
+            m << pathValue << delay << 0u;
+            sessionBus.call(m);
+        }
+    }
+    else if (parser.isSet(fullArgument) && parser.isSet(streamOption)) { // STREAM
+        QRect region;
+        if (parser.isSet(regionOption) &&
+                geometry.exactMatch(parser.value(regionOption)))
+        {
+            region = QRect(geometry.cap(3).toInt(), geometry.cap(4).toInt(),
+                           geometry.cap(1).toInt(), geometry.cap(2).toInt());
+        }
+        // without a rate every line of stdin triggers a frame
+        int fps = parser.isSet(fpsOption) ? parser.value(fpsOption).toInt() : 0;
+
+        DBusUtils utils;
+        QDBusConnection sessionBus = QDBusConnection::sessionBus();
+        utils.checkDBusConnection(sessionBus);
+        // connect before the call, the consumer may close the pipe at once
+        sessionBus.connect("org.dharkael.Flameshot",
+                           "/", "", "streamFinished",
+                           &utils,
+                           SLOT(streamFinished(uint, uint, uint)));
         QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
-                                           "/", "", "graphicCapture");
-        m << pathValue << delay << id;
+                                               "/", "", "streamFrames");
+        m << QVariant::fromValue(QDBusUnixFileDescriptor(STDOUT_FILENO))
+          << region.x() << region.y() << region.width() << region.height()
+          << fps;
+        QDBusMessage reply = sessionBus.call(m);
+        uint stream = reply.type() == QDBusMessage::ReplyMessage ?
+                    reply.arguments().value(0).toUInt() : 0;
+        if (stream == 0) {
+            // stdout only carries frames
+            QTextStream(stderr) << "stream failed\n";
+            goto finish;
+        }
+        utils.followStream(stream, fps == 0);
+        app.exec();
+    }
+    else if (parser.isSet(fullArgument) && parser.isSet(burstOption)) { // BURST
+        QRect region;
+        if (parser.isSet(regionOption) &&
+                geometry.exactMatch(parser.value(regionOption)))
+        {
+            region = QRect(geometry.cap(3).toInt(), geometry.cap(4).toInt(),
+                           geometry.cap(1).toInt(), geometry.cap(2).toInt());
+        }
+        int frames = parser.value(burstOption).toInt();
+        int interval = parser.isSet(intervalOption) ?
+                    parser.value(intervalOption).toInt() : 33;
+        bool ring = parser.isSet(ringOption);
+
+        DBusUtils utils;
         QDBusConnection sessionBus = QDBusConnection::sessionBus();
         utils.checkDBusConnection(sessionBus);
-        sessionBus.call(m);
+        sessionBus.connect("org.dharkael.Flameshot",
+                           "/", "", "burstFlushed",
+                           &utils,
+                           SLOT(burstFlushed(uint, QStringList)));
+        sessionBus.connect("org.dharkael.Flameshot",
+                           "/", "", "burstFinished",
+                           &utils,
+                           SLOT(burstFinished(uint, uint, uint)));
+        QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                               "/", "", "startBurst");
+        m << parser.value(pathOption)
+          << region.x() << region.y() << region.width() << region.height()
+          << frames << interval << ring;
+        QDBusMessage reply = sessionBus.call(m);
+        uint burst = reply.type() == QDBusMessage::ReplyMessage ?
+                    reply.arguments().value(0).toUInt() : 0;
+        if (burst == 0) {
+            QTextStream(stderr) << "burst failed\n";
+            goto finish;
+        }
+        // the paths of the saved frames are printed as they are flushed
+        utils.followBurst(burst, ring);
+        app.exec();
+    }
+    else if (parser.isSet(fullArgument) && parser.isSet(watchOption)) { // WATCH
+        QRect region;
+        if (parser.isSet(regionOption) &&
+                geometry.exactMatch(parser.value(regionOption)))
+        {
+            region = QRect(geometry.cap(3).toInt(), geometry.cap(4).toInt(),
+                           geometry.cap(1).toInt(), geometry.cap(2).toInt());
+        }
+        int interval = parser.isSet(intervalOption) ?
+                    parser.value(intervalOption).toInt() : 1000;
+        int threshold = parser.isSet(thresholdOption) ?
+                    parser.value(thresholdOption).toInt() : 1;
+        // the daemon has another working directory
+        QString timelapseValue = parser.isSet(timelapseOption) ?
+                    QFileInfo(parser.value(timelapseOption)).absoluteFilePath() :
+                    QString();
 
-        if (isRaw) {
-            // captureTaken
-            sessionBus.connect("org.dharkael.Flameshot",
-                               "/", "", "captureTaken",
-                               &utils,
-                               SLOT(captureTaken(uint, QByteArray)));
-            // captureFailed
-            sessionBus.connect("org.dharkael.Flameshot",
-                               "/", "", "captureFailed",
-                               &utils,
-                               SLOT(captureFailed(uint)));
-            QTimer t;
-            t.setInterval(1000 * 60 * 15); // 15 minutes timeout
-            QObject::connect(&t, &QTimer::timeout, qApp,
-                             &QCoreApplication::quit);
-            t.start();
-            // wait
-            app.exec();
+        DBusUtils utils;
+        QDBusConnection sessionBus = QDBusConnection::sessionBus();
+        utils.checkDBusConnection(sessionBus);
+        sessionBus.connect("org.dharkael.Flameshot",
+                           "/", "", "watchSaved",
+                           &utils,
+                           SLOT(watchSaved(uint, uint, QString)));
+        sessionBus.connect("org.dharkael.Flameshot",
+                           "/", "", "watchFinished",
+                           &utils,
+                           SLOT(watchFinished(uint, uint, uint)));
+        QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                               "/", "", "watchRegion");
+        m << parser.value(pathOption) << timelapseValue
+          << region.x() << region.y() << region.width() << region.height()
+          << interval << threshold;
+        QDBusMessage reply = sessionBus.call(m);
+        uint watch = reply.type() == QDBusMessage::ReplyMessage ?
+                    reply.arguments().value(0).toUInt() : 0;
+        if (watch == 0) {
+            QTextStream(stderr) << "watch failed\n";
+            goto finish;
         }
+        // every saved capture prints its number and path
+        utils.followWatch(watch);
+        app.exec();
     }
     else if (parser.isSet(fullArgument)) { // FULL
         QString pathValue = parser.value(pathOption);
         int delay = parser.value(delayOption).toInt();
         bool toClipboard = parser.isSet(clipboardOption);
-        bool isRaw = parser.isSet(rawImageOption);
+        // a format implies the raw output
+        bool isRaw = parser.isSet(rawImageOption) || parser.isSet(formatOption);
+        QString formatValue = parser.isSet(formatOption) ?
+                    parser.value(formatOption) : "png";
         // Not a valid command
         if (!isRaw && !toClipboard && pathValue.isEmpty()) {
             QTextStream(stdout) << "you have to set a valid flag:\n\n";
@@ -220,45 +486,67 @@ int main(int argc, char *argv[]) {
             goto finish;
         }
 
-        uint id = qHash(app.arguments().join(" "));
-        DBusUtils utils(id);
-
-        // Send message
-        QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
-                                               "/", "", "fullScreen");
-        m << pathValue << toClipboard << delay << id;
+        DBusUtils utils;
         QDBusConnection sessionBus = QDBusConnection::sessionBus();
         utils.checkDBusConnection(sessionBus);
-        sessionBus.call(m);
 
         if (isRaw) {
-            // captureTaken
-            sessionBus.connect("org.dharkael.Flameshot",
-                               "/", "", "captureTaken",
-                               &utils,
-                               SLOT(captureTaken(uint, QByteArray)));
-            // captureFailed
-            sessionBus.connect("org.dharkael.Flameshot",
-                               "/", "", "captureFailed",
-                               &utils,
-                               SLOT(captureFailed(uint)));
-            // timeout just in case
-            QTimer t;
-            t.setInterval(2000);
-            QObject::connect(&t, &QTimer::timeout, qApp,
-                             &QCoreApplication::quit);
-            t.start();
-            // wait
-            app.exec();
+            QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                                   "/", "", "fullScreenFd");
+            m << pathValue << toClipboard << delay << formatValue;
+            utils.printImageReply(sessionBus.call(m, QDBus::Block,
+                                                  delay + 1000 * 60));
+        } else {
+            QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                                   "/", "", "fullScreen");
+            m << pathValue << toClipboard << delay << 0u;
+            sessionBus.call(m);
+        }
+    }
+    else if (parser.isSet(diffArgument)) { // DIFF
+        QString beforeValue = parser.value(beforeOption);
+        QString afterValue = parser.value(afterOption);
+        QString pathValue = parser.value(pathOption);
+        DBusUtils utils;
+        utils.setRawOutput(parser.isSet(rawDiffOption));
+
+        QDBusConnection sessionBus = QDBusConnection::sessionBus();
+        utils.checkDBusConnection(sessionBus);
+        QDBusMessage m = QDBusMessage::createMethodCall("org.dharkael.Flameshot",
+                                               "/", "", "diffCaptureFd");
+        m << beforeValue << afterValue << pathValue;
+        utils.printDiffReply(sessionBus.call(m, QDBus::Block, 1000 * 60));
+    }
+    else if (parser.isSet(timelapseArgument)) { // TIMELAPSE
+        // the frames are rebuilt here, the daemon isn't needed
+        if (!parser.isSet(inputOption)) {
+            QTextStream(stdout) << "you have to set the timelapse file:\n\n";
+            parser.parse(QStringList() << argv[0] << "timelapse" << "-h");
+            goto finish;
+        }
+        QString pathValue = parser.isSet(pathOption) ?
+                    parser.value(pathOption) : QDir::currentPath();
+        TimelapseReader reader(parser.value(inputOption));
+        QStringList paths;
+        bool ok = reader.expand(pathValue, paths);
+        QTextStream out(stdout);
+        for (const QString &path: paths) {
+            out << path << "\n";
+        }
+        if (!ok) {
+            QTextStream(stderr) << QString("timelapse expanded up to frame "
+                                           "%1, the next one failed\n")
+                                   .arg(paths.size());
         }
     }
     else if (parser.isSet(configArgument)) { // CONFIG
         bool filename = parser.isSet(filenameOption);
         bool tray = parser.isSet(trayOption);
         bool help = parser.isSet(showHelpOption);
+        bool compression = parser.isSet(compressionOption);
         bool mainColor = parser.isSet(mainColorOption);
         bool contrastColor = parser.isSet(contrastColorOption);
-        bool someFlagSet = (filename || tray || help ||
+        bool someFlagSet = (filename || tray || help || compression ||
                             mainColor || contrastColor);
         ConfigHandler config;
         if (filename) {
@@ -291,6 +579,9 @@ int main(int argc, char *argv[]) {
                 config.setShowHelp(true);
             }
         }
+        if (compression) {
+            config.setPngCompressionLevel(parser.value(compressionOption).toInt());
+        }
         if (mainColor) {
             QString colorCode = parser.value(mainColorOption);
             QColor parsedColor(colorCode);
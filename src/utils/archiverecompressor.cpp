@@ -0,0 +1,365 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "archiverecompressor.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/pngencoder.h"
+#include "qxtwindowsystem.h"
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QThread>
+#include <QDir>
+#include <QSet>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstdio>
+
+// ArchiveRecompressor shrinks the saved PNG captures while the user is away.
+// The captures are saved with a fast compression, once the session has been
+// idle for a while and the system isn't busy every file of the save folder
+// is encoded again with every filter and deflate strategy at idle thread
+// priority, keeping its metadata. The new file replaces the old one
+// atomically only if it is smaller and has the same pixels. A manifest of the processed files lets
+// the job resume after a restart without trying them again.
+
+namespace {
+
+// time without user input before starting
+const uint IDLE_MSEC = 5 * 60 * 1000;
+const int CHECK_INTERVAL = 30 * 1000;
+const int RESCAN_INTERVAL = 10 * 60 * 1000;
+// the load average per core must stay below this ratio
+const double MAX_LOAD = 0.5;
+const char PNG_SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+
+quint32 readUInt32(const QByteArray &data, const int pos) {
+    auto p = reinterpret_cast<const uchar *>(data.constData() + pos);
+    return (quint32(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// metadata of a capture copied to the file encoded again, grouped by where
+// the chunks go: before the palette, before the pixels and after them
+struct KeptChunks {
+    QByteArray beforePalette;
+    QByteArray beforeData;
+    QByteArray afterData;
+};
+
+// keepChunks tells if rewriting the file with its pixels and its metadata
+// loses nothing: its samples fit in 8 bits, which is how QImage reads
+// them, and every ancillary chunk can be copied. The chunks of the pixels
+// are written by the encoder, the others are kept in @kept.
+bool keepChunks(const QByteArray &data, KeptChunks &kept) {
+    static const QSet<QByteArray> encodedChunks = {
+        "IHDR", "PLTE", "tRNS", "IDAT", "IEND"
+    };
+    // ancillary chunks which don't depend on how the pixels are stored,
+    // besides the ones marked as safe to copy
+    static const QSet<QByteArray> copiedChunks = {
+        "pHYs", "sRGB", "gAMA", "cHRM", "tIME", "tEXt", "zTXt", "iTXt"
+    };
+    if (!data.startsWith(QByteArray(PNG_SIGNATURE, 8)) || data.size() < 33) {
+        return false;
+    }
+    const int bitDepth = static_cast<uchar>(data.at(24));
+    const int colorType = static_cast<uchar>(data.at(25));
+    if (bitDepth != 8 && colorType != 3) {
+        return false;
+    }
+    QByteArray *region = &kept.beforePalette;
+    bool hasPalette = false;
+    int pos = 8;
+    while (pos + 12 <= data.size()) {
+        const quint32 length = readUInt32(data, pos);
+        if (length > static_cast<quint32>(data.size() - pos - 12)) {
+            return false;
+        }
+        const QByteArray type = data.mid(pos + 4, 4);
+        const bool critical = !(type.at(0) & 0x20);
+        const bool safeToCopy = type.at(3) & 0x20;
+        if (type == "PLTE") {
+            hasPalette = true;
+            region = &kept.beforeData;
+        } else if (type == "IDAT") {
+            region = &kept.afterData;
+        } else if (encodedChunks.contains(type)) {
+            // written again by the encoder
+        } else if (!critical && (safeToCopy || copiedChunks.contains(type))) {
+            region->append(data.mid(pos, 12 + length));
+        } else {
+            return false;
+        }
+        pos += 12 + length;
+    }
+    // without a palette every chunk before the pixels goes after IHDR, the
+    // new file may have one
+    if (!hasPalette) {
+        kept.beforePalette.append(kept.beforeData);
+        kept.beforeData.clear();
+    }
+    return pos == data.size();
+}
+
+// insertChunks adds the kept metadata to the encoded file
+QByteArray insertChunks(const QByteArray &encoded, const KeptChunks &kept) {
+    if (encoded.size() < 33) {
+        return QByteArray();
+    }
+    // IHDR always comes first
+    const int afterHeader = 8 + 12 + readUInt32(encoded, 8);
+    int firstData = -1;
+    int end = -1;
+    int pos = 8;
+    while (pos + 12 <= encoded.size()) {
+        const QByteArray type = encoded.mid(pos + 4, 4);
+        if (type == "IDAT" && firstData < 0) {
+            firstData = pos;
+        } else if (type == "IEND") {
+            end = pos;
+        }
+        pos += 12 + readUInt32(encoded, pos);
+    }
+    if (firstData < 0 || end < 0) {
+        return QByteArray();
+    }
+    return encoded.left(afterHeader) + kept.beforePalette +
+            encoded.mid(afterHeader, firstData - afterHeader) +
+            kept.beforeData + encoded.mid(firstData, end - firstData) +
+            kept.afterData + encoded.mid(end);
+}
+
+// replaceFile writes the new data next to the file and renames it over it,
+// keeping its permissions and modification time. Nothing is replaced if the
+// file changed meanwhile.
+bool replaceFile(const QString &path, const QByteArray &data,
+                 const struct stat &before)
+{
+    const QString tempPath = path + ".part";
+    QFile file(tempPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    bool ok = file.write(data) == data.size() && file.flush() &&
+            ::fchmod(file.handle(), before.st_mode & 07777) == 0 &&
+            ::fsync(file.handle()) == 0;
+    file.close();
+    const QByteArray name = QFile::encodeName(path);
+    const QByteArray tempName = QFile::encodeName(tempPath);
+    if (ok) {
+        const struct timespec times[2] = { before.st_atim, before.st_mtim };
+        ok = ::utimensat(AT_FDCWD, tempName.constData(), times, 0) == 0;
+    }
+    struct stat current;
+    if (ok) {
+        ok = ::stat(name.constData(), &current) == 0 &&
+                current.st_size == before.st_size &&
+                current.st_mtime == before.st_mtime &&
+                current.st_ino == before.st_ino;
+    }
+    if (ok) {
+        ok = std::rename(tempName.constData(), name.constData()) == 0;
+    }
+    if (!ok) {
+        QFile::remove(tempPath);
+    }
+    return ok;
+}
+
+ArchiveRecompressor::Result recompressFile(const QString &path,
+                                           const QAtomicInt *cancelled)
+{
+    ArchiveRecompressor::Result res = { path, -1, -1, 0 };
+    const QByteArray name = QFile::encodeName(path);
+    struct stat before;
+    if (::stat(name.constData(), &before) != 0) {
+        return res;
+    }
+    res.size = before.st_size;
+    res.modified = before.st_mtime;
+    // a hard link shares the file with a duplicated capture, its other
+    // names would keep the old data
+    if (before.st_nlink > 1) {
+        return res;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return res;
+    }
+    const QByteArray original = file.readAll();
+    file.close();
+    const QImage image = QImage::fromData(original, "PNG");
+    KeptChunks kept;
+    if (!keepChunks(original, kept) || image.isNull()) {
+        return res;
+    }
+
+    PngEncoder encoder;
+    if (image.format() == QImage::Format_Indexed8) {
+        encoder.setPalette(image.colorTable());
+    }
+    encoder.setExhaustive(true);
+    encoder.setCancelFlag(cancelled);
+    const QByteArray data = insertChunks(encoder.encode(image), kept);
+    if (data.isEmpty() || data.size() >= original.size()) {
+        return res;
+    }
+    // the archive is never touched unless the pixels are the same
+    const QImage decoded = QImage::fromData(data, "PNG");
+    if (decoded.convertToFormat(QImage::Format_ARGB32) !=
+            image.convertToFormat(QImage::Format_ARGB32))
+    {
+        return res;
+    }
+    struct stat after;
+    if (replaceFile(path, data, before) &&
+            ::stat(name.constData(), &after) == 0)
+    {
+        res.size = after.st_size;
+        res.modified = after.st_mtime;
+        res.savedBytes = before.st_size - after.st_size;
+    }
+    return res;
+}
+
+} // unnamed namespace
+
+ArchiveRecompressor::ArchiveRecompressor(QObject *parent) : QObject(parent) {
+    connect(&m_timer, &QTimer::timeout, this, &ArchiveRecompressor::checkIdle);
+    connect(&m_watcher, &QFutureWatcher<Result>::finished,
+            this, &ArchiveRecompressor::handleFileDone);
+    connect(qApp, &QCoreApplication::aboutToQuit,
+            this, &ArchiveRecompressor::stop);
+}
+
+ArchiveRecompressor *ArchiveRecompressor::getInstance() {
+    static ArchiveRecompressor r;
+    return &r;
+}
+
+void ArchiveRecompressor::start() {
+    if (!m_manifest.isOpen() && !loadManifest()) {
+        return;
+    }
+    m_cancelled.store(0);
+    m_timer.start(CHECK_INTERVAL);
+}
+
+// stop makes the file in progress fail instead of waiting for it, it is
+// tried again later
+void ArchiveRecompressor::stop() {
+    m_timer.stop();
+    m_cancelled.store(1);
+    m_watcher.waitForFinished();
+}
+
+void ArchiveRecompressor::checkIdle() {
+    if (!m_watcher.isRunning() && canRun()) {
+        processNext();
+    }
+}
+
+void ArchiveRecompressor::handleFileDone() {
+    const Result res = m_watcher.result();
+    if (res.size >= 0 && !m_cancelled.load()) {
+        m_processed.insert(res.path, res);
+        m_manifest.write(QString("%1\t%2\t%3\t%4\n").arg(res.size)
+                         .arg(res.modified).arg(res.savedBytes)
+                         .arg(res.path).toUtf8());
+        m_manifest.flush();
+    }
+    if (m_timer.isActive() && canRun()) {
+        processNext();
+    }
+}
+
+// canRun checks the user is away and the system has spare cores
+bool ArchiveRecompressor::canRun() const {
+    if (QxtWindowSystem::idleTime() < IDLE_MSEC) {
+        return false;
+    }
+    double load;
+    return ::getloadavg(&load, 1) == 1 &&
+            load < QThread::idealThreadCount() * MAX_LOAD;
+}
+
+// loadManifest reads the processed files, the last line of a file wins
+bool ArchiveRecompressor::loadManifest() {
+    QString dir = QStandardPaths::writableLocation(
+                QStandardPaths::DataLocation);
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+    m_manifest.setFileName(dir + "/recompressed.manifest");
+    if (!m_manifest.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        return false;
+    }
+    m_manifest.seek(0);
+    while (!m_manifest.atEnd()) {
+        const QString line =
+                QString::fromUtf8(m_manifest.readLine()).remove('\n');
+        const QStringList fields = line.split('\t');
+        if (fields.size() == 4) {
+            Result res = { fields.at(3), fields.at(0).toLongLong(),
+                           fields.at(1).toLongLong(),
+                           fields.at(2).toLongLong() };
+            m_processed.insert(res.path, res);
+        }
+    }
+    return true;
+}
+
+// scanArchive lists the captures of the save folder not processed yet or
+// changed since then, the oldest first
+void ArchiveRecompressor::scanArchive() {
+    m_lastScan.start();
+    m_pending.clear();
+    const QString dir = ConfigHandler().savePathValue();
+    if (dir.isEmpty()) {
+        return;
+    }
+    const QFileInfoList files = QDir(dir).entryInfoList(
+                QStringList() << "*.png", QDir::Files,
+                QDir::Time | QDir::Reversed);
+    for (const QFileInfo &info: files) {
+        const Result res = m_processed.value(info.absoluteFilePath(),
+                                             { QString(), -1, -1, 0 });
+        if (res.size != info.size() ||
+                res.modified != info.lastModified().toTime_t())
+        {
+            m_pending << info.absoluteFilePath();
+        }
+    }
+}
+
+void ArchiveRecompressor::processNext() {
+    if (m_pending.isEmpty() &&
+            (!m_lastScan.isValid() || m_lastScan.elapsed() > RESCAN_INTERVAL))
+    {
+        scanArchive();
+    }
+    if (m_pending.isEmpty()) {
+        return;
+    }
+    const QString path = m_pending.takeFirst();
+    const QAtomicInt *cancelled = &m_cancelled;
+    m_watcher.setFuture(m_pool.run<Result>([path, cancelled]() {
+        return recompressFile(path, cancelled);
+    }));
+}
@@ -0,0 +1,72 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ARCHIVERECOMPRESSOR_H
+#define ARCHIVERECOMPRESSOR_H
+
+#include "src/utils/idlethreadpool.h"
+#include <QObject>
+#include <QTimer>
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QAtomicInt>
+
+class ArchiveRecompressor : public QObject
+{
+    Q_OBJECT
+public:
+    // state of a file once processed, it is processed again if it changes
+    struct Result {
+        QString path;
+        qint64 size;
+        qint64 modified;
+        qint64 savedBytes;
+    };
+
+    static ArchiveRecompressor* getInstance();
+
+    void start();
+    void stop();
+
+private slots:
+    void checkIdle();
+    void handleFileDone();
+
+private:
+    explicit ArchiveRecompressor(QObject *parent = nullptr);
+
+    // the files are encoded in a thread of their own at the idle priority
+    IdleThreadPool m_pool;
+    QTimer m_timer;
+    QFutureWatcher<Result> m_watcher;
+    QAtomicInt m_cancelled;
+    QFile m_manifest;
+    QHash<QString, Result> m_processed;
+    QStringList m_pending;
+    QElapsedTimer m_lastScan;
+
+    bool canRun() const;
+    bool loadManifest();
+    void scanArchive();
+    void processNext();
+};
+
+#endif // ARCHIVERECOMPRESSOR_H
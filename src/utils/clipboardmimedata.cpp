@@ -0,0 +1,106 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "clipboardmimedata.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QBuffer>
+#include <QImageWriter>
+
+// ClipboardMimeData offers the capture in several image formats without
+// encoding any of them until a client asks for it. Every format is encoded
+// once in a worker thread by the ExportPipeline of the capture and kept for
+// the next pastes, everything is released when another application takes
+// the clipboard.
+
+namespace {
+
+const QString MIME_PNG = QStringLiteral("image/png");
+const QString MIME_BMP = QStringLiteral("image/bmp");
+const QString MIME_PPM = QStringLiteral("image/x-portable-pixmap");
+// the image as a QImage for pastes inside this process
+const QString MIME_QT_IMAGE = QStringLiteral("application/x-qt-image");
+
+QByteArray encodeBmp(const QImage &image) {
+    QByteArray res;
+    QBuffer buffer(&res);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter(&buffer, "BMP").write(image);
+    return res;
+}
+
+} // unnamed namespace
+
+ClipboardMimeData::ClipboardMimeData(
+        const QSharedPointer<ExportPipeline> &capture) :
+    QMimeData(), m_capture(capture)
+{
+    connect(QApplication::clipboard(), &QClipboard::dataChanged,
+            this, &ClipboardMimeData::handleClipboardChange);
+}
+
+// copyToClipboard replaces QClipboard::setPixmap
+void ClipboardMimeData::copyToClipboard(
+        const QSharedPointer<ExportPipeline> &capture)
+{
+    QApplication::clipboard()->setMimeData(new ClipboardMimeData(capture));
+}
+
+QStringList ClipboardMimeData::formats() const {
+    if (!m_capture) {
+        return QStringList();
+    }
+    // application/x-qt-image isn't listed, otherwise the platform plugins
+    // would encode every image request themselves from the QImage
+    return QStringList() << MIME_PNG << MIME_BMP << MIME_PPM;
+}
+
+bool ClipboardMimeData::hasFormat(const QString &mimeType) const {
+    return formats().contains(mimeType);
+}
+
+// retrieveData is called from the GUI thread each time a client pastes,
+// a request for a format still being encoded waits for the same job
+QVariant ClipboardMimeData::retrieveData(const QString &mimeType,
+                                         QVariant::Type type) const
+{
+    Q_UNUSED(type);
+    if (!m_capture) {
+        return QVariant();
+    }
+    if (mimeType == MIME_QT_IMAGE) {
+        return m_capture->image();
+    }
+    if (mimeType == MIME_PNG) {
+        return m_capture->encoding(ImageEncoder::FORMAT_PNG).result().data;
+    } else if (mimeType == MIME_PPM) {
+        return m_capture->encoding(ImageEncoder::FORMAT_PPM).result().data;
+    } else if (mimeType == MIME_BMP) {
+        return m_capture->encoding("bmp", encodeBmp).result().data;
+    }
+    return QVariant();
+}
+
+// handleClipboardChange drops the image and its encodings once the
+// clipboard belongs to someone else
+void ClipboardMimeData::handleClipboardChange() {
+    if (!QApplication::clipboard()->ownsClipboard()) {
+        disconnect(QApplication::clipboard(), nullptr, this, nullptr);
+        m_capture.clear();
+    }
+}
@@ -0,0 +1,48 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef CLIPBOARDMIMEDATA_H
+#define CLIPBOARDMIMEDATA_H
+
+#include "src/core/exportpipeline.h"
+#include <QMimeData>
+#include <QSharedPointer>
+
+class ClipboardMimeData : public QMimeData
+{
+    Q_OBJECT
+public:
+    explicit ClipboardMimeData(const QSharedPointer<ExportPipeline> &capture);
+
+    static void copyToClipboard(const QSharedPointer<ExportPipeline> &capture);
+
+    QStringList formats() const override;
+    bool hasFormat(const QString &mimeType) const override;
+
+protected:
+    QVariant retrieveData(const QString &mimeType,
+                          QVariant::Type type) const override;
+
+private slots:
+    void handleClipboardChange();
+
+private:
+    QSharedPointer<ExportPipeline> m_capture;
+};
+
+#endif // CLIPBOARDMIMEDATA_H
@@ -0,0 +1,341 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "clipencoder.h"
+#include "src/utils/palettequantizer.h"
+#include "src/utils/pngencoder.h"
+#include <QVector>
+#include <zlib.h>
+
+// ClipEncoder writes short animations as GIF or APNG. Every frame only
+// holds the area which changed since the previous one, and inside it the
+// unchanged pixels are transparent so the previous frame shows through.
+// The frames are encoded independently, in any thread, and joined with
+// their delays when the recording ends.
+
+namespace {
+
+const int MAX_LZW_CODE = 4095;
+const int MAX_LZW_BITS = 12;
+// prime size of the LZW dictionary, as used by the classic GIF encoders
+const int LZW_HASH_SIZE = 5003;
+const int MAX_SUB_BLOCK = 255;
+// fast enough to keep up with the recording
+const int FRAME_COMPRESSION = 6;
+const char PNG_SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+
+void appendUInt16LE(QByteArray &out, const int value) {
+    out.append(static_cast<char>(value & 0xff));
+    out.append(static_cast<char>((value >> 8) & 0xff));
+}
+
+void appendUInt16(QByteArray &out, const int value) {
+    out.append(static_cast<char>((value >> 8) & 0xff));
+    out.append(static_cast<char>(value & 0xff));
+}
+
+void appendUInt32(QByteArray &out, const quint32 value) {
+    appendUInt16(out, value >> 16);
+    appendUInt16(out, value & 0xffff);
+}
+
+void appendPngChunk(QByteArray &out, const char *type, const QByteArray &data) {
+    appendUInt32(out, data.size());
+    QByteArray body(type, 4);
+    body.append(data);
+    out.append(body);
+    appendUInt32(out, crc32(crc32(0L, Z_NULL, 0),
+                            reinterpret_cast<const Bytef *>(body.constData()),
+                            body.size()));
+}
+
+// GIF data goes in blocks of up to 255 bytes ended by an empty one
+void appendSubBlocks(QByteArray &out, const QByteArray &data) {
+    for (int i = 0; i < data.size(); i += MAX_SUB_BLOCK) {
+        const int n = qMin(MAX_SUB_BLOCK, data.size() - i);
+        out.append(static_cast<char>(n));
+        out.append(data.constData() + i, n);
+    }
+    out.append(static_cast<char>(0));
+}
+
+// packs the LZW codes from the least significant bit
+class BitWriter {
+public:
+    BitWriter() : m_buffer(0), m_bits(0) {}
+
+    void write(const int code, const int size) {
+        m_buffer |= static_cast<quint32>(code) << m_bits;
+        m_bits += size;
+        while (m_bits >= 8) {
+            m_bytes.append(static_cast<char>(m_buffer & 0xff));
+            m_buffer >>= 8;
+            m_bits -= 8;
+        }
+    }
+
+    QByteArray finish() {
+        if (m_bits > 0) {
+            m_bytes.append(static_cast<char>(m_buffer & 0xff));
+        }
+        return m_bytes;
+    }
+
+private:
+    QByteArray m_bytes;
+    quint32 m_buffer;
+    int m_bits;
+};
+
+// lzwCompress encodes the palette indices with the variable length codes
+// of GIF. The code size grows one code after the decoder's dictionary
+// reaches the limit, and the dictionary is reset when it is full.
+QByteArray lzwCompress(const QByteArray &indices, const int minCodeSize) {
+    const int clearCode = 1 << minCodeSize;
+    const int endCode = clearCode + 1;
+    int codeSize = minCodeSize + 1;
+    int nextCode = endCode + 1;
+    QVector<int> keys(LZW_HASH_SIZE, -1);
+    QVector<int> codes(LZW_HASH_SIZE, 0);
+    BitWriter out;
+    auto writeCode = [&out, &codeSize, &nextCode](const int code) {
+        out.write(code, codeSize);
+        if (nextCode >= (1 << codeSize) && codeSize < MAX_LZW_BITS) {
+            ++codeSize;
+        }
+    };
+
+    writeCode(clearCode);
+    auto data = reinterpret_cast<const uchar *>(indices.constData());
+    const int n = indices.size();
+    int prefix = n > 0 ? data[0] : -1;
+    for (int i = 1; i < n; ++i) {
+        const int c = data[i];
+        const int key = (prefix << 8) | c;
+        int h = ((c << 12) ^ prefix) % LZW_HASH_SIZE;
+        while (keys.at(h) != -1 && keys.at(h) != key) {
+            if (++h == LZW_HASH_SIZE) {
+                h = 0;
+            }
+        }
+        if (keys.at(h) == key) {
+            prefix = codes.at(h);
+            continue;
+        }
+        writeCode(prefix);
+        if (nextCode >= MAX_LZW_CODE) {
+            writeCode(clearCode);
+            keys.fill(-1);
+            codeSize = minCodeSize + 1;
+            nextCode = endCode + 1;
+        } else {
+            keys[h] = key;
+            codes[h] = nextCode++;
+        }
+        prefix = c;
+    }
+    if (prefix >= 0) {
+        writeCode(prefix);
+    }
+    writeCode(endCode);
+    return out.finish();
+}
+
+// gifImage returns the image descriptor, the local color table and the
+// compressed indices of the frame
+QByteArray gifImage(const QImage &image, const QRect &rect,
+                    int &transparentIndex)
+{
+    QVector<QRgb> palette;
+    const QByteArray indices =
+            PaletteQuantizer().quantize(image, palette, transparentIndex);
+    // the size of the color table is a power of two
+    int tableBits = 1;
+    while ((1 << tableBits) < palette.size()) {
+        ++tableBits;
+    }
+    QByteArray res;
+    res.append(static_cast<char>(0x2c));
+    appendUInt16LE(res, rect.x());
+    appendUInt16LE(res, rect.y());
+    appendUInt16LE(res, rect.width());
+    appendUInt16LE(res, rect.height());
+    res.append(static_cast<char>(0x80 | (tableBits - 1)));
+    for (int i = 0; i < (1 << tableBits); ++i) {
+        const QRgb c = palette.value(i, 0);
+        res.append(static_cast<char>(qRed(c)));
+        res.append(static_cast<char>(qGreen(c)));
+        res.append(static_cast<char>(qBlue(c)));
+    }
+    const int minCodeSize = qMax(2, tableBits);
+    res.append(static_cast<char>(minCodeSize));
+    appendSubBlocks(res, lzwCompress(indices, minCodeSize));
+    return res;
+}
+
+// frameDelay returns the milliseconds until the next frame, the last one
+// lasts until the end of the recording
+qint64 frameDelay(const QList<ClipEncoder::Frame> &frames, const int i,
+                  const qint64 end)
+{
+    const qint64 next = i + 1 < frames.size() ?
+                frames.at(i + 1).timestamp : end;
+    return qMax<qint64>(0, next - frames.at(i).timestamp);
+}
+
+} // unnamed namespace
+
+ClipEncoder::ClipEncoder(const Format format) : m_format(format) {
+
+}
+
+bool ClipEncoder::parseFormat(const QString &name, Format &format) {
+    if (name == "gif") {
+        format = FORMAT_GIF;
+    } else if (name == "apng") {
+        format = FORMAT_APNG;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+QString ClipEncoder::suffix() const {
+    return m_format == FORMAT_GIF ? ".gif" : ".png";
+}
+
+// encodeFrame encodes the @rect area of the frame, without a previous
+// frame it is a key frame which doesn't depend on the others
+ClipEncoder::Frame ClipEncoder::encodeFrame(
+        const QImage &frame, const QImage &previous, const QRect &rect,
+        const qint64 timestamp) const
+{
+    const bool key = previous.isNull();
+    QImage area(rect.size(), QImage::Format_ARGB32);
+    for (int y = 0; y < rect.height(); ++y) {
+        auto current = reinterpret_cast<const QRgb *>(
+                    frame.constScanLine(rect.y() + y)) + rect.x();
+        auto before = key ? nullptr : reinterpret_cast<const QRgb *>(
+                                previous.constScanLine(rect.y() + y)) + rect.x();
+        auto out = reinterpret_cast<QRgb *>(area.scanLine(y));
+        for (int x = 0; x < rect.width(); ++x) {
+            out[x] = before && before[x] == current[x] ?
+                        0 : current[x] | 0xff000000u;
+        }
+    }
+    Frame res = { timestamp, rect, key, QByteArray(), -1 };
+    if (m_format == FORMAT_GIF) {
+        res.data = gifImage(area, rect, res.transparentIndex);
+    } else {
+        res.data = PngEncoder(FRAME_COMPRESSION).imageData(area);
+    }
+    return res;
+}
+
+// assemble joins the frames, the first one must be a key frame
+QByteArray ClipEncoder::assemble(const QSize &size, const QList<Frame> &frames,
+                                 const qint64 end) const
+{
+    if (frames.isEmpty() || !frames.first().key) {
+        return QByteArray();
+    }
+    return m_format == FORMAT_GIF ? assembleGif(size, frames, end) :
+                                    assembleApng(size, frames, end);
+}
+
+QByteArray ClipEncoder::assembleGif(const QSize &size,
+                                    const QList<Frame> &frames,
+                                    const qint64 end) const
+{
+    QByteArray res("GIF89a");
+    appendUInt16LE(res, size.width());
+    appendUInt16LE(res, size.height());
+    // no global color table, every frame has its own
+    res.append(static_cast<char>(0x70));
+    res.append(2, static_cast<char>(0));
+    // endless loop
+    res.append("\x21\xff\x0bNETSCAPE2.0\x03\x01", 16);
+    res.append(3, static_cast<char>(0));
+    for (int i = 0; i < frames.size(); ++i) {
+        const Frame &f = frames.at(i);
+        // graphic control extension, the frame stays under the next one
+        const bool transparent = f.transparentIndex >= 0;
+        res.append("\x21\xf9\x04", 3);
+        res.append(static_cast<char>((1 << 2) | (transparent ? 1 : 0)));
+        const qint64 centiseconds = (frameDelay(frames, i, end) + 5) / 10;
+        appendUInt16LE(res, qBound<qint64>(2, centiseconds, 0xffff));
+        res.append(static_cast<char>(transparent ? f.transparentIndex : 0));
+        res.append(static_cast<char>(0));
+        res.append(f.data);
+    }
+    res.append(static_cast<char>(0x3b));
+    return res;
+}
+
+QByteArray ClipEncoder::assembleApng(const QSize &size,
+                                     const QList<Frame> &frames,
+                                     const qint64 end) const
+{
+    QByteArray res(PNG_SIGNATURE, 8);
+    QByteArray header;
+    appendUInt32(header, size.width());
+    appendUInt32(header, size.height());
+    // 8 bit RGBA
+    header.append(static_cast<char>(8));
+    header.append(static_cast<char>(6));
+    header.append(3, static_cast<char>(0));
+    appendPngChunk(res, "IHDR", header);
+    QByteArray animation;
+    appendUInt32(animation, frames.size());
+    // endless loop
+    appendUInt32(animation, 0);
+    appendPngChunk(res, "acTL", animation);
+
+    quint32 sequence = 0;
+    for (int i = 0; i < frames.size(); ++i) {
+        const Frame &f = frames.at(i);
+        qint64 delay = frameDelay(frames, i, end);
+        int denominator = 1000;
+        if (delay > 0xffff) {
+            delay = qMin<qint64>(delay / 100, 0xffff);
+            denominator = 10;
+        }
+        QByteArray control;
+        appendUInt32(control, sequence++);
+        appendUInt32(control, f.rect.width());
+        appendUInt32(control, f.rect.height());
+        appendUInt32(control, f.rect.x());
+        appendUInt32(control, f.rect.y());
+        appendUInt16(control, delay);
+        appendUInt16(control, denominator);
+        // no disposal, the key frames replace the area and the others
+        // are blended over the previous frame
+        control.append(static_cast<char>(0));
+        control.append(static_cast<char>(f.key ? 0 : 1));
+        appendPngChunk(res, "fcTL", control);
+        if (i == 0) {
+            appendPngChunk(res, "IDAT", f.data);
+        } else {
+            QByteArray data;
+            appendUInt32(data, sequence++);
+            data.append(f.data);
+            appendPngChunk(res, "fdAT", data);
+        }
+    }
+    appendPngChunk(res, "IEND", QByteArray());
+    return res;
+}
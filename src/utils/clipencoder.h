@@ -0,0 +1,62 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CLIPENCODER_H
+#define CLIPENCODER_H
+
+#include <QImage>
+#include <QList>
+#include <QByteArray>
+
+class ClipEncoder
+{
+public:
+    enum Format {
+        FORMAT_GIF,
+        FORMAT_APNG,
+    };
+
+    // a frame ready to be written, only the changed area of the clip
+    struct Frame {
+        // milliseconds since the start of the recording
+        qint64 timestamp;
+        QRect rect;
+        bool key;
+        QByteArray data;
+        int transparentIndex;
+    };
+
+    explicit ClipEncoder(const Format format);
+
+    static bool parseFormat(const QString &name, Format &format);
+    QString suffix() const;
+
+    Frame encodeFrame(const QImage &frame, const QImage &previous,
+                      const QRect &rect, const qint64 timestamp) const;
+    QByteArray assemble(const QSize &size, const QList<Frame> &frames,
+                        const qint64 end) const;
+
+private:
+    Format m_format;
+
+    QByteArray assembleGif(const QSize &size, const QList<Frame> &frames,
+                           const qint64 end) const;
+    QByteArray assembleApng(const QSize &size, const QList<Frame> &frames,
+                            const qint64 end) const;
+};
+
+#endif // CLIPENCODER_H
@@ -44,6 +44,14 @@ void ConfigHandler::setSavePath(const QString &savePath) {
     m_settings.setValue("savePath", savePath);
 }
 
+QString ConfigHandler::lastCapturePathValue() {
+    return m_settings.value("lastCapturePath").toString();
+}
+
+void ConfigHandler::setLastCapturePath(const QString &path) {
+    m_settings.setValue("lastCapturePath", path);
+}
+
 QColor ConfigHandler::uiMainColorValue() {
     return m_settings.value("uiColor").value<QColor>();
 }
@@ -108,6 +116,120 @@ void ConfigHandler::setdrawThickness(const int thickness) {
     m_settings.setValue("drawThickness", thickness);
 }
 
+int ConfigHandler::pngCompressionLevelValue() {
+    return qBound(0, m_settings.value("pngCompressionLevel", 6).toInt(), 9);
+}
+
+void ConfigHandler::setPngCompressionLevel(const int level) {
+    m_settings.setValue("pngCompressionLevel", qBound(0, level, 9));
+}
+
+int ConfigHandler::filenameSequenceValue() {
+    return qMax(1, m_settings.value("filenameSequence", 1).toInt());
+}
+
+void ConfigHandler::setFilenameSequence(const int value) {
+    m_settings.setValue("filenameSequence", value);
+}
+
+bool ConfigHandler::autoFormatValue() {
+    return m_settings.value("autoFormat", true).toBool();
+}
+
+void ConfigHandler::setAutoFormat(const bool autoFormat) {
+    m_settings.setValue("autoFormat", autoFormat);
+}
+
+int ConfigHandler::maxFileSizeValue() {
+    return qMax(0, m_settings.value("maxFileSize", 0).toInt());
+}
+
+void ConfigHandler::setMaxFileSize(const int bytes) {
+    m_settings.setValue("maxFileSize", qMax(0, bytes));
+}
+
+int ConfigHandler::duplicateActionValue() {
+    return qBound(0, m_settings.value("duplicateAction", 1).toInt(), 2);
+}
+
+void ConfigHandler::setDuplicateAction(const int action) {
+    m_settings.setValue("duplicateAction", qBound(0, action, 2));
+}
+
+int ConfigHandler::saveSyncPolicyValue() {
+    return qBound(0, m_settings.value("saveSyncPolicy", 1).toInt(), 2);
+}
+
+void ConfigHandler::setSaveSyncPolicy(const int policy) {
+    m_settings.setValue("saveSyncPolicy", qBound(0, policy, 2));
+}
+
+bool ConfigHandler::idleRecompressionValue() {
+    return m_settings.value("idleRecompression", true).toBool();
+}
+
+void ConfigHandler::setIdleRecompression(const bool recompress) {
+    m_settings.setValue("idleRecompression", recompress);
+}
+
+bool ConfigHandler::frameServerValue() {
+    return m_settings.value("frameServer", false).toBool();
+}
+
+void ConfigHandler::setFrameServer(const bool enabled) {
+    m_settings.setValue("frameServer", enabled);
+}
+
+int ConfigHandler::clipFpsValue() {
+    return qBound(1, m_settings.value("clipFps", 10).toInt(), 30);
+}
+
+void ConfigHandler::setClipFps(const int fps) {
+    m_settings.setValue("clipFps", qBound(1, fps, 30));
+}
+
+// clipLengthValue returns the seconds kept by the clip recorder
+int ConfigHandler::clipLengthValue() {
+    return qBound(1, m_settings.value("clipLength", 10).toInt(), 60);
+}
+
+void ConfigHandler::setClipLength(const int seconds) {
+    m_settings.setValue("clipLength", qBound(1, seconds, 60));
+}
+
+QString ConfigHandler::clipFormatValue() {
+    QString format = m_settings.value("clipFormat", "gif").toString();
+    return format == "apng" ? format : "gif";
+}
+
+void ConfigHandler::setClipFormat(const QString &format) {
+    m_settings.setValue("clipFormat", format);
+}
+
+// the pipelines are the subgroups of the "pipelines" group, named after
+// them
+QStringList ConfigHandler::pipelineNamesValue() {
+    m_settings.beginGroup("pipelines");
+    QStringList res = m_settings.childGroups();
+    m_settings.endGroup();
+    return res;
+}
+
+QString ConfigHandler::pipelineStagesValue(const QString &name) {
+    return m_settings.value("pipelines/" + name + "/stages").toString();
+}
+
+QString ConfigHandler::pipelineShortcutValue(const QString &name) {
+    return m_settings.value("pipelines/" + name + "/shortcut").toString();
+}
+
+void ConfigHandler::setPipeline(const QString &name, const QString &stages,
+                                const QString &shortcut)
+{
+    m_settings.setValue("pipelines/" + name + "/stages", stages);
+    m_settings.setValue("pipelines/" + name + "/shortcut", shortcut);
+}
+
 bool ConfigHandler::initiatedIsSet() {
     return m_settings.value("initiated").toBool();
 }
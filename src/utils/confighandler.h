@@ -33,6 +33,9 @@ public:
     QString savePathValue();
     void setSavePath(const QString &);
 
+    QString lastCapturePathValue();
+    void setLastCapturePath(const QString &);
+
     QColor uiMainColorValue();
     void setUIMainColor(const QColor &);
 
@@ -57,6 +60,43 @@ public:
     int drawThicknessValue();
     void setdrawThickness(const int);
 
+    int pngCompressionLevelValue();
+    void setPngCompressionLevel(const int);
+
+    int filenameSequenceValue();
+    void setFilenameSequence(const int);
+
+    bool autoFormatValue();
+    void setAutoFormat(const bool);
+
+    int maxFileSizeValue();
+    void setMaxFileSize(const int);
+
+    int duplicateActionValue();
+    void setDuplicateAction(const int);
+
+    int saveSyncPolicyValue();
+    void setSaveSyncPolicy(const int);
+
+    bool idleRecompressionValue();
+    void setIdleRecompression(const bool);
+
+    bool frameServerValue();
+    void setFrameServer(const bool);
+
+    int clipFpsValue();
+    void setClipFps(const int);
+    int clipLengthValue();
+    void setClipLength(const int);
+    QString clipFormatValue();
+    void setClipFormat(const QString &);
+
+    QStringList pipelineNamesValue();
+    QString pipelineStagesValue(const QString &name);
+    QString pipelineShortcutValue(const QString &name);
+    void setPipeline(const QString &name, const QString &stages,
+                     const QString &shortcut);
+
     bool initiatedIsSet();
     void setInitiated();
     void setNotInitiated();
@@ -20,13 +20,17 @@
 #include <QApplication>
 #include <QTextStream>
 #include <QFile>
+#include <QDBusUnixFileDescriptor>
+#include <QSocketNotifier>
+#include <cerrno>
+#include <unistd.h>
 
-DBusUtils::DBusUtils(QObject *parent) : QObject(parent) {
+DBusUtils::DBusUtils(QObject *parent) : QObject(parent), m_rawOutput(false) {
     m_id = qHash(qApp->arguments().join(" "));
 }
 
 DBusUtils::DBusUtils(uint id, QObject *parent) :
-    QObject(parent), m_id(id)
+    QObject(parent), m_id(id), m_rawOutput(false)
 {
 }
 
@@ -37,6 +41,121 @@ void DBusUtils::checkDBusConnection(const QDBusConnection &c) {
     }
 }
 
+// setRawOutput defines if printDiffReply prints the annotated image instead
+// of the list of changed areas
+void DBusUtils::setRawOutput(const bool raw) {
+    m_rawOutput = raw;
+}
+
+// printImageReply copies to stdout the image of the file descriptor
+// returned by graphicCaptureFd and fullScreenFd
+void DBusUtils::printImageReply(const QDBusMessage &reply) {
+    if (reply.type() != QDBusMessage::ReplyMessage ||
+            reply.arguments().isEmpty())
+    {
+        QTextStream(stdout) << "screenshot failed";
+        return;
+    }
+    auto descriptor = reply.arguments().first().value<QDBusUnixFileDescriptor>();
+    QFile image;
+    QFile out;
+    if (!descriptor.isValid() ||
+            !image.open(descriptor.fileDescriptor(), QIODevice::ReadOnly) ||
+            !out.open(stdout, QIODevice::WriteOnly))
+    {
+        QTextStream(stdout) << "screenshot failed";
+        return;
+    }
+    QByteArray buffer(64 * 1024, 0);
+    qint64 n;
+    while ((n = image.read(buffer.data(), buffer.size())) > 0) {
+        if (out.write(buffer.constData(), n) != n) {
+            break;
+        }
+    }
+    out.close();
+    image.close();
+}
+
+// printDiffReply prints the reply of diffCaptureFd, the annotated image or
+// the changed areas
+void DBusUtils::printDiffReply(const QDBusMessage &reply) {
+    if (reply.type() != QDBusMessage::ReplyMessage ||
+            reply.arguments().size() < 5)
+    {
+        QTextStream(stdout) << "diff failed";
+        return;
+    }
+    if (m_rawOutput) {
+        printImageReply(reply);
+        return;
+    }
+    QTextStream out(stdout);
+    for (const QString &r: reply.arguments().at(4).toStringList()) {
+        out << r << "\n";
+    }
+}
+
+// followStream waits for the end of the stream, with @triggers every line
+// of stdin grabs a frame and the end of stdin stops the stream
+void DBusUtils::followStream(const uint stream, const bool triggers) {
+    m_id = stream;
+    if (triggers) {
+        readLines("triggerFrame", "stopStream");
+    }
+}
+
+// followBurst waits for the end of the burst, with @flushes every line of
+// stdin saves the frames in memory and the end of stdin stops the burst
+void DBusUtils::followBurst(const uint burst, const bool flushes) {
+    m_id = burst;
+    if (flushes) {
+        readLines("flushBurst", "stopBurst");
+    }
+}
+
+// followWatch waits for the end of the watch, it doesn't read stdin to run
+// in the background; the daemon stops the watch when the CLI is killed
+void DBusUtils::followWatch(const uint watch) {
+    m_id = watch;
+}
+
+void DBusUtils::readLines(const QString &lineMethod, const QString &endMethod) {
+    m_triggerMethod = lineMethod;
+    m_stopMethod = endMethod;
+    auto notifier = new QSocketNotifier(STDIN_FILENO,
+                                        QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated,
+            this, &DBusUtils::readTriggers);
+}
+
+void DBusUtils::readTriggers() {
+    char buffer[256];
+    const ssize_t n = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) {
+        return;
+    }
+    QDBusConnection sessionBus = QDBusConnection::sessionBus();
+    if (n <= 0) {
+        auto notifier = qobject_cast<QSocketNotifier *>(sender());
+        notifier->setEnabled(false);
+        notifier->deleteLater();
+        QDBusMessage m = QDBusMessage::createMethodCall(
+                    "org.dharkael.Flameshot", "/", "", m_stopMethod);
+        m << m_id;
+        sessionBus.send(m);
+        return;
+    }
+    for (ssize_t i = 0; i < n; ++i) {
+        if (buffer[i] == '\n') {
+            QDBusMessage m = QDBusMessage::createMethodCall(
+                        "org.dharkael.Flameshot", "/", "", m_triggerMethod);
+            m << m_id;
+            sessionBus.send(m);
+        }
+    }
+}
+
 void DBusUtils::captureTaken(uint id, QByteArray rawImage) {
     if (m_id == id) {
         QFile file;
@@ -53,3 +172,43 @@ void DBusUtils::captureFailed(uint id) {
         qApp->exit();
     }
 }
+
+// streamFinished reports in stderr, stdout only carries the frames
+void DBusUtils::streamFinished(uint stream, uint frames, uint dropped) {
+    if (m_id == stream) {
+        QTextStream(stderr) << QString("%1 frames streamed, %2 dropped\n")
+                               .arg(frames).arg(dropped);
+        qApp->exit();
+    }
+}
+
+void DBusUtils::burstFlushed(uint burst, QStringList paths) {
+    if (m_id == burst) {
+        QTextStream out(stdout);
+        for (const QString &path: paths) {
+            out << path << "\n";
+        }
+    }
+}
+
+void DBusUtils::burstFinished(uint burst, uint frames, uint dropped) {
+    if (m_id == burst) {
+        QTextStream(stderr) << QString("%1 frames grabbed, %2 dropped\n")
+                               .arg(frames).arg(dropped);
+        qApp->exit();
+    }
+}
+
+void DBusUtils::watchSaved(uint watch, uint frame, QString path) {
+    if (m_id == watch) {
+        QTextStream(stdout) << QString("%1 %2\n").arg(frame).arg(path);
+    }
+}
+
+void DBusUtils::watchFinished(uint watch, uint grabs, uint saved) {
+    if (m_id == watch) {
+        QTextStream(stderr) << QString("%1 grabs, %2 frames saved\n")
+                               .arg(grabs).arg(saved);
+        qApp->exit();
+    }
+}
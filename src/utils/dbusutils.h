@@ -20,6 +20,7 @@
 
 #include "src/cli/commandlineparser.h"
 #include <QDBusConnection>
+#include <QDBusMessage>
 #include <QObject>
 
 class DBusUtils : public QObject
@@ -30,13 +31,33 @@ public:
     explicit DBusUtils(uint id, QObject *parent = nullptr);
 
     void checkDBusConnection(const QDBusConnection &connection);
+    void setRawOutput(const bool raw);
+    void printImageReply(const QDBusMessage &reply);
+    void printDiffReply(const QDBusMessage &reply);
+    void followStream(const uint stream, const bool triggers);
+    void followBurst(const uint burst, const bool flushes);
+    void followWatch(const uint watch);
 
 public slots:
     void captureTaken(uint id, QByteArray rawImage);
     void captureFailed(uint id);
+    void streamFinished(uint stream, uint frames, uint dropped);
+    void burstFlushed(uint burst, QStringList paths);
+    void burstFinished(uint burst, uint frames, uint dropped);
+    void watchSaved(uint watch, uint frame, QString path);
+    void watchFinished(uint watch, uint grabs, uint saved);
+
+private slots:
+    void readTriggers();
 
 private:
     uint m_id;
+    bool m_rawOutput;
+    // methods called for each line of stdin and at its end
+    QString m_triggerMethod;
+    QString m_stopMethod;
+
+    void readLines(const QString &lineMethod, const QString &endMethod);
 };
 
 #endif // TERMINALUTILS_H
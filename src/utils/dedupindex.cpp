@@ -0,0 +1,321 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "dedupindex.h"
+#include "src/utils/mipmapcache.h"
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QtAlgorithms>
+#include <QDir>
+#include <cstring>
+
+// DedupIndex remembers the hashes of the saved captures in a memory mapped
+// file. The exact hashes live in an open addressing table, a lookup reads a
+// couple of slots whatever the size of the index. The perceptual hashes of
+// the last captures are kept in a ring and compared one by one to report
+// similar captures. The paths are stored apart in an append only file.
+// The index is a cache, deleting it only loses the known duplicates.
+
+namespace {
+
+const char MAGIC[4] = { 'F', 'S', 'D', 'X' };
+const quint32 VERSION = 1;
+const quint32 INITIAL_CAPACITY = 1024;
+const int RECENT_SIZE = 1024;
+const int DIGEST_SIZE = 16;
+
+struct Header {
+    char magic[4];
+    quint32 version;
+    quint32 capacity;
+    quint32 count;
+    quint32 recentHead;
+    quint32 recentCount;
+    char reserved[40];
+};
+
+struct Recent {
+    quint64 perceptual;
+    quint64 pathOffset;
+};
+
+// an empty slot has a 0 path offset, the paths file starts with a newline
+// so no path is stored there
+struct Slot {
+    uchar digest[DIGEST_SIZE];
+    quint64 perceptual;
+    quint64 pathOffset;
+};
+
+static_assert(sizeof(Header) == 64, "unexpected header padding");
+static_assert(sizeof(Slot) == 32, "unexpected slot padding");
+
+const qint64 TABLE_START = sizeof(Header) + RECENT_SIZE * sizeof(Recent);
+
+inline Header *header(uchar *map) {
+    return reinterpret_cast<Header *>(map);
+}
+
+inline Recent *recent(uchar *map) {
+    return reinterpret_cast<Recent *>(map + sizeof(Header));
+}
+
+inline Slot *slots(uchar *map) {
+    return reinterpret_cast<Slot *>(map + TABLE_START);
+}
+
+qint64 indexSize(const quint32 capacity) {
+    return TABLE_START + static_cast<qint64>(capacity) * sizeof(Slot);
+}
+
+} // unnamed namespace
+
+DedupIndex::DedupIndex() : m_map(nullptr), m_opened(false) {
+
+}
+
+DedupIndex::~DedupIndex() {
+    if (m_map) {
+        m_indexFile.unmap(m_map);
+    }
+}
+
+DedupIndex *DedupIndex::getInstance() {
+    static DedupIndex index;
+    return &index;
+}
+
+// hashImage hashes the pixels, the same capture saved in two formats has
+// the same hash. The perceptual hash is a difference hash: the capture is
+// reduced to 9x8 gray pixels and every bit tells if a pixel is brighter
+// than its right neighbour.
+DedupIndex::CaptureHash DedupIndex::hashImage(const QImage &image) {
+    const QImage converted = image.convertToFormat(image.hasAlphaChannel() ?
+            QImage::Format_ARGB32 : QImage::Format_RGB32);
+    QCryptographicHash sha(QCryptographicHash::Sha256);
+    const qint32 size[2] = { converted.width(), converted.height() };
+    sha.addData(reinterpret_cast<const char *>(size), sizeof(size));
+    const int rowBytes = converted.width() * 4;
+    for (int y = 0; y < converted.height(); ++y) {
+        sha.addData(reinterpret_cast<const char *>(converted.constScanLine(y)),
+                    rowBytes);
+    }
+
+    const QImage small = Mipmap(converted).scaled(QSize(9, 8),
+                                                  Qt::IgnoreAspectRatio);
+    quint64 perceptual = 0;
+    for (int y = 0; y < 8; ++y) {
+        auto line = reinterpret_cast<const QRgb *>(small.constScanLine(y));
+        for (int x = 0; x < 8; ++x) {
+            perceptual <<= 1;
+            if (qGray(line[x]) > qGray(line[x + 1])) {
+                perceptual |= 1;
+            }
+        }
+    }
+    return { sha.result().left(DIGEST_SIZE), perceptual };
+}
+
+int DedupIndex::distance(const quint64 a, const quint64 b) {
+    return qPopulationCount(a ^ b);
+}
+
+// findIdentical returns the path of a saved capture with the same pixels
+QString DedupIndex::findIdentical(const CaptureHash &hash) {
+    QMutexLocker locker(&m_mutex);
+    if (!open()) {
+        return QString();
+    }
+    const Slot &slot = slots(m_map)[findSlot(hash.digest)];
+    return slot.pathOffset == 0 ? QString() : pathAt(slot.pathOffset);
+}
+
+// findSimilar returns the path of the closest of the last captures when
+// its perceptual hash differs in @maxDistance bits at most
+QString DedupIndex::findSimilar(const CaptureHash &hash,
+                                const int maxDistance)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!open()) {
+        return QString();
+    }
+    const Header *h = header(m_map);
+    const Recent *r = recent(m_map);
+    int best = maxDistance + 1;
+    quint64 bestOffset = 0;
+    for (quint32 i = 0; i < h->recentCount; ++i) {
+        const int d = distance(hash.perceptual, r[i].perceptual);
+        if (d < best) {
+            best = d;
+            bestOffset = r[i].pathOffset;
+        }
+    }
+    return bestOffset == 0 ? QString() : pathAt(bestOffset);
+}
+
+// insert adds the capture or, if the same pixels were saved before,
+// points their entry to the new path
+void DedupIndex::insert(const CaptureHash &hash, const QString &path) {
+    QMutexLocker locker(&m_mutex);
+    if (!open()) {
+        return;
+    }
+    const quint64 offset = appendPath(path);
+    if (offset == 0) {
+        return;
+    }
+    Header *h = header(m_map);
+    // the load factor stays under 1/2 so the probes are short
+    if ((h->count + 1) * 2 > h->capacity) {
+        if (!grow()) {
+            return;
+        }
+        h = header(m_map);
+    }
+    Slot &slot = slots(m_map)[findSlot(hash.digest)];
+    if (slot.pathOffset == 0) {
+        std::memcpy(slot.digest, hash.digest.constData(), DIGEST_SIZE);
+        h->count++;
+    }
+    slot.perceptual = hash.perceptual;
+    slot.pathOffset = offset;
+
+    Recent &last = recent(m_map)[h->recentHead];
+    last.perceptual = hash.perceptual;
+    last.pathOffset = offset;
+    h->recentHead = (h->recentHead + 1) % RECENT_SIZE;
+    h->recentCount = qMin<quint32>(h->recentCount + 1, RECENT_SIZE);
+}
+
+bool DedupIndex::open() {
+    if (m_opened) {
+        return m_map != nullptr;
+    }
+    m_opened = true;
+    QString dir = QStandardPaths::writableLocation(
+                QStandardPaths::DataLocation);
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+    m_indexFile.setFileName(dir + "/captures.idx");
+    m_pathsFile.setFileName(dir + "/captures.paths");
+    if (!m_indexFile.open(QIODevice::ReadWrite) ||
+            !m_pathsFile.open(QIODevice::ReadWrite))
+    {
+        return false;
+    }
+    bool valid = m_indexFile.size() >= TABLE_START;
+    if (valid) {
+        Header h;
+        m_indexFile.read(reinterpret_cast<char *>(&h), sizeof(h));
+        valid = std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                h.version == VERSION &&
+                m_indexFile.size() == indexSize(h.capacity);
+    }
+    if (!valid) {
+        // a new or unreadable index starts empty
+        m_indexFile.resize(0);
+        m_pathsFile.resize(0);
+        if (!m_indexFile.resize(indexSize(INITIAL_CAPACITY))) {
+            return false;
+        }
+        Header h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        h.capacity = INITIAL_CAPACITY;
+        m_indexFile.seek(0);
+        m_indexFile.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        m_indexFile.flush();
+    }
+    if (m_pathsFile.size() == 0) {
+        m_pathsFile.write("\n");
+        m_pathsFile.flush();
+    }
+    return mapIndex();
+}
+
+bool DedupIndex::mapIndex() {
+    m_map = m_indexFile.map(0, m_indexFile.size());
+    return m_map != nullptr;
+}
+
+// grow doubles the table, the entries are inserted again in the new one
+bool DedupIndex::grow() {
+    const Header old = *header(m_map);
+    QVector<Slot> entries;
+    entries.reserve(old.count);
+    const Slot *table = slots(m_map);
+    for (quint32 i = 0; i < old.capacity; ++i) {
+        if (table[i].pathOffset != 0) {
+            entries.append(table[i]);
+        }
+    }
+    m_indexFile.unmap(m_map);
+    m_map = nullptr;
+    const quint32 capacity = old.capacity * 2;
+    if (!m_indexFile.resize(indexSize(capacity)) || !mapIndex()) {
+        return false;
+    }
+    std::memset(m_map + TABLE_START, 0, capacity * sizeof(Slot));
+    header(m_map)->capacity = capacity;
+    for (const Slot &entry: entries) {
+        const QByteArray digest = QByteArray::fromRawData(
+                    reinterpret_cast<const char *>(entry.digest), DIGEST_SIZE);
+        slots(m_map)[findSlot(digest)] = entry;
+    }
+    return true;
+}
+
+// findSlot returns the slot of the digest or the empty one where it goes
+int DedupIndex::findSlot(const QByteArray &digest) const {
+    const quint32 mask = header(m_map)->capacity - 1;
+    quint64 start;
+    std::memcpy(&start, digest.constData(), sizeof(start));
+    const Slot *table = slots(m_map);
+    quint32 i = start & mask;
+    while (table[i].pathOffset != 0 &&
+           std::memcmp(table[i].digest, digest.constData(), DIGEST_SIZE) != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+QString DedupIndex::pathAt(const quint64 offset) {
+    if (!m_pathsFile.seek(offset)) {
+        return QString();
+    }
+    QByteArray line = m_pathsFile.readLine();
+    if (line.endsWith('\n')) {
+        line.chop(1);
+    }
+    return QString::fromUtf8(line);
+}
+
+quint64 DedupIndex::appendPath(const QString &path) {
+    const qint64 offset = m_pathsFile.size();
+    if (!m_pathsFile.seek(offset)) {
+        return 0;
+    }
+    const QByteArray line = path.toUtf8() + '\n';
+    if (m_pathsFile.write(line) != line.size() || !m_pathsFile.flush()) {
+        return 0;
+    }
+    return offset;
+}
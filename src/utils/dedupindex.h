@@ -0,0 +1,63 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef DEDUPINDEX_H
+#define DEDUPINDEX_H
+
+#include <QImage>
+#include <QFile>
+#include <QMutex>
+
+class DedupIndex
+{
+public:
+    // hashes of the pixels of a capture, the cryptographic one is truncated
+    // to 128 bits as it only has to tell captures apart
+    struct CaptureHash {
+        QByteArray digest;
+        quint64 perceptual;
+    };
+
+    static DedupIndex* getInstance();
+
+    static CaptureHash hashImage(const QImage &image);
+    static int distance(const quint64 a, const quint64 b);
+
+    QString findIdentical(const CaptureHash &hash);
+    QString findSimilar(const CaptureHash &hash, const int maxDistance);
+    void insert(const CaptureHash &hash, const QString &path);
+
+private:
+    DedupIndex();
+    ~DedupIndex();
+
+    QMutex m_mutex;
+    QFile m_indexFile;
+    QFile m_pathsFile;
+    uchar *m_map;
+    bool m_opened;
+
+    bool open();
+    bool mapIndex();
+    bool grow();
+    int findSlot(const QByteArray &digest) const;
+    QString pathAt(const quint64 offset);
+    quint64 appendPath(const QString &path);
+};
+
+#endif // DEDUPINDEX_H
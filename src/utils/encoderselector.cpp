@@ -0,0 +1,250 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "encoderselector.h"
+#include "src/utils/pngencoder.h"
+#include "src/utils/confighandler.h"
+#include <QtConcurrent>
+#include <QImageWriter>
+#include <QBuffer>
+#include <QPainter>
+#include <algorithm>
+
+// EncoderSelector picks the format of a capture from its content. A color
+// histogram with an early exit tells if the capture fits in a palette PNG,
+// as most captures of user interfaces do. Richer captures go to lossless
+// WebP, or to lossy WebP or JPEG when the config limits the file size.
+
+namespace {
+
+const int PALETTE_LIMIT = 256;
+// slots of the hash table of every band, a power of 2 over twice the limit
+const int TABLE_SIZE = 1024;
+const int ROWS_PER_BAND = 64;
+const int MIN_QUALITY = 20;
+const int MAX_QUALITY = 95;
+
+struct Band {
+    int firstRow;
+    int rows;
+    QVector<QRgb> colors;
+};
+
+} // unnamed namespace
+
+EncoderSelector::EncoderSelector(const bool allowWebp) {
+    ConfigHandler config;
+    m_auto = config.autoFormatValue();
+    m_maxSize = config.maxFileSizeValue();
+    m_webp = allowWebp &&
+            QImageWriter::supportedImageFormats().contains("webp");
+}
+
+// encodingKey tells apart the choices which produce different files
+QString EncoderSelector::encodingKey(const Choice &choice) {
+    switch (choice.encoding) {
+    case ENCODING_PALETTE_PNG:
+        return QString("png-palette-%1").arg(choice.palette.size());
+    case ENCODING_LOSSLESS_WEBP:
+        return "webp-lossless";
+    case ENCODING_WEBP:
+        return QString("webp-%1").arg(ConfigHandler().maxFileSizeValue());
+    case ENCODING_JPEG:
+        return QString("jpeg-%1").arg(ConfigHandler().maxFileSizeValue());
+    default:
+        return "png";
+    }
+}
+
+EncoderSelector::Choice EncoderSelector::choose(const QImage &image) const {
+    Choice res { ENCODING_PNG, QVector<QRgb>(), ".png", QString() };
+    if (!m_auto || image.isNull()) {
+        return res;
+    }
+    if (m_maxSize > 0) {
+        res.encoding = m_webp ? ENCODING_WEBP : ENCODING_JPEG;
+        res.suffix = m_webp ? ".webp" : ".jpg";
+        return res;
+    }
+    const QImage converted = image.convertToFormat(image.hasAlphaChannel() ?
+            QImage::Format_ARGB32 : QImage::Format_RGB32);
+    QVector<QRgb> palette = colors(converted, PALETTE_LIMIT);
+    if (!palette.isEmpty()) {
+        res.encoding = ENCODING_PALETTE_PNG;
+        res.palette = palette;
+        res.reason = QObject::tr("palette PNG, %1 colors").arg(palette.size());
+    } else if (m_webp) {
+        res.encoding = ENCODING_LOSSLESS_WEBP;
+        res.suffix = ".webp";
+        res.reason = QObject::tr("lossless WebP, more than %1 colors")
+                .arg(PALETTE_LIMIT);
+    } else {
+        res.reason = QObject::tr("PNG, more than %1 colors")
+                .arg(PALETTE_LIMIT);
+    }
+    return res;
+}
+
+// write encodes the image as chosen, the lossy encodings complete the
+// reason with the quality used
+bool EncoderSelector::write(const QImage &image, Choice &choice,
+                            QIODevice *device) const
+{
+    if (choice.encoding == ENCODING_PNG ||
+            choice.encoding == ENCODING_PALETTE_PNG)
+    {
+        PngEncoder encoder;
+        encoder.setPalette(choice.palette);
+        return encoder.write(image, device);
+    }
+    QByteArray data = encode(image, choice);
+    return !data.isEmpty() && device->write(data) == data.size();
+}
+
+QByteArray EncoderSelector::encode(const QImage &image, Choice &choice) const {
+    switch (choice.encoding) {
+    case ENCODING_LOSSLESS_WEBP: {
+        QByteArray res;
+        QBuffer buffer(&res);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "webp");
+        // the WebP plugin switches to lossless with the top quality
+        writer.setQuality(100);
+        return writer.write(image) ? res : QByteArray();
+    }
+    case ENCODING_WEBP:
+    case ENCODING_JPEG:
+        return encodeLossy(image, choice);
+    default: {
+        PngEncoder encoder;
+        encoder.setPalette(choice.palette);
+        return encoder.encode(image);
+    }
+    }
+}
+
+// colors returns the colors of the image, or nothing when there are more
+// than @limit. Every band of rows fills its own small hash table and all
+// of them stop as soon as one goes over the limit.
+QVector<QRgb> EncoderSelector::colors(const QImage &image,
+                                      const int limit) const
+{
+    QVector<Band> bands;
+    for (int y = 0; y < image.height(); y += ROWS_PER_BAND) {
+        bands.append({ y, qMin(ROWS_PER_BAND, image.height() - y),
+                       QVector<QRgb>() });
+    }
+    QAtomicInt exceeded(0);
+    QtConcurrent::blockingMap(bands, [&image, &exceeded, limit](Band &band) {
+        QVector<QRgb> table(TABLE_SIZE);
+        QVector<bool> used(TABLE_SIZE, false);
+        for (int y = band.firstRow; y < band.firstRow + band.rows; ++y) {
+            if (exceeded.load()) {
+                return;
+            }
+            auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            QRgb last = line[0];
+            bool lastAdded = false;
+            for (int x = 0; x < image.width(); ++x) {
+                const QRgb c = line[x];
+                if (c == last && lastAdded) {
+                    continue;
+                }
+                last = c;
+                lastAdded = true;
+                uint slot = (c * 2654435761u) & (TABLE_SIZE - 1);
+                while (used.at(slot) && table.at(slot) != c) {
+                    slot = (slot + 1) & (TABLE_SIZE - 1);
+                }
+                if (!used.at(slot)) {
+                    used[slot] = true;
+                    table[slot] = c;
+                    band.colors.append(c);
+                    if (band.colors.size() > limit) {
+                        exceeded.store(1);
+                        return;
+                    }
+                }
+            }
+        }
+    });
+    if (exceeded.load()) {
+        return QVector<QRgb>();
+    }
+    QVector<QRgb> res;
+    for (const Band &band: bands) {
+        res += band.colors;
+    }
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res.size() > limit ? QVector<QRgb>() : res;
+}
+
+// encodeLossy looks for the highest quality which fits in the size limit
+// with a binary search
+QByteArray EncoderSelector::encodeLossy(const QImage &image,
+                                        Choice &choice) const
+{
+    const bool webp = choice.encoding == ENCODING_WEBP;
+    const char *format = webp ? "webp" : "jpeg";
+    // JPEG has no alpha channel, the transparent areas would turn black
+    QImage source = image;
+    if (!webp && image.hasAlphaChannel()) {
+        source = QImage(image.size(), QImage::Format_RGB32);
+        source.fill(Qt::white);
+        QPainter painter(&source);
+        painter.drawImage(0, 0, image);
+    }
+    auto encodeAt = [&source, format](const int quality) {
+        QByteArray res;
+        QBuffer buffer(&res);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, format);
+        writer.setQuality(quality);
+        return writer.write(source) ? res : QByteArray();
+    };
+
+    QByteArray best;
+    int bestQuality = MIN_QUALITY;
+    int low = MIN_QUALITY, high = MAX_QUALITY;
+    while (low <= high) {
+        const int quality = (low + high) / 2;
+        QByteArray data = encodeAt(quality);
+        if (data.isEmpty()) {
+            return data;
+        }
+        if (data.size() <= m_maxSize) {
+            best = data;
+            bestQuality = quality;
+            low = quality + 1;
+        } else {
+            high = quality - 1;
+        }
+    }
+    const QString name = webp ? "WebP" : "JPEG";
+    const int limitKb = m_maxSize / 1024;
+    if (best.isEmpty()) {
+        best = encodeAt(MIN_QUALITY);
+        choice.reason = QObject::tr("%1 quality %2, over the %3 KB limit")
+                .arg(name).arg(MIN_QUALITY).arg(limitKb);
+    } else {
+        choice.reason = QObject::tr("%1 quality %2, limited to %3 KB")
+                .arg(name).arg(bestQuality).arg(limitKb);
+    }
+    return best;
+}
@@ -0,0 +1,65 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef ENCODERSELECTOR_H
+#define ENCODERSELECTOR_H
+
+#include <QImage>
+#include <QVector>
+#include <QString>
+
+class QIODevice;
+
+class EncoderSelector
+{
+public:
+    enum Encoding {
+        ENCODING_PNG,
+        ENCODING_PALETTE_PNG,
+        ENCODING_LOSSLESS_WEBP,
+        ENCODING_WEBP,
+        ENCODING_JPEG,
+    };
+
+    struct Choice {
+        Encoding encoding;
+        // colors of the palette PNG
+        QVector<QRgb> palette;
+        QString suffix;
+        // why the encoding was chosen, shown to the user
+        QString reason;
+    };
+
+    explicit EncoderSelector(const bool allowWebp = true);
+
+    static QString encodingKey(const Choice &choice);
+
+    Choice choose(const QImage &image) const;
+    bool write(const QImage &image, Choice &choice, QIODevice *device) const;
+    QByteArray encode(const QImage &image, Choice &choice) const;
+
+private:
+    bool m_auto;
+    int m_maxSize;
+    bool m_webp;
+
+    QVector<QRgb> colors(const QImage &image, const int limit) const;
+    QByteArray encodeLossy(const QImage &image, Choice &choice) const;
+};
+
+#endif // ENCODERSELECTOR_H
@@ -17,89 +17,139 @@
 
 #include "filenamehandler.h"
 #include "src/utils/confighandler.h"
-#include <ctime>
+#include "src/utils/savequeue.h"
+#include "src/utils/filenameindex.h"
+#include "src/utils/filenametemplate.h"
 #include <locale>
 #include <QStandardPaths>
 #include <QDir>
 
-FileNameHandler::FileNameHandler(QObject *parent) : QObject(parent) {
-    std::locale::global(std::locale(""));
-}
+namespace {
 
-QString FileNameHandler::parsedPattern() {
-    return parseFilename(ConfigHandler().filenamePatternValue());
+// compiledPattern keeps the last pattern used, it only changes when the
+// user edits it
+const FilenameTemplate &compiledPattern(const QString &pattern) {
+    static FilenameTemplate cached;
+    if (cached.pattern() != pattern) {
+        cached = FilenameTemplate(pattern);
+    }
+    return cached;
 }
 
-QString FileNameHandler::parseFilename(const QString &name) {
-    QString res;
-    if (name.isEmpty()) {
-        res = tr("screenshot");
-    } else {
-        std::time_t t = std::time(NULL);
+} // unnamed namespace
 
-        char *tempData = QStringTocharArr(name);
-        char data[MAX_CHARACTERS] = {0};
-        std::strftime(data, sizeof(data),
-                      tempData, std::localtime(&t));
-        res = QString::fromLocal8Bit(data, strlen(data));
-        free(tempData);
+FileNameHandler::FileNameHandler(QObject *parent) : QObject(parent) {
+    // the locale of the month and day names, set only once
+    static bool localeSet = false;
+    if (!localeSet) {
+        std::locale::global(std::locale(""));
+        localeSet = true;
     }
-    // add the parsed pattern in a correct format for the filesystem
-    res = res.replace("/", "⁄");
-    return res;
 }
 
-QString FileNameHandler::generateAbsolutePath(const QString &path)
+QString FileNameHandler::parsedPattern(const QRect &geometry) {
+    return parseFilename(ConfigHandler().filenamePatternValue(), geometry);
+}
+
+// parseFilename shows the next value of the sequence without using it
+QString FileNameHandler::parseFilename(const QString &name,
+                                       const QRect &geometry)
+{
+    return expand(name, geometry, false);
+}
+
+QString FileNameHandler::generateAbsolutePath(const QString &path,
+                                              const QRect &geometry,
+                                              const QString &suffix)
 {
     QString directory = path;
-    QString filename = parsedPattern();
-    fixPath(directory, filename);
+    QString filename = expand(ConfigHandler().filenamePatternValue(),
+                              geometry, true);
+    fixPath(directory, filename, suffix);
     return directory + filename;
 }
-// path a images si no existe, add numeration
+
 void FileNameHandler::setPattern(const QString &pattern) {
     ConfigHandler().setFilenamePattern(pattern);
 }
 
-QString FileNameHandler::absoluteSavePath(QString &directory, QString &filename) {
+// absoluteSavePath only proposes a path, the dialog can still be canceled.
+// reserveSavePath takes it once the save is confirmed
+QString FileNameHandler::absoluteSavePath(QString &directory, QString &filename,
+                                          const QRect &geometry)
+{
     ConfigHandler config;
     directory = config.savePathValue();
     if (directory.isEmpty() || !QDir(directory).exists() || !QFileInfo(directory).isWritable()) {
         directory = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
     }
-    filename = parsedPattern();
-    fixPath(directory, filename);
+    filename = expand(config.filenamePatternValue(), geometry, false);
+    fixPath(directory, filename, ".png", false);
     return directory + filename;
 }
 
-QString FileNameHandler::charArrToQString(const char *c) {
-    return QString::fromLocal8Bit(c, MAX_CHARACTERS);
+// reserveSavePath advances the sequence used by the proposed name and keeps
+// the saved file out of the next names
+void FileNameHandler::reserveSavePath(const QString &path) {
+    ConfigHandler config;
+    const QString pattern = config.filenamePatternValue();
+    if (!pattern.isEmpty() && compiledPattern(pattern).usesSequence()) {
+        config.setFilenameSequence(config.filenameSequenceValue() + 1);
+    }
+    const QFileInfo info(path);
+    QString directory = info.absolutePath();
+    if (!directory.endsWith("/")) {
+        directory += "/";
+    }
+    FileNameIndex::getInstance()->reserve(directory, info.fileName());
 }
 
-char * FileNameHandler::QStringTocharArr(const QString &s) {
-    QByteArray ba = s.toLocal8Bit();
-    return const_cast<char *>(strdup(ba.constData()));
+// expand fills the pattern, when @useSequence is true and the pattern has
+// the %{seq} token the stored sequence advances
+QString FileNameHandler::expand(const QString &pattern, const QRect &geometry,
+                                const bool useSequence)
+{
+    QString res;
+    if (pattern.isEmpty()) {
+        res = tr("screenshot");
+    } else {
+        const FilenameTemplate &compiled = compiledPattern(pattern);
+        ConfigHandler config;
+        FilenameTemplate::Context context;
+        context.sequence = compiled.usesSequence() ?
+                    config.filenameSequenceValue() : 0;
+        context.geometry = geometry;
+        res = compiled.expand(context);
+        if (useSequence && compiled.usesSequence()) {
+            config.setFilenameSequence(context.sequence + 1);
+        }
+    }
+    // add the parsed pattern in a correct format for the filesystem
+    res = res.replace("/", "⁄");
+    return res;
 }
 
-void FileNameHandler::fixPath(QString &directory, QString &filename) {
+void FileNameHandler::fixPath(QString &directory, QString &filename,
+                              const QString &suffix, const bool reserve)
+{
     // add '/' at the end of the directory
     if (!directory.endsWith("/")) {
         directory += "/";
     }
-    // add numeration in case of repeated filename in the directory
-    // find unused name adding _n where n is a number
-    QFileInfo checkFile(directory + filename + ".png");
-    if (checkFile.exists()) {
-        filename += "_";
-        int i = 1;
-        while (true) {
-            checkFile.setFile(
-                        directory + filename + QString::number(i) + ".png");
-            if (!checkFile.exists()) {
-                filename += QString::number(i);
-                break;
-            }
-            ++i;
-        }
+    // add numeration in case of repeated filename in the directory,
+    // the index gives the next _n without checking every previous one.
+    // The disk and the save queue are checked just in case the index
+    // didn't get the last changes yet
+    FileNameIndex *index = FileNameIndex::getInstance();
+    const QString base = filename;
+    filename = index->freeName(directory, base, suffix);
+    while (QFileInfo(directory + filename + suffix).exists() ||
+           SaveQueue::getInstance()->isPending(directory + filename + suffix))
+    {
+        index->reserve(directory, filename + suffix);
+        filename = index->freeName(directory, base, suffix);
+    }
+    if (reserve) {
+        index->reserve(directory, filename + suffix);
     }
 }
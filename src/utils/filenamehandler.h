@@ -19,6 +19,7 @@
 #define FILENAMEHANDLER_H
 
 #include <QObject>
+#include <QRect>
 
 
 class FileNameHandler : public QObject
@@ -27,10 +28,15 @@ class FileNameHandler : public QObject
 public:
     explicit FileNameHandler(QObject *parent = nullptr);
 
-    QString parsedPattern();
-    QString parseFilename(const QString &name);
-    QString generateAbsolutePath(const QString &path);
-    QString absoluteSavePath(QString &directory, QString &filename);
+    QString parsedPattern(const QRect &geometry = QRect());
+    QString parseFilename(const QString &name,
+                          const QRect &geometry = QRect());
+    QString generateAbsolutePath(const QString &path,
+                                 const QRect &geometry = QRect(),
+                                 const QString &suffix = ".png");
+    QString absoluteSavePath(QString &directory, QString &filename,
+                             const QRect &geometry = QRect());
+    void reserveSavePath(const QString &path);
 
     static const int MAX_CHARACTERS = 70;
 
@@ -38,11 +44,10 @@ public slots:
     void setPattern(const QString &pattern);
 
 private:
-    //using charArr = char[MAX_CHARACTERS];
-    QString charArrToQString(const char *c);
-    char * QStringTocharArr(const QString &s);
-
-    void fixPath(QString &directory, QString &filename);
+    QString expand(const QString &pattern, const QRect &geometry,
+                   const bool useSequence);
+    void fixPath(QString &directory, QString &filename,
+                 const QString &suffix = ".png", const bool reserve = true);
 
 };
 
@@ -0,0 +1,130 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "filenameindex.h"
+#include <QFileSystemWatcher>
+#include <QDir>
+#include <QFileInfo>
+
+// FileNameIndex keeps the file names of the save directories in memory to
+// find a free name without probing the disk for every numbered candidate.
+// A directory is listed once and listed again only after a file watcher
+// reports a change in it.
+
+namespace {
+
+// directories watched at most, the oldest ones are forgotten
+const int MAX_DIRECTORIES = 8;
+
+} // unnamed namespace
+
+FileNameIndex::FileNameIndex(QObject *parent) : QObject(parent) {
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            this, &FileNameIndex::invalidate);
+}
+
+FileNameIndex *FileNameIndex::getInstance() {
+    static FileNameIndex index;
+    return &index;
+}
+
+// freeName returns filename, or filename_n with the n following the highest
+// one in use, so the result plus the suffix doesn't exist in the directory
+QString FileNameIndex::freeName(const QString &directory,
+                                const QString &filename,
+                                const QString &suffix)
+{
+    Entry &e = entry(directory);
+    if (!e.names.contains(filename + suffix)) {
+        return filename;
+    }
+    const QString base = filename + "_";
+    int n = e.lastNumbers.value(base + suffix, 0) + 1;
+    while (e.names.contains(base + QString::number(n) + suffix)) {
+        ++n;
+    }
+    return base + QString::number(n);
+}
+
+// reserve adds a name before the file is written, the next call to
+// freeName won't return it
+void FileNameIndex::reserve(const QString &directory, const QString &name) {
+    add(entry(directory), name);
+}
+
+void FileNameIndex::invalidate(const QString &directory) {
+    const QString path = QDir::cleanPath(directory);
+    if (m_entries.contains(path)) {
+        m_entries[path].valid = false;
+    }
+}
+
+FileNameIndex::Entry &FileNameIndex::entry(const QString &path) {
+    const QString directory = QDir::cleanPath(path);
+    if (!m_entries.contains(directory) &&
+            m_entries.size() >= MAX_DIRECTORIES)
+    {
+        m_watcher->removePaths(m_watcher->directories());
+        m_entries.clear();
+    }
+    Entry &e = m_entries[directory];
+    if (!e.valid) {
+        e.names.clear();
+        e.lastNumbers.clear();
+        if (!m_watcher->directories().contains(directory) &&
+                QFileInfo(directory).isDir())
+        {
+            m_watcher->addPath(directory);
+        }
+        // the watcher is set before listing, a file created meanwhile
+        // invalidates the entry again
+        const QStringList names = QDir(directory).entryList(QDir::Files);
+        for (const QString &name: names) {
+            add(e, name);
+        }
+        e.valid = true;
+    }
+    return e;
+}
+
+// add records the name and, for names like base_n.ext, the highest n
+// of base_ with the .ext suffix
+void FileNameIndex::add(Entry &entry, const QString &name) {
+    entry.names.insert(name);
+    int dot = name.lastIndexOf('.');
+    if (dot < 0) {
+        dot = name.size();
+    }
+    int digits = dot;
+    while (digits > 0 && name.at(digits - 1).isDigit()) {
+        --digits;
+    }
+    if (digits == dot || digits == 0 || name.at(digits - 1) != '_') {
+        return;
+    }
+    bool ok;
+    const int n = name.mid(digits, dot - digits).toInt(&ok);
+    if (!ok) {
+        return;
+    }
+    const QString key = name.left(digits) + name.mid(dot);
+    if (n > entry.lastNumbers.value(key, 0)) {
+        entry.lastNumbers.insert(key, n);
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef FILENAMEINDEX_H
+#define FILENAMEINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+
+class QFileSystemWatcher;
+
+class FileNameIndex : public QObject
+{
+    Q_OBJECT
+public:
+    static FileNameIndex* getInstance();
+
+    QString freeName(const QString &directory, const QString &filename,
+                     const QString &suffix);
+    void reserve(const QString &directory, const QString &name);
+
+private slots:
+    void invalidate(const QString &directory);
+
+private:
+    explicit FileNameIndex(QObject *parent = nullptr);
+
+    // names of a directory and the highest _n suffix used by every base name
+    struct Entry {
+        Entry() : valid(false) {}
+        QSet<QString> names;
+        QHash<QString, int> lastNumbers;
+        bool valid;
+    };
+
+    QHash<QString, Entry> m_entries;
+    QFileSystemWatcher *m_watcher;
+
+    Entry &entry(const QString &path);
+    void add(Entry &entry, const QString &name);
+};
+
+#endif // FILENAMEINDEX_H
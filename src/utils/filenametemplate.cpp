@@ -0,0 +1,113 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "filenametemplate.h"
+
+// FilenameTemplate splits the filename pattern once in the strftime parts,
+// already converted to the local 8 bit encoding, and the tokens computed by
+// flameshot: %{seq}, %{size} and %{geometry}. Expanding it doesn't parse
+// the pattern again.
+
+namespace {
+
+const int BUFFER_SIZE = 512;
+
+} // unnamed namespace
+
+FilenameTemplate::FilenameTemplate() : m_usesSequence(false) {
+
+}
+
+FilenameTemplate::FilenameTemplate(const QString &pattern) :
+    m_pattern(pattern), m_usesSequence(false)
+{
+    int textStart = 0;
+    int i = pattern.indexOf("%{");
+    while (i >= 0) {
+        const int end = pattern.indexOf('}', i);
+        if (end < 0) {
+            break;
+        }
+        const QString token = pattern.mid(i + 2, end - i - 2);
+        SegmentType type;
+        if (token == "seq") {
+            type = SEGMENT_SEQUENCE;
+            m_usesSequence = true;
+        } else if (token == "size") {
+            type = SEGMENT_SIZE;
+        } else if (token == "geometry") {
+            type = SEGMENT_GEOMETRY;
+        } else {
+            // unknown tokens are kept as text
+            i = pattern.indexOf("%{", i + 2);
+            continue;
+        }
+        appendTime(pattern.mid(textStart, i - textStart));
+        m_segments.append({ type, QByteArray() });
+        textStart = end + 1;
+        i = pattern.indexOf("%{", textStart);
+    }
+    appendTime(pattern.mid(textStart));
+}
+
+QString FilenameTemplate::pattern() const {
+    return m_pattern;
+}
+
+bool FilenameTemplate::usesSequence() const {
+    return m_usesSequence;
+}
+
+QString FilenameTemplate::expand(const Context &context,
+                                 const std::time_t t) const
+{
+    QString res;
+    std::tm localTime = *std::localtime(&t);
+    char data[BUFFER_SIZE];
+    const QRect &g = context.geometry;
+    for (const Segment &segment: m_segments) {
+        switch (segment.type) {
+        case SEGMENT_TIME: {
+            size_t length = std::strftime(data, sizeof(data),
+                                          segment.format.constData(),
+                                          &localTime);
+            res += QString::fromLocal8Bit(data, static_cast<int>(length));
+            break;
+        }
+        case SEGMENT_SEQUENCE:
+            res += QString::number(context.sequence);
+            break;
+        case SEGMENT_SIZE:
+            res += QString("%1x%2").arg(g.width()).arg(g.height());
+            break;
+        case SEGMENT_GEOMETRY:
+            res += QString("%1x%2+%3+%4").arg(g.width()).arg(g.height())
+                    .arg(g.x()).arg(g.y());
+            break;
+        }
+    }
+    return res;
+}
+
+// appendTime adds a strftime part, the literal text between the tokens is
+// left to strftime too as it copies it unchanged
+void FilenameTemplate::appendTime(const QString &text) {
+    if (!text.isEmpty()) {
+        m_segments.append({ SEGMENT_TIME, text.toLocal8Bit() });
+    }
+}
@@ -0,0 +1,65 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef FILENAMETEMPLATE_H
+#define FILENAMETEMPLATE_H
+
+#include <QVector>
+#include <QString>
+#include <QRect>
+#include <ctime>
+
+class FilenameTemplate
+{
+public:
+    FilenameTemplate();
+    explicit FilenameTemplate(const QString &pattern);
+
+    // values of the tokens which don't come from the clock
+    struct Context {
+        int sequence;
+        QRect geometry;
+    };
+
+    QString pattern() const;
+    bool usesSequence() const;
+    QString expand(const Context &context,
+                   const std::time_t t = std::time(nullptr)) const;
+
+private:
+    enum SegmentType {
+        SEGMENT_TIME,
+        SEGMENT_SEQUENCE,
+        SEGMENT_SIZE,
+        SEGMENT_GEOMETRY,
+    };
+
+    struct Segment {
+        SegmentType type;
+        // strftime format of the SEGMENT_TIME segments
+        QByteArray format;
+    };
+
+    QString m_pattern;
+    QVector<Segment> m_segments;
+    bool m_usesSequence;
+
+    void appendTime(const QString &text);
+};
+
+#endif // FILENAMETEMPLATE_H
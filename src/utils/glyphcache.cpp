@@ -0,0 +1,179 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "glyphcache.h"
+#include <QPainter>
+#include <QFontMetrics>
+#include <QTextBoundaryFinder>
+#include <QtMath>
+
+// GlyphCache keeps the rendered grapheme clusters by font, color and pixel
+// ratio so repainting a text only blits small images instead of shaping
+// and rasterizing it again. Kerning between clusters is not applied. The
+// lines of scripts which need shaping or bidi reordering, like Arabic or
+// the Indic ones, are drawn whole by the painter instead.
+
+namespace {
+
+// maximum size of the rendered glyphs in bytes
+const int MAX_CACHE_COST = 8 * 1024 * 1024;
+
+QStringList clusters(const QString &line) {
+    QStringList res;
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Grapheme, line);
+    int start = 0;
+    while (finder.toNextBoundary() != -1) {
+        res << line.mid(start, finder.position() - start);
+        start = finder.position();
+    }
+    return res;
+}
+
+// cachedLine tells if the clusters of the line can be drawn one by one,
+// the glyphs of these scripts don't depend on their neighbours
+bool cachedLine(const QString &line) {
+    for (const QChar c: line) {
+        switch (c.script()) {
+        case QChar::Script_Common:
+        case QChar::Script_Inherited:
+        case QChar::Script_Latin:
+        case QChar::Script_Greek:
+        case QChar::Script_Cyrillic:
+        case QChar::Script_Han:
+        case QChar::Script_Hiragana:
+        case QChar::Script_Katakana:
+        case QChar::Script_Hangul:
+            break;
+        default:
+            return false;
+        }
+        // right to left marks and embeddings of the common script
+        const QChar::Direction d = c.direction();
+        if (d == QChar::DirR || d == QChar::DirAL || d == QChar::DirRLE ||
+                d == QChar::DirRLO || d == QChar::DirRLI)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// lineWidth is the advance of the line as drawText draws it
+int lineWidth(const QFontMetrics &fm, const QString &line) {
+    if (!cachedLine(line)) {
+        return fm.width(line);
+    }
+    int res = 0;
+    for (const QString &cluster: clusters(line)) {
+        res += fm.width(cluster);
+    }
+    return res;
+}
+
+} // unnamed namespace
+
+GlyphCache::GlyphCache() : m_cache(MAX_CACHE_COST) {
+
+}
+
+GlyphCache* GlyphCache::getInstance() {
+    static GlyphCache cache;
+    return &cache;
+}
+
+// drawText draws the text with its top left corner in pos and returns the
+// point of the baseline where the next glyph would be drawn
+QPoint GlyphCache::drawText(QPainter &painter, const QPoint &pos,
+                            const QString &text, const QFont &font,
+                            const QColor &color)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+    const qreal ratio = painter.device()->devicePixelRatioF();
+#else
+    const qreal ratio = painter.device()->devicePixelRatio();
+#endif
+    QFontMetrics fm(font);
+    QPoint pen(pos.x(), pos.y() + fm.ascent());
+    const QStringList lines = text.split('\n');
+    for (int i = 0; i < lines.size(); ++i) {
+        if (i > 0) {
+            pen = QPoint(pos.x(), pen.y() + fm.lineSpacing());
+        }
+        const QString &line = lines.at(i);
+        if (!cachedLine(line)) {
+            painter.save();
+            painter.setFont(font);
+            painter.setPen(color);
+            painter.drawText(pen, line);
+            painter.restore();
+            pen.rx() += fm.width(line);
+            continue;
+        }
+        for (const QString &cluster: clusters(line)) {
+            Glyph g = glyph(cluster, font, color, ratio);
+            if (!g.image.isNull()) {
+                painter.drawImage(pen + g.offset, g.image);
+            }
+            pen.rx() += g.advance;
+        }
+    }
+    return pen;
+}
+
+// boundingRect returns the area covered by the text drawn in pos
+QRect GlyphCache::boundingRect(const QPoint &pos, const QString &text,
+                               const QFont &font) const
+{
+    QFontMetrics fm(font);
+    const QStringList lines = text.split('\n');
+    int width = 0;
+    for (const QString &line: lines) {
+        width = qMax(width, lineWidth(fm, line));
+    }
+    // glyphs like italic ones may exceed their advance
+    const int margin = fm.height() / 4 + 1;
+    QRect res(pos, QSize(width, fm.height() + fm.lineSpacing() * (lines.size() - 1)));
+    return res.adjusted(-margin, -margin, margin, margin);
+}
+
+GlyphCache::Glyph GlyphCache::glyph(const QString &cluster, const QFont &font,
+                                    const QColor &color, const qreal ratio)
+{
+    const QString key = QString("%1|%2|%3|%4").arg(font.key(),
+            color.name(QColor::HexArgb), QString::number(ratio), cluster);
+    if (Glyph *cached = m_cache.object(key)) {
+        return *cached;
+    }
+    QFontMetrics fm(font);
+    Glyph g;
+    g.advance = fm.width(cluster);
+    QRect box = fm.boundingRect(cluster).adjusted(-1, -1, 1, 1);
+    g.offset = box.topLeft();
+    if (!cluster.trimmed().isEmpty()) {
+        g.image = QImage(qCeil(box.width() * ratio),
+                         qCeil(box.height() * ratio),
+                         QImage::Format_ARGB32_Premultiplied);
+        g.image.setDevicePixelRatio(ratio);
+        g.image.fill(Qt::transparent);
+        QPainter painter(&g.image);
+        painter.setFont(font);
+        painter.setPen(color);
+        painter.drawText(-box.x(), -box.y(), cluster);
+    }
+    m_cache.insert(key, new Glyph(g), qMax(1, g.image.byteCount()));
+    return g;
+}
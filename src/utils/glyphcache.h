@@ -0,0 +1,52 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GLYPHCACHE_H
+#define GLYPHCACHE_H
+
+#include <QCache>
+#include <QImage>
+
+class QPainter;
+class QFont;
+
+class GlyphCache
+{
+public:
+    static GlyphCache* getInstance();
+
+    QPoint drawText(QPainter &painter, const QPoint &pos, const QString &text,
+                    const QFont &font, const QColor &color);
+    QRect boundingRect(const QPoint &pos, const QString &text,
+                       const QFont &font) const;
+
+private:
+    GlyphCache();
+
+    struct Glyph {
+        QImage image;
+        QPoint offset;
+        int advance;
+    };
+
+    QCache<QString, Glyph> m_cache;
+
+    Glyph glyph(const QString &cluster, const QFont &font, const QColor &color,
+                const qreal ratio);
+};
+
+#endif // GLYPHCACHE_H
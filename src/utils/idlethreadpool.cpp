@@ -0,0 +1,33 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "idlethreadpool.h"
+#include <QThread>
+
+IdleThreadPool::IdleThreadPool(QObject *parent) : QThreadPool(parent) {
+    setMaxThreadCount(1);
+    // the lowered thread is kept instead of being started again
+    setExpiryTimeout(-1);
+}
+
+void IdleThreadPool::lowerPriority() {
+    QThread *thread = QThread::currentThread();
+    if (thread->priority() != QThread::IdlePriority) {
+        thread->setPriority(QThread::IdlePriority);
+    }
+}
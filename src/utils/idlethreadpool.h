@@ -0,0 +1,80 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef IDLETHREADPOOL_H
+#define IDLETHREADPOOL_H
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QFuture>
+#include <QFutureInterface>
+#include <functional>
+
+// IdleThreadPool runs background jobs in a single thread of its own which
+// is lowered to the idle priority by its first job. The thread never goes
+// back to a normal priority, an unprivileged thread can't leave the idle
+// class on Linux, so it is never shared with other work and the threads of
+// the global pool keep their priority.
+class IdleThreadPool : public QThreadPool
+{
+public:
+    explicit IdleThreadPool(QObject *parent = nullptr);
+
+    template <typename T>
+    QFuture<T> run(const std::function<T()> &job);
+
+private:
+    template <typename T>
+    class Task;
+
+    static void lowerPriority();
+};
+
+template <typename T>
+class IdleThreadPool::Task : public QRunnable
+{
+public:
+    explicit Task(const std::function<T()> &job) : m_job(job) {
+        m_interface.reportStarted();
+    }
+
+    QFuture<T> future() {
+        return m_interface.future();
+    }
+
+    void run() override {
+        IdleThreadPool::lowerPriority();
+        const T res = m_job();
+        m_interface.reportResult(res);
+        m_interface.reportFinished();
+    }
+
+private:
+    QFutureInterface<T> m_interface;
+    std::function<T()> m_job;
+};
+
+template <typename T>
+QFuture<T> IdleThreadPool::run(const std::function<T()> &job) {
+    auto task = new Task<T>(job);
+    const QFuture<T> future = task->future();
+    start(task);
+    return future;
+}
+
+#endif // IDLETHREADPOOL_H
@@ -0,0 +1,235 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "imagediff.h"
+#include "src/utils/tilehasher.h"
+#include <QtConcurrent>
+#include <QPainter>
+#include <QRegion>
+
+// ImageDiff compares two captures of the same area. Tiles with the same
+// hash are skipped and only the remaining ones are compared pixel by pixel.
+
+namespace {
+
+const QColor MARK_COLOR(Qt::red);
+const int MARK_WIDTH = 2;
+
+} // unnamed namespace
+
+ImageDiff::ImageDiff() : m_tileSize(0) {
+
+}
+
+ImageDiff::ImageDiff(const QImage &before, const QImage &after,
+                     const int tileSize) : m_tileSize(tileSize)
+{
+    m_after = after.convertToFormat(QImage::Format_RGB32);
+    m_before = before.convertToFormat(QImage::Format_RGB32);
+    // the tiles cover both captures, the area only one of them has is
+    // changed and its pixels aren't compared
+    m_size = m_before.size().expandedTo(m_after.size());
+    const QRect common(QPoint(0, 0),
+                       m_before.size().boundedTo(m_after.size()));
+
+    TileHasher hasher(m_tileSize);
+    QVector<quint64> beforeHashes = hasher.hashTiles(view(m_before, common));
+    QVector<quint64> afterHashes = hasher.hashTiles(view(m_after, common));
+    const int commonColumns = hasher.columns(common.size());
+    const int tiles = hasher.columns(m_size) * hasher.rows(m_size);
+    for (int i = 0; i < tiles; ++i) {
+        const QRect tile = hasher.tileRect(i, m_size);
+        if (!common.contains(tile)) {
+            m_changes.append({ i, tile, 0 });
+            continue;
+        }
+        const int c = (tile.y() / m_tileSize) * commonColumns +
+                tile.x() / m_tileSize;
+        if (beforeHashes.at(c) != afterHashes.at(c)) {
+            m_changes.append({ i, tile, 0 });
+        }
+    }
+
+    // shrink every changed tile to the box of its changed pixels
+    const QImage &b = m_before;
+    const QImage &a = m_after;
+    auto compareTile = [&b, &a, common](TileChange &change) {
+        const QRect tile = change.box;
+        const QRect inside = tile.intersected(common);
+        int left = tile.right() + 1, right = -1;
+        int top = tile.bottom() + 1, bottom = -1;
+        for (int y = inside.top(); y <= inside.bottom(); ++y) {
+            auto lineBefore = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+            auto lineAfter = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+            for (int x = inside.left(); x <= inside.right(); ++x) {
+                if (lineBefore[x] != lineAfter[x]) {
+                    left = qMin(left, x);
+                    right = qMax(right, x);
+                    top = qMin(top, y);
+                    bottom = qMax(bottom, y);
+                    ++change.pixels;
+                }
+            }
+        }
+        QRect box = change.pixels > 0 ?
+                    QRect(QPoint(left, top), QPoint(right, bottom)) : QRect();
+        if (inside != tile) {
+            const QRect outside =
+                    QRegion(tile).subtracted(QRegion(inside)).boundingRect();
+            box = box.united(outside);
+            change.pixels += tile.width() * tile.height() -
+                    qMax(0, inside.width()) * qMax(0, inside.height());
+        }
+        change.box = box;
+    };
+    QtConcurrent::blockingMap(m_changes, compareTile);
+
+    mergeChanges(hasher.columns(m_size), hasher.rows(m_size));
+}
+
+bool ImageDiff::isNull() const {
+    return m_after.isNull();
+}
+
+// view returns the @area of the image sharing its pixels, the area starts
+// at the top left corner
+QImage ImageDiff::view(const QImage &image, const QRect &area) {
+    return QImage(image.constBits(), area.width(), area.height(),
+                  image.bytesPerLine(), image.format());
+}
+
+QVector<QRect> ImageDiff::changedRects() const {
+    return m_rects;
+}
+
+// changedRectsAsText uses the X11 geometry format WxH+X+Y
+QStringList ImageDiff::changedRectsAsText() const {
+    QStringList res;
+    for (const QRect &r: m_rects) {
+        res << QString("%1x%2+%3+%4").arg(r.width()).arg(r.height())
+               .arg(r.x()).arg(r.y());
+    }
+    return res;
+}
+
+int ImageDiff::changedPixels() const {
+    int res = 0;
+    for (const TileChange &change: m_changes) {
+        res += change.pixels;
+    }
+    return res;
+}
+
+// annotatedImage returns the second capture with the changed pixels tinted
+// and the changed areas framed, it covers the area of both captures
+QImage ImageDiff::annotatedImage() const {
+    if (m_after.isNull()) {
+        return QImage();
+    }
+    QImage res = m_after.copy();
+    if (res.size() != m_size) {
+        // the area the second capture doesn't have stays black
+        res = QImage(m_size, QImage::Format_RGB32);
+        res.fill(Qt::black);
+        QPainter painter(&res);
+        painter.drawImage(0, 0, m_after);
+    }
+    if (res.isNull()) {
+        return res;
+    }
+    uchar *bits = res.bits();
+    const int bytesPerLine = res.bytesPerLine();
+    const QImage &b = m_before;
+    const QRect common(QPoint(0, 0), m_before.size().boundedTo(m_after.size()));
+    const QRgb mark = MARK_COLOR.rgb();
+    auto tintTile = [&b, common, bits, bytesPerLine, mark](
+            const TileChange &change)
+    {
+        const QRect &box = change.box;
+        for (int y = box.top(); y <= box.bottom(); ++y) {
+            auto lineBefore = y <= common.bottom() ?
+                        reinterpret_cast<const QRgb *>(b.constScanLine(y)) :
+                        nullptr;
+            auto line = reinterpret_cast<QRgb *>(bits + y * bytesPerLine);
+            for (int x = box.left(); x <= box.right(); ++x) {
+                const bool compared = lineBefore && x <= common.right();
+                if (!compared || lineBefore[x] != line[x]) {
+                    QRgb p = line[x];
+                    line[x] = qRgb((qRed(p) + qRed(mark)) / 2,
+                                   (qGreen(p) + qGreen(mark)) / 2,
+                                   (qBlue(p) + qBlue(mark)) / 2);
+                }
+            }
+        }
+    };
+    QVector<TileChange> changes;
+    for (const TileChange &change: m_changes) {
+        if (change.pixels > 0) {
+            changes.append(change);
+        }
+    }
+    QtConcurrent::blockingMap(changes, tintTile);
+
+    QPainter painter(&res);
+    painter.setPen(QPen(MARK_COLOR, MARK_WIDTH));
+    painter.setBrush(Qt::NoBrush);
+    for (const QRect &r: m_rects) {
+        painter.drawRect(r.adjusted(-MARK_WIDTH, -MARK_WIDTH,
+                                    MARK_WIDTH, MARK_WIDTH));
+    }
+    return res;
+}
+
+// mergeChanges joins the boxes of neighbour changed tiles (including the
+// diagonal ones) in a single rect
+void ImageDiff::mergeChanges(const int columns, const int rows) {
+    QVector<int> changeAt(columns * rows, -1);
+    for (int i = 0; i < m_changes.size(); ++i) {
+        if (m_changes.at(i).pixels > 0) {
+            changeAt[m_changes.at(i).index] = i;
+        }
+    }
+    QVector<bool> visited(m_changes.size(), false);
+    for (int i = 0; i < m_changes.size(); ++i) {
+        if (visited.at(i) || m_changes.at(i).pixels == 0) {
+            continue;
+        }
+        QRect united;
+        QVector<int> pending = { i };
+        visited[i] = true;
+        while (!pending.isEmpty()) {
+            const TileChange &change = m_changes.at(pending.takeLast());
+            united = united.united(change.box);
+            const int column = change.index % columns;
+            const int row = change.index / columns;
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int c = column + dx, r = row + dy;
+                    if (c < 0 || r < 0 || c >= columns || r >= rows) {
+                        continue;
+                    }
+                    int neighbour = changeAt.at(r * columns + c);
+                    if (neighbour >= 0 && !visited.at(neighbour)) {
+                        visited[neighbour] = true;
+                        pending.append(neighbour);
+                    }
+                }
+            }
+        }
+        m_rects.append(united);
+    }
+}
@@ -0,0 +1,58 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IMAGEDIFF_H
+#define IMAGEDIFF_H
+
+#include <QImage>
+#include <QVector>
+#include <QStringList>
+
+class ImageDiff
+{
+public:
+    ImageDiff();
+    ImageDiff(const QImage &before, const QImage &after,
+              const int tileSize = 32);
+
+    bool isNull() const;
+    QVector<QRect> changedRects() const;
+    QStringList changedRectsAsText() const;
+    int changedPixels() const;
+    QImage annotatedImage() const;
+
+private:
+    // bounding box of the changed pixels of a tile
+    struct TileChange {
+        int index;
+        QRect box;
+        int pixels;
+    };
+
+    QImage m_before;
+    QImage m_after;
+    QSize m_size;
+    int m_tileSize;
+    QVector<TileChange> m_changes;
+    QVector<QRect> m_rects;
+
+    void mergeChanges(const int columns, const int rows);
+
+    static QImage view(const QImage &image, const QRect &area);
+};
+
+#endif // IMAGEDIFF_H
@@ -0,0 +1,254 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "imageencoder.h"
+#include <QIODevice>
+#include <QVector>
+#include <cstring>
+
+// ImageEncoder writes the raw captures. Besides PNG it offers formats which
+// are cheap to write and to read for scripts:
+// - ppm: binary netpbm P6, RGB
+// - pam: netpbm P7, RGB_ALPHA when the image has transparency, RGB otherwise
+// - rgba: 16 byte header ("FSRA" and the width, height and bytes per line as
+//   little endian 32 bit integers) followed by the RGBA rows
+// - qoi: the Quite OK Image format, a fast lossless compression
+
+namespace {
+
+const char RGBA_MAGIC[] = "FSRA";
+
+const QStringList FORMAT_NAMES = { "png", "ppm", "pam", "rgba", "qoi" };
+
+void appendUInt32LE(QByteArray &out, const quint32 value) {
+    out.append(static_cast<char>(value & 0xff));
+    out.append(static_cast<char>((value >> 8) & 0xff));
+    out.append(static_cast<char>((value >> 16) & 0xff));
+    out.append(static_cast<char>((value >> 24) & 0xff));
+}
+
+void appendUInt32BE(QByteArray &out, const quint32 value) {
+    out.append(static_cast<char>((value >> 24) & 0xff));
+    out.append(static_cast<char>((value >> 16) & 0xff));
+    out.append(static_cast<char>((value >> 8) & 0xff));
+    out.append(static_cast<char>(value & 0xff));
+}
+
+// rowSource returns the image in a 32 bit format whose rows can be
+// unpacked, the formats of the captures are used as they are so a view of
+// a bigger image isn't copied
+QImage rowSource(const QImage &image) {
+    if (image.format() == QImage::Format_RGB32 ||
+            image.format() == QImage::Format_ARGB32)
+    {
+        return image;
+    }
+    return image.convertToFormat(image.hasAlphaChannel() ?
+            QImage::Format_ARGB32 : QImage::Format_RGB32);
+}
+
+// unpackRow writes a row of a rowSource image as RGB or RGBA bytes, it
+// goes through scanLine so any stride works
+void unpackRow(const QImage &image, const int y, const int bytesPerPixel,
+               uchar *out)
+{
+    auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+    for (int x = 0; x < image.width(); ++x) {
+        const QRgb p = line[x];
+        *out++ = qRed(p);
+        *out++ = qGreen(p);
+        *out++ = qBlue(p);
+        if (bytesPerPixel == 4) {
+            *out++ = qAlpha(p);
+        }
+    }
+}
+
+// appendRows writes the pixels of the image without the line padding
+void appendRows(QByteArray &out, const QImage &image, const int bytesPerPixel) {
+    const QImage source = rowSource(image);
+    const int rowBytes = source.width() * bytesPerPixel;
+    const int offset = out.size();
+    out.resize(offset + rowBytes * source.height());
+    uchar *dst = reinterpret_cast<uchar *>(out.data()) + offset;
+    for (int y = 0; y < source.height(); ++y) {
+        unpackRow(source, y, bytesPerPixel, dst);
+        dst += rowBytes;
+    }
+}
+
+} // unnamed namespace
+
+ImageEncoder::ImageEncoder(const Format format) : m_format(format) {
+
+}
+
+bool ImageEncoder::parseFormat(const QString &name, Format &format) {
+    int index = FORMAT_NAMES.indexOf(name.toLower());
+    if (index >= 0) {
+        format = static_cast<Format>(index);
+    }
+    return index >= 0;
+}
+
+QStringList ImageEncoder::formatNames() {
+    return FORMAT_NAMES;
+}
+
+ImageEncoder::Format ImageEncoder::format() const {
+    return m_format;
+}
+
+QByteArray ImageEncoder::encode(const QImage &image) const {
+    if (image.isNull()) {
+        return QByteArray();
+    }
+    switch (m_format) {
+    case FORMAT_PPM:
+        return encodePpm(image);
+    case FORMAT_PAM:
+        return encodePam(image);
+    case FORMAT_RGBA:
+        return encodeRgba(image);
+    case FORMAT_QOI:
+        return encodeQoi(image);
+    default:
+        return m_pngEncoder.encode(image);
+    }
+}
+
+// write streams the PNG chunks as they are compressed, the other formats
+// are cheap enough to be written at once
+bool ImageEncoder::write(const QImage &image, QIODevice *device) const {
+    if (m_format == FORMAT_PNG) {
+        return m_pngEncoder.write(image, device);
+    }
+    const QByteArray data = encode(image);
+    return !data.isEmpty() && device->write(data) == data.size();
+}
+
+QByteArray ImageEncoder::encodePpm(const QImage &image) const {
+    QByteArray res = QString("P6\n%1 %2\n255\n").arg(image.width())
+            .arg(image.height()).toLatin1();
+    appendRows(res, image, 3);
+    return res;
+}
+
+QByteArray ImageEncoder::encodePam(const QImage &image) const {
+    const bool alpha = image.hasAlphaChannel();
+    QByteArray res = QString("P7\nWIDTH %1\nHEIGHT %2\nDEPTH %3\nMAXVAL 255\n"
+                             "TUPLTYPE %4\nENDHDR\n")
+            .arg(image.width()).arg(image.height())
+            .arg(alpha ? 4 : 3).arg(alpha ? "RGB_ALPHA" : "RGB").toLatin1();
+    appendRows(res, image, alpha ? 4 : 3);
+    return res;
+}
+
+QByteArray ImageEncoder::encodeRgba(const QImage &image) const {
+    QByteArray res(RGBA_MAGIC, 4);
+    appendUInt32LE(res, image.width());
+    appendUInt32LE(res, image.height());
+    appendUInt32LE(res, image.width() * 4);
+    appendRows(res, image, 4);
+    return res;
+}
+
+// encodeQoi follows the QOI specification 1.0
+QByteArray ImageEncoder::encodeQoi(const QImage &image) const {
+    const bool alpha = image.hasAlphaChannel();
+    const QImage source = rowSource(image);
+    QByteArray res("qoif");
+    appendUInt32BE(res, source.width());
+    appendUInt32BE(res, source.height());
+    res.append(static_cast<char>(alpha ? 4 : 3));
+    res.append(static_cast<char>(0));
+
+    // worst case, every pixel as QOI_OP_RGBA
+    const int headerSize = res.size();
+    res.resize(headerSize + source.width() * source.height() * 5 + 8);
+    uchar *out = reinterpret_cast<uchar *>(res.data()) + headerSize;
+
+    quint32 index[64];
+    std::memset(index, 0, sizeof(index));
+    uchar prev[4] = { 0, 0, 0, 255 };
+    int run = 0;
+    const int pixels = source.width() * source.height();
+    int count = 0;
+    // one unpacked row at a time instead of a converted copy of the image
+    QVector<uchar> row(source.width() * 4);
+    for (int y = 0; y < source.height(); ++y) {
+        unpackRow(source, y, 4, row.data());
+        const uchar *px = row.constData();
+        for (int x = 0; x < source.width(); ++x, px += 4) {
+            ++count;
+            if (std::memcmp(px, prev, 4) == 0) {
+                ++run;
+                if (run == 62 || count == pixels) {
+                    *out++ = 0xc0 | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                *out++ = 0xc0 | (run - 1);
+                run = 0;
+            }
+            const int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+            quint32 value;
+            std::memcpy(&value, px, 4);
+            if (index[hash] == value) {
+                *out++ = hash;
+            } else {
+                index[hash] = value;
+                if (px[3] == prev[3]) {
+                    const signed char vr = px[0] - prev[0];
+                    const signed char vg = px[1] - prev[1];
+                    const signed char vb = px[2] - prev[2];
+                    const signed char vgr = vr - vg;
+                    const signed char vgb = vb - vg;
+                    if (vr > -3 && vr < 2 && vg > -3 && vg < 2 &&
+                            vb > -3 && vb < 2)
+                    {
+                        *out++ = 0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                    } else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 &&
+                               vgb > -9 && vgb < 8)
+                    {
+                        *out++ = 0x80 | (vg + 32);
+                        *out++ = (vgr + 8) << 4 | (vgb + 8);
+                    } else {
+                        *out++ = 0xfe;
+                        *out++ = px[0];
+                        *out++ = px[1];
+                        *out++ = px[2];
+                    }
+                } else {
+                    *out++ = 0xff;
+                    *out++ = px[0];
+                    *out++ = px[1];
+                    *out++ = px[2];
+                    *out++ = px[3];
+                }
+            }
+            std::memcpy(prev, px, 4);
+        }
+    }
+    const uchar end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    std::memcpy(out, end, 8);
+    out += 8;
+    res.resize(out - reinterpret_cast<uchar *>(res.data()));
+    return res;
+}
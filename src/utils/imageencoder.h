@@ -0,0 +1,54 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IMAGEENCODER_H
+#define IMAGEENCODER_H
+
+#include "src/utils/pngencoder.h"
+#include <QStringList>
+
+class ImageEncoder
+{
+public:
+    enum Format {
+        FORMAT_PNG,
+        FORMAT_PPM,
+        FORMAT_PAM,
+        FORMAT_RGBA,
+        FORMAT_QOI,
+    };
+
+    explicit ImageEncoder(const Format format = FORMAT_PNG);
+
+    static bool parseFormat(const QString &name, Format &format);
+    static QStringList formatNames();
+
+    Format format() const;
+    QByteArray encode(const QImage &image) const;
+    bool write(const QImage &image, QIODevice *device) const;
+
+private:
+    Format m_format;
+    PngEncoder m_pngEncoder;
+
+    QByteArray encodePpm(const QImage &image) const;
+    QByteArray encodePam(const QImage &image) const;
+    QByteArray encodeRgba(const QImage &image) const;
+    QByteArray encodeQoi(const QImage &image) const;
+};
+
+#endif // IMAGEENCODER_H
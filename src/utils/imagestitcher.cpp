@@ -0,0 +1,274 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "imagestitcher.h"
+#include "src/utils/tilehasher.h"
+#include <cstring>
+
+// ImageStitcher appends the consecutive frames of a scrolling area into a
+// tall image. The scroll offset between two frames is found comparing
+// hashes of whole rows instead of pixels, and the finished rows are moved
+// to a temporary file when they exceed the memory budget.
+
+namespace {
+
+// base of the polynomial hash over sequences of row hashes
+const quint64 ROLLING_BASE = 1000003ULL;
+// ratio of overlapping rows which must be equal to accept an offset,
+// a few rows may differ due to blinking cursors or animations
+const double MIN_MATCH_RATIO = 0.9;
+
+quint64 blockHash(const QVector<quint64> &hashes, const int from, const int length) {
+    quint64 h = 0;
+    for (int i = from; i < from + length; ++i) {
+        h = h * ROLLING_BASE + hashes.at(i);
+    }
+    return h;
+}
+
+} // unnamed namespace
+
+ImageStitcher::ImageStitcher(const int maxRowsInMemory) :
+    m_maxRowsInMemory(maxRowsInMemory), m_lastTop(0), m_memoryRows(0),
+    m_spilledRows(0)
+{
+
+}
+
+// append adds the new rows of the frame. When the scroll offset can't be
+// found, for example because the content moved more than a frame between
+// two grabs, the stitching goes on from the new frame instead of comparing
+// every next one with a stale frame.
+ImageStitcher::AppendResult ImageStitcher::append(const QImage &frame) {
+    QImage image = frame.convertToFormat(QImage::Format_RGB32);
+    if (m_lastFrame.isNull()) {
+        m_lastFrame = image;
+        m_lastHashes = rowHashes(image);
+        m_lastTop = 0;
+        return APPEND_ROWS;
+    }
+    if (image.size() != m_lastFrame.size()) {
+        return APPEND_NOTHING;
+    }
+    QVector<quint64> hashes = rowHashes(image);
+    const int n = hashes.size();
+
+    // rows which stay in the same place are a static header or footer
+    int header = 0;
+    while (header < n && hashes.at(header) == m_lastHashes.at(header)) {
+        ++header;
+    }
+    if (header == n) {
+        return APPEND_NOTHING;
+    }
+    int footer = 0;
+    while (n - footer - 1 > header &&
+           hashes.at(n - footer - 1) == m_lastHashes.at(n - footer - 1))
+    {
+        ++footer;
+    }
+
+    int offset = findOffset(m_lastHashes, hashes, header, footer);
+    if (offset == 0) {
+        return APPEND_NOTHING;
+    }
+    // the rows of the last frame above the new content are finished
+    int bottom = n - footer;
+    if (bottom > m_lastTop) {
+        commit(m_lastFrame.copy(0, m_lastTop, m_lastFrame.width(),
+                                bottom - m_lastTop));
+    }
+    m_lastFrame = image;
+    m_lastHashes = hashes;
+    if (offset < 0) {
+        // the whole body of the new frame follows, without the static header
+        m_lastTop = header;
+        return APPEND_DISCONTINUITY;
+    }
+    m_lastTop = bottom - offset;
+    return APPEND_ROWS;
+}
+
+// result returns the whole stitched image, rows lets a caller stream
+// it instead when it was spilled to disk
+QImage ImageStitcher::result() {
+    if (m_lastFrame.isNull()) {
+        return QImage();
+    }
+    return rows(0, height());
+}
+
+// rows returns @count rows of the stitched image from @first, reading the
+// spilled ones from the temporary file
+QImage ImageStitcher::rows(const int first, const int count) {
+    const int end = qMin(first + count, height());
+    if (m_lastFrame.isNull() || first < 0 || first >= end) {
+        return QImage();
+    }
+    const int rowBytes = width() * 4;
+    QImage res(width(), end - first, QImage::Format_RGB32);
+    if (res.isNull()) {
+        return res;
+    }
+    int row = first;
+    if (row < m_spilledRows) {
+        m_spill.seek(static_cast<qint64>(row) * rowBytes);
+        for (; row < qMin(m_spilledRows, end); ++row) {
+            m_spill.read(reinterpret_cast<char *>(res.scanLine(row - first)),
+                         rowBytes);
+        }
+    }
+    int partTop = m_spilledRows;
+    for (const QImage &part: m_parts) {
+        for (; row < end && row < partTop + part.height(); ++row) {
+            std::memcpy(res.scanLine(row - first),
+                        part.constScanLine(row - partTop), rowBytes);
+        }
+        partTop += part.height();
+    }
+    for (; row < end; ++row) {
+        std::memcpy(res.scanLine(row - first),
+                    m_lastFrame.constScanLine(row - partTop + m_lastTop),
+                    rowBytes);
+    }
+    return res;
+}
+
+int ImageStitcher::width() const {
+    return m_lastFrame.width();
+}
+
+bool ImageStitcher::isSpilled() const {
+    return m_spilledRows > 0;
+}
+
+int ImageStitcher::height() const {
+    int pending = m_lastFrame.isNull() ? 0 : m_lastFrame.height() - m_lastTop;
+    return m_spilledRows + m_memoryRows + pending;
+}
+
+QVector<quint64> ImageStitcher::rowHashes(const QImage &image) {
+    QVector<quint64> res(image.height());
+    const int rowBytes = image.width() * 4;
+    for (int y = 0; y < image.height(); ++y) {
+        res[y] = TileHasher::hashBytes(image.constScanLine(y), rowBytes);
+    }
+    return res;
+}
+
+// findOffset returns how many rows the content moved up between the two
+// frames, 0 when it didn't move and -1 when the offset can't be found.
+// A block of distinct rows of the current frame is searched in the previous
+// one with a rolling hash and every match is verified with the whole overlap.
+int ImageStitcher::findOffset(const QVector<quint64> &previous,
+                              const QVector<quint64> &current,
+                              const int header, const int footer) const
+{
+    const int bottom = current.size() - footer;
+    const int bodyLength = bottom - header;
+    const int k = qBound(4, bodyLength / 8, 64);
+    if (bodyLength < k * 2) {
+        return -1;
+    }
+    // uniform rows (blank areas) match everywhere, look for a block
+    // near the top with enough variation
+    int start = -1;
+    for (int s = header; s + k <= bottom; s += k / 2) {
+        int changes = 0;
+        for (int i = s + 1; i < s + k; ++i) {
+            if (current.at(i) != current.at(i - 1)) {
+                ++changes;
+            }
+        }
+        if (changes >= k / 4) {
+            start = s;
+            break;
+        }
+    }
+    if (start < 0) {
+        return -1;
+    }
+
+    const quint64 target = blockHash(current, start, k);
+    quint64 highestPower = 1;
+    for (int i = 1; i < k; ++i) {
+        highestPower *= ROLLING_BASE;
+    }
+
+    int bestOffset = -1;
+    double bestRatio = 0;
+    quint64 h = blockHash(previous, header, k);
+    for (int p = header; p + k <= bottom; ++p) {
+        if (p > header) {
+            h = (h - previous.at(p - 1) * highestPower) * ROLLING_BASE
+                    + previous.at(p + k - 1);
+        }
+        const int offset = p - start;
+        if (h != target || offset < 0) {
+            continue;
+        }
+        if (std::memcmp(previous.constData() + p, current.constData() + start,
+                        k * sizeof(quint64)) != 0)
+        {
+            continue;
+        }
+        int equal = 0;
+        const int overlap = bottom - offset - header;
+        for (int i = header; i < bottom - offset; ++i) {
+            if (current.at(i) == previous.at(i + offset)) {
+                ++equal;
+            }
+        }
+        double ratio = static_cast<double>(equal) / overlap;
+        // on ties the smallest offset wins, repeated content is common
+        if (ratio >= MIN_MATCH_RATIO && ratio > bestRatio) {
+            bestRatio = ratio;
+            bestOffset = offset;
+        }
+    }
+    return bestOffset;
+}
+
+void ImageStitcher::commit(const QImage &rows) {
+    m_parts.append(rows);
+    m_memoryRows += rows.height();
+    while (m_memoryRows > m_maxRowsInMemory && !m_parts.isEmpty()) {
+        if (!spill()) {
+            break;
+        }
+    }
+}
+
+// spill moves the oldest part in memory to the temporary file
+bool ImageStitcher::spill() {
+    if (!m_spill.isOpen() && !m_spill.open()) {
+        return false;
+    }
+    const QImage part = m_parts.first();
+    const int rowBytes = part.width() * 4;
+    m_spill.seek(static_cast<qint64>(m_spilledRows) * rowBytes);
+    for (int y = 0; y < part.height(); ++y) {
+        const char *line = reinterpret_cast<const char *>(part.constScanLine(y));
+        if (m_spill.write(line, rowBytes) != rowBytes) {
+            return false;
+        }
+    }
+    m_parts.removeFirst();
+    m_memoryRows -= part.height();
+    m_spilledRows += part.height();
+    return true;
+}
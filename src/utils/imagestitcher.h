@@ -0,0 +1,69 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IMAGESTITCHER_H
+#define IMAGESTITCHER_H
+
+#include <QImage>
+#include <QList>
+#include <QTemporaryFile>
+#include <QVector>
+
+class ImageStitcher
+{
+public:
+    explicit ImageStitcher(const int maxRowsInMemory = 4096);
+
+    ImageStitcher(const ImageStitcher &) = delete;
+    ImageStitcher & operator=(const ImageStitcher &) = delete;
+
+    enum AppendResult {
+        APPEND_NOTHING,
+        APPEND_ROWS,
+        // the offset wasn't found, the frame was added below the image
+        APPEND_DISCONTINUITY,
+    };
+
+    AppendResult append(const QImage &frame);
+    QImage result();
+    QImage rows(const int first, const int count);
+    int height() const;
+    int width() const;
+    bool isSpilled() const;
+
+private:
+    int m_maxRowsInMemory;
+    // last frame received, its rows from m_lastTop to the end are the
+    // bottom of the stitched image
+    QImage m_lastFrame;
+    QVector<quint64> m_lastHashes;
+    int m_lastTop;
+    // finished rows, the oldest ones are moved to m_spill
+    QList<QImage> m_parts;
+    int m_memoryRows;
+    QTemporaryFile m_spill;
+    int m_spilledRows;
+
+    static QVector<quint64> rowHashes(const QImage &image);
+    int findOffset(const QVector<quint64> &previous,
+                   const QVector<quint64> &current,
+                   const int header, const int footer) const;
+    void commit(const QImage &rows);
+    bool spill();
+};
+
+#endif // IMAGESTITCHER_H
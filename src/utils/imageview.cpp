@@ -0,0 +1,53 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "imageview.h"
+
+// ImageView returns images which share the pixels of a bigger one, so a
+// selection of the screen can be encoded without copying it out first. A
+// view keeps the source alive and is read only: writing to it detaches a
+// copy as it happens with any shared QImage.
+
+namespace {
+
+void releaseSource(void *source) {
+    delete static_cast<QImage *>(source);
+}
+
+} // unnamed namespace
+
+// crop returns the area of the image as a view, the rows keep the stride
+// of the source so the readers must go through scanLine
+QImage ImageView::crop(const QImage &image, const QRect &area) {
+    const QRect r = area.intersected(image.rect());
+    if (r == image.rect()) {
+        return image;
+    }
+    // the rows of the smaller depths don't start at a byte boundary
+    if (r.isEmpty() || image.depth() < 8) {
+        return image.copy(r);
+    }
+    auto source = new QImage(image);
+    const uchar *data = source->constBits() +
+            r.y() * source->bytesPerLine() + r.x() * (source->depth() / 8);
+    QImage res(data, r.width(), r.height(), source->bytesPerLine(),
+               source->format(), releaseSource, source);
+    res.setColorTable(image.colorTable());
+    res.setDevicePixelRatio(image.devicePixelRatio());
+    return res;
+}
@@ -0,0 +1,150 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "mipmapcache.h"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// MipmapCache keeps a chain of images of every capture shown in a preview,
+// each one half the size of the previous. A preview scales the smallest
+// level bigger than its size, which is at most twice as big, instead of
+// the whole capture.
+
+namespace {
+
+// levels are built until both sides are under this size
+const int MIN_LEVEL_SIZE = 32;
+// memory of the cached mipmaps in KiB
+const int CACHE_KB = 64 * 1024;
+
+// averageRow writes the average of every 2x2 block of the two rows. With
+// SSE2 four source pixels of each row are reduced at once, the rounding of
+// the nested averages differs from the scalar version in one unit at most.
+void averageRow(const QRgb *top, const QRgb *bottom, QRgb *out,
+                const int width)
+{
+    int x = 0;
+#ifdef __SSE2__
+    for (; x + 2 <= width; x += 2) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + x * 2));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + x * 2));
+        const __m128i vertical = _mm_avg_epu8(a, b);
+        const __m128i even = _mm_shuffle_epi32(vertical, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128i odd = _mm_shuffle_epi32(vertical, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x),
+                         _mm_avg_epu8(even, odd));
+    }
+#endif
+    for (; x < width; ++x) {
+        const QRgb p[4] = { top[x * 2], top[x * 2 + 1],
+                            bottom[x * 2], bottom[x * 2 + 1] };
+        int channels[4] = { 0, 0, 0, 0 };
+        for (const QRgb c: p) {
+            channels[0] += qRed(c);
+            channels[1] += qGreen(c);
+            channels[2] += qBlue(c);
+            channels[3] += qAlpha(c);
+        }
+        out[x] = qRgba((channels[0] + 2) / 4, (channels[1] + 2) / 4,
+                       (channels[2] + 2) / 4, (channels[3] + 2) / 4);
+    }
+}
+
+} // unnamed namespace
+
+Mipmap::Mipmap(const QImage &image) {
+    // premultiplied pixels can be averaged without darkening the edges
+    QImage level = image.convertToFormat(image.hasAlphaChannel() ?
+            QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    m_levels.append(level);
+    while (level.width() >= MIN_LEVEL_SIZE * 2 ||
+           level.height() >= MIN_LEVEL_SIZE * 2)
+    {
+        level = halve(level);
+        if (level.isNull()) {
+            break;
+        }
+        m_levels.append(level);
+    }
+}
+
+// level returns the smallest level which is at least @minimumSize
+QImage Mipmap::level(const QSize &minimumSize) const {
+    for (int i = m_levels.size() - 1; i > 0; --i) {
+        const QImage &l = m_levels.at(i);
+        if (l.width() >= minimumSize.width() &&
+                l.height() >= minimumSize.height())
+        {
+            return l;
+        }
+    }
+    return m_levels.first();
+}
+
+QImage Mipmap::scaled(const QSize &size, const Qt::AspectRatioMode mode) const {
+    const QSize target = m_levels.first().size().scaled(size, mode);
+    return level(target).scaled(target, Qt::IgnoreAspectRatio,
+                                Qt::SmoothTransformation);
+}
+
+// halve applies a 2x2 box filter, an odd last row or column is dropped
+QImage Mipmap::halve(const QImage &image) {
+    const int width = image.width() / 2;
+    const int height = image.height() / 2;
+    if (width == 0 || height == 0) {
+        return QImage();
+    }
+    QImage res(width, height, image.format());
+    for (int y = 0; y < height; ++y) {
+        averageRow(reinterpret_cast<const QRgb *>(image.constScanLine(y * 2)),
+                   reinterpret_cast<const QRgb *>(image.constScanLine(y * 2 + 1)),
+                   reinterpret_cast<QRgb *>(res.scanLine(y)), width);
+    }
+    return res;
+}
+
+MipmapCache::MipmapCache() : m_cache(CACHE_KB) {
+
+}
+
+MipmapCache *MipmapCache::getInstance() {
+    static MipmapCache cache;
+    return &cache;
+}
+
+// mipmap returns the levels of the pixmap, the copies of a pixmap share
+// the same entry
+QSharedPointer<const Mipmap> MipmapCache::mipmap(const QPixmap &pixmap) {
+    const qint64 key = pixmap.cacheKey();
+    if (auto cached = m_cache.object(key)) {
+        return *cached;
+    }
+    QSharedPointer<const Mipmap> res(new Mipmap(pixmap.toImage()));
+    // the levels add a third of the size of the capture
+    const int cost = qMax(1, pixmap.width() * pixmap.height() * 4 / 3 / 256);
+    m_cache.insert(key, new QSharedPointer<const Mipmap>(res), cost);
+    return res;
+}
+
+QPixmap MipmapCache::scaled(const QPixmap &pixmap, const QSize &size,
+                            const Qt::AspectRatioMode mode)
+{
+    return QPixmap::fromImage(mipmap(pixmap)->scaled(size, mode));
+}
@@ -0,0 +1,58 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef MIPMAPCACHE_H
+#define MIPMAPCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QPixmap>
+#include <QSharedPointer>
+#include <QVector>
+
+class Mipmap
+{
+public:
+    explicit Mipmap(const QImage &image);
+
+    QImage level(const QSize &minimumSize) const;
+    QImage scaled(const QSize &size, const Qt::AspectRatioMode mode) const;
+
+    static QImage halve(const QImage &image);
+
+private:
+    QVector<QImage> m_levels;
+};
+
+class MipmapCache
+{
+public:
+    static MipmapCache* getInstance();
+
+    QSharedPointer<const Mipmap> mipmap(const QPixmap &pixmap);
+    QPixmap scaled(const QPixmap &pixmap, const QSize &size,
+                   const Qt::AspectRatioMode mode = Qt::KeepAspectRatio);
+
+private:
+    MipmapCache();
+
+    // the entries are shared pointers, a mipmap in use outlives its eviction
+    QCache<qint64, QSharedPointer<const Mipmap>> m_cache;
+};
+
+#endif // MIPMAPCACHE_H
@@ -0,0 +1,248 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "palettequantizer.h"
+#include <QHash>
+
+// PaletteQuantizer reduces an image to a palette of indexed colors. The
+// images with few colors, usual in the interfaces, keep their exact colors
+// and the others are reduced with median cut over a histogram of 15 bit
+// colors. The pixels with alpha 0 share a single transparent entry.
+
+namespace {
+
+const int LEVELS = 32;
+const int BINS = LEVELS * LEVELS * LEVELS;
+// key of the transparent pixels in the palette
+const QRgb TRANSPARENT = 0;
+
+inline int binOf(const QRgb c) {
+    return ((qRed(c) >> 3) << 10) | ((qGreen(c) >> 3) << 5) | (qBlue(c) >> 3);
+}
+
+inline int binAt(const int *v) {
+    return (v[0] << 10) | (v[1] << 5) | v[2];
+}
+
+// a box of the histogram, the bounds are included
+struct Box {
+    int lo[3];
+    int hi[3];
+    quint64 count;
+};
+
+// fit shrinks the box to its non empty bins and counts their pixels
+void fit(Box &box, const QVector<quint32> &histogram) {
+    int lo[3] = { LEVELS, LEVELS, LEVELS };
+    int hi[3] = { -1, -1, -1 };
+    quint64 count = 0;
+    int v[3];
+    for (v[0] = box.lo[0]; v[0] <= box.hi[0]; ++v[0]) {
+        for (v[1] = box.lo[1]; v[1] <= box.hi[1]; ++v[1]) {
+            for (v[2] = box.lo[2]; v[2] <= box.hi[2]; ++v[2]) {
+                const quint32 n = histogram.at(binAt(v));
+                if (n == 0) {
+                    continue;
+                }
+                count += n;
+                for (int k = 0; k < 3; ++k) {
+                    lo[k] = qMin(lo[k], v[k]);
+                    hi[k] = qMax(hi[k], v[k]);
+                }
+            }
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        box.lo[k] = lo[k];
+        box.hi[k] = hi[k];
+    }
+    box.count = count;
+}
+
+int longestAxis(const Box &box) {
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if (box.hi[k] - box.lo[k] > box.hi[axis] - box.lo[axis]) {
+            axis = k;
+        }
+    }
+    return axis;
+}
+
+// split cuts the box across its longest side at the median pixel, both
+// halves keep some pixels as the box fits its content
+void split(Box &box, Box &other, const QVector<quint32> &histogram) {
+    const int axis = longestAxis(box);
+    QVector<quint64> planes(LEVELS, 0);
+    int v[3];
+    for (v[0] = box.lo[0]; v[0] <= box.hi[0]; ++v[0]) {
+        for (v[1] = box.lo[1]; v[1] <= box.hi[1]; ++v[1]) {
+            for (v[2] = box.lo[2]; v[2] <= box.hi[2]; ++v[2]) {
+                planes[v[axis]] += histogram.at(binAt(v));
+            }
+        }
+    }
+    int cut = box.lo[axis];
+    quint64 sum = planes.at(cut);
+    while (cut < box.hi[axis] - 1 && sum * 2 < box.count) {
+        sum += planes.at(++cut);
+    }
+    other = box;
+    box.hi[axis] = cut;
+    other.lo[axis] = cut + 1;
+    fit(box, histogram);
+    fit(other, histogram);
+}
+
+} // unnamed namespace
+
+PaletteQuantizer::PaletteQuantizer(const int maxColors) :
+    m_maxColors(qBound(2, maxColors, 256))
+{
+
+}
+
+// quantize returns the palette index of every pixel, row after row, and
+// @transparentIndex is -1 when no pixel is transparent
+QByteArray PaletteQuantizer::quantize(const QImage &source,
+                                      QVector<QRgb> &palette,
+                                      int &transparentIndex) const
+{
+    const QImage image = source.convertToFormat(QImage::Format_ARGB32);
+    QByteArray indices;
+    palette.clear();
+    if (!exactColors(image, palette, indices)) {
+        QVector<quint32> histogram(BINS, 0);
+        QVector<quint64> sums(BINS * 3, 0);
+        bool transparent = false;
+        for (int y = 0; y < image.height(); ++y) {
+            auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                const QRgb c = line[x];
+                if (qAlpha(c) == 0) {
+                    transparent = true;
+                    continue;
+                }
+                const int bin = binOf(c);
+                ++histogram[bin];
+                sums[bin * 3] += qRed(c);
+                sums[bin * 3 + 1] += qGreen(c);
+                sums[bin * 3 + 2] += qBlue(c);
+            }
+        }
+
+        const int colors = m_maxColors - (transparent ? 1 : 0);
+        QVector<Box> boxes;
+        Box all = { { 0, 0, 0 }, { LEVELS - 1, LEVELS - 1, LEVELS - 1 }, 0 };
+        fit(all, histogram);
+        boxes.append(all);
+        while (boxes.size() < colors) {
+            // the most populated box along its longest side goes first
+            int best = -1;
+            quint64 bestPriority = 0;
+            for (int i = 0; i < boxes.size(); ++i) {
+                const Box &b = boxes.at(i);
+                const int axis = longestAxis(b);
+                const quint64 priority = b.count * (b.hi[axis] - b.lo[axis]);
+                if (priority > bestPriority) {
+                    best = i;
+                    bestPriority = priority;
+                }
+            }
+            if (best < 0) {
+                break;
+            }
+            Box other;
+            split(boxes[best], other, histogram);
+            boxes.append(other);
+        }
+
+        // every box is a palette entry with the mean color of its pixels
+        QVector<uchar> lookup(BINS, 0);
+        for (int i = 0; i < boxes.size(); ++i) {
+            const Box &b = boxes.at(i);
+            quint64 r = 0, g = 0, bl = 0;
+            int v[3];
+            for (v[0] = b.lo[0]; v[0] <= b.hi[0]; ++v[0]) {
+                for (v[1] = b.lo[1]; v[1] <= b.hi[1]; ++v[1]) {
+                    for (v[2] = b.lo[2]; v[2] <= b.hi[2]; ++v[2]) {
+                        const int bin = binAt(v);
+                        lookup[bin] = static_cast<uchar>(i);
+                        r += sums.at(bin * 3);
+                        g += sums.at(bin * 3 + 1);
+                        bl += sums.at(bin * 3 + 2);
+                    }
+                }
+            }
+            const quint64 n = qMax<quint64>(1, b.count);
+            palette.append(qRgb(r / n, g / n, bl / n));
+        }
+        const uchar transparentEntry = static_cast<uchar>(palette.size());
+        if (transparent) {
+            palette.append(TRANSPARENT);
+        }
+
+        indices.resize(image.width() * image.height());
+        uchar *out = reinterpret_cast<uchar *>(indices.data());
+        for (int y = 0; y < image.height(); ++y) {
+            auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                *out++ = qAlpha(line[x]) == 0 ?
+                            transparentEntry : lookup.at(binOf(line[x]));
+            }
+        }
+    }
+    transparentIndex = palette.indexOf(TRANSPARENT);
+    return indices;
+}
+
+// exactColors maps the pixels to their own colors, it fails when there are
+// too many of them
+bool PaletteQuantizer::exactColors(const QImage &image, QVector<QRgb> &palette,
+                                   QByteArray &indices) const
+{
+    QHash<QRgb, uchar> entries;
+    indices.resize(image.width() * image.height());
+    uchar *out = reinterpret_cast<uchar *>(indices.data());
+    // consecutive pixels often have the same color
+    QRgb last = 0;
+    uchar lastIndex = 0;
+    bool hasLast = false;
+    for (int y = 0; y < image.height(); ++y) {
+        auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            const QRgb c = qAlpha(line[x]) == 0 ? TRANSPARENT : line[x];
+            if (!hasLast || c != last) {
+                auto it = entries.constFind(c);
+                if (it == entries.constEnd()) {
+                    if (palette.size() == m_maxColors) {
+                        palette.clear();
+                        indices.clear();
+                        return false;
+                    }
+                    it = entries.insert(c, static_cast<uchar>(palette.size()));
+                    palette.append(c);
+                }
+                last = c;
+                lastIndex = it.value();
+                hasLast = true;
+            }
+            *out++ = lastIndex;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,40 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PALETTEQUANTIZER_H
+#define PALETTEQUANTIZER_H
+
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+
+class PaletteQuantizer
+{
+public:
+    explicit PaletteQuantizer(const int maxColors = 256);
+
+    QByteArray quantize(const QImage &image, QVector<QRgb> &palette,
+                        int &transparentIndex) const;
+
+private:
+    int m_maxColors;
+
+    bool exactColors(const QImage &image, QVector<QRgb> &palette,
+                     QByteArray &indices) const;
+};
+
+#endif // PALETTEQUANTIZER_H
@@ -0,0 +1,538 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "pngencoder.h"
+#include "src/utils/confighandler.h"
+#include <QtConcurrent>
+#include <QHash>
+#include <QSaveFile>
+#include <QBuffer>
+#include <zlib.h>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+// PngEncoder writes PNG files using every core. The rows are split in
+// chunks which are filtered in parallel and then deflated in parallel as
+// independent pieces of a single zlib stream, each one primed with the last
+// 32 KiB of the previous chunk as pigz does, so the compression ratio stays
+// close to a single threaded deflate. The exhaustive mode is meant for
+// background work instead: it runs in the calling thread and keeps the
+// smallest of every filter and deflate strategy over the whole image.
+
+namespace {
+
+// size of the filtered data deflated by every task
+const int CHUNK_BYTES = 256 * 1024;
+// deflate window, the dictionary taken from the previous chunk
+const int WINDOW_SIZE = 32 * 1024;
+// rows of 32 bit pixels in memory at once for writeStrips
+const int STRIP_BYTES = 32 * 1024 * 1024;
+const char PNG_SIGNATURE[] = "\x89PNG\r\n\x1a\n";
+// filter choice of every row, a fixed PNG filter type is used otherwise
+const int FILTER_ADAPTIVE = -1;
+const int FILTER_PAETH = 4;
+const int DEFAULT_MEM_LEVEL = 8;
+const int MAX_MEM_LEVEL = 9;
+
+struct Chunk {
+    int index;
+    int firstRow;
+    int rows;
+    QByteArray filtered;
+    QByteArray compressed;
+    uLong adler;
+};
+
+// zlibHeader returns the header of the stream, the level only changes the
+// informative FLEVEL bits
+QByteArray zlibHeader(const int level) {
+    const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    const int cmf = 0x78;
+    int flg = flevel << 6;
+    flg += 31 - ((cmf * 256 + flg) % 31);
+    QByteArray res;
+    res.append(static_cast<char>(cmf));
+    res.append(static_cast<char>(flg));
+    return res;
+}
+
+void appendUInt32(QByteArray &out, const quint32 value) {
+    out.append(static_cast<char>((value >> 24) & 0xff));
+    out.append(static_cast<char>((value >> 16) & 0xff));
+    out.append(static_cast<char>((value >> 8) & 0xff));
+    out.append(static_cast<char>(value & 0xff));
+}
+
+bool writePngChunk(QIODevice *device, const char *type, const QByteArray &data) {
+    QByteArray header;
+    appendUInt32(header, data.size());
+    header.append(type, 4);
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef *>(type), 4);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(data.constData()),
+                data.size());
+    QByteArray footer;
+    appendUInt32(footer, crc);
+    return device->write(header) == header.size() &&
+            device->write(data) == data.size() &&
+            device->write(footer) == footer.size();
+}
+
+// rawRow converts a row of 32 bit pixels to the RGB or RGBA bytes of PNG,
+// or to palette indices when @indices is set
+void rawRow(const QImage &image, const int y, const int bpp,
+            const QHash<QRgb, uchar> *indices, uchar *out)
+{
+    auto line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+    if (indices) {
+        // runs of the same color are common, the lookup is skipped for them
+        QRgb last = line[0];
+        uchar index = indices->value(last);
+        for (int x = 0; x < image.width(); ++x) {
+            if (line[x] != last) {
+                last = line[x];
+                index = indices->value(last);
+            }
+            *out++ = index;
+        }
+        return;
+    }
+    for (int x = 0; x < image.width(); ++x) {
+        const QRgb p = line[x];
+        *out++ = qRed(p);
+        *out++ = qGreen(p);
+        *out++ = qBlue(p);
+        if (bpp == 4) {
+            *out++ = qAlpha(p);
+        }
+    }
+}
+
+inline uchar paeth(const int a, const int b, const int c) {
+    const int p = a + b - c;
+    const int pa = std::abs(p - a);
+    const int pb = std::abs(p - b);
+    const int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// filterRow writes the filter type and the filtered row, the adaptive
+// filter chooses the one with the lowest sum of absolute values as libpng
+// does
+void filterRow(const uchar *row, const uchar *prev, const int length,
+               const int bpp, const int filter, uchar *candidates,
+               uchar *out)
+{
+    int best = qMax(0, filter);
+    long bestSum = -1;
+    const int first = filter == FILTER_ADAPTIVE ? 0 : filter;
+    const int last = filter == FILTER_ADAPTIVE ? FILTER_PAETH : filter;
+    for (int type = first; type <= last; ++type) {
+        uchar *f = candidates + type * length;
+        long sum = 0;
+        for (int i = 0; i < length; ++i) {
+            const int a = i >= bpp ? row[i - bpp] : 0;
+            const int b = prev[i];
+            const int c = i >= bpp ? prev[i - bpp] : 0;
+            uchar v;
+            switch (type) {
+            case 0: v = row[i]; break;
+            case 1: v = row[i] - a; break;
+            case 2: v = row[i] - b; break;
+            case 3: v = row[i] - ((a + b) >> 1); break;
+            default: v = row[i] - paeth(a, b, c); break;
+            }
+            f[i] = v;
+            sum += v < 128 ? v : 256 - v;
+        }
+        if (bestSum < 0 || sum < bestSum) {
+            bestSum = sum;
+            best = type;
+        }
+    }
+    out[0] = static_cast<uchar>(best);
+    std::memcpy(out + 1, candidates + best * length, length);
+}
+
+void filterChunk(const QImage &image, const int bpp, const int filter,
+                 const QHash<QRgb, uchar> *indices, Chunk &chunk)
+{
+    const int length = image.width() * bpp;
+    QVector<uchar> prev(length, 0), row(length), candidates(length * 5);
+    if (chunk.firstRow > 0) {
+        rawRow(image, chunk.firstRow - 1, bpp, indices, prev.data());
+    }
+    chunk.filtered.resize(chunk.rows * (length + 1));
+    uchar *out = reinterpret_cast<uchar *>(chunk.filtered.data());
+    for (int y = chunk.firstRow; y < chunk.firstRow + chunk.rows; ++y) {
+        rawRow(image, y, bpp, indices, row.data());
+        filterRow(row.constData(), prev.constData(), length, bpp, filter,
+                  candidates.data(), out);
+        out += length + 1;
+        std::swap(prev, row);
+    }
+    chunk.adler = adler32(adler32(0L, Z_NULL, 0),
+                          reinterpret_cast<const Bytef *>(chunk.filtered.constData()),
+                          chunk.filtered.size());
+}
+
+// deflateChunk compresses the chunk as raw deflate blocks, all but the
+// last one end with a sync flush so they can be concatenated
+bool deflateChunk(const QVector<Chunk> &chunks, const int level,
+                  const int memLevel, const int strategy, const bool finish,
+                  Chunk &chunk)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, memLevel,
+                     strategy) != Z_OK)
+    {
+        return false;
+    }
+    if (chunk.index > 0) {
+        const QByteArray &previous = chunks.at(chunk.index - 1).filtered;
+        const int dictLength = qMin(WINDOW_SIZE, previous.size());
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(
+                                 previous.constData() + previous.size() - dictLength),
+                             dictLength);
+    }
+    const bool last = finish && chunk.index == chunks.size() - 1;
+    const int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    stream.next_in = reinterpret_cast<Bytef *>(chunk.filtered.data());
+    stream.avail_in = chunk.filtered.size();
+    chunk.compressed.resize(deflateBound(&stream, chunk.filtered.size()) + 64);
+    stream.next_out = reinterpret_cast<Bytef *>(chunk.compressed.data());
+    stream.avail_out = chunk.compressed.size();
+
+    bool ok = true;
+    forever {
+        int ret = deflate(&stream, flush);
+        if (ret == Z_STREAM_END || (!last && ret == Z_OK && stream.avail_out > 0)) {
+            break;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            ok = false;
+            break;
+        }
+        const int used = stream.total_out;
+        chunk.compressed.resize(chunk.compressed.size() * 2);
+        stream.next_out = reinterpret_cast<Bytef *>(chunk.compressed.data() + used);
+        stream.avail_out = chunk.compressed.size() - used;
+    }
+    chunk.compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ok;
+}
+
+// compressChunks filters and deflates the chunks in parallel. Palette
+// indices aren't filtered, the differences between them mean nothing.
+// The rows before @firstRow are only read by the filters, and without
+// @finish the stream is left open for more rows.
+bool compressChunks(const QImage &image, const int bpp,
+                    const QHash<QRgb, uchar> *indices, const int level,
+                    QVector<Chunk> &chunks, const int firstRow = 0,
+                    const bool finish = true)
+{
+    const int rowBytes = image.width() * bpp + 1;
+    const int rowsPerChunk = qMax(1, CHUNK_BYTES / rowBytes);
+    for (int y = firstRow; y < image.height(); y += rowsPerChunk) {
+        chunks.append({ chunks.size(), y, qMin(rowsPerChunk, image.height() - y),
+                        QByteArray(), QByteArray(), 0 });
+    }
+
+    const int filter = indices ? 0 : FILTER_ADAPTIVE;
+    QtConcurrent::blockingMap(chunks, [&image, bpp, filter, indices](Chunk &chunk) {
+        filterChunk(image, bpp, filter, indices, chunk);
+    });
+    QAtomicInt failed(0);
+    const QVector<Chunk> &filtered = chunks;
+    QtConcurrent::blockingMap(chunks, [&filtered, level, finish,
+                              &failed](Chunk &chunk) {
+        if (!deflateChunk(filtered, level, DEFAULT_MEM_LEVEL,
+                          Z_DEFAULT_STRATEGY, finish, chunk))
+        {
+            failed.store(1);
+        }
+    });
+    return !failed.load();
+}
+
+// smallestChunk tries every filter with every deflate strategy on the
+// whole image as a single chunk. Palette indices are also tried filtered,
+// the differences between them mean nothing but sometimes they repeat.
+bool smallestChunk(const QImage &image, const int bpp,
+                   const QHash<QRgb, uchar> *indices,
+                   const QAtomicInt *cancelled, Chunk &best)
+{
+    const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_RLE };
+    bool found = false;
+    for (int filter = FILTER_ADAPTIVE; filter <= FILTER_PAETH; ++filter) {
+        QVector<Chunk> chunks;
+        chunks.append({ 0, 0, image.height(), QByteArray(), QByteArray(), 0 });
+        filterChunk(image, bpp, filter, indices, chunks[0]);
+        for (const int strategy: strategies) {
+            if (cancelled && cancelled->load()) {
+                return false;
+            }
+            Chunk candidate = chunks.at(0);
+            if (!deflateChunk(chunks, Z_BEST_COMPRESSION, MAX_MEM_LEVEL,
+                              strategy, true, candidate))
+            {
+                return false;
+            }
+            if (!found || candidate.compressed.size() < best.compressed.size()) {
+                best = candidate;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+} // unnamed namespace
+
+PngEncoder::PngEncoder() :
+    m_compressionLevel(ConfigHandler().pngCompressionLevelValue()),
+    m_exhaustive(false), m_cancelled(nullptr)
+{
+
+}
+
+PngEncoder::PngEncoder(const int compressionLevel) :
+    m_compressionLevel(qBound(0, compressionLevel, 9)), m_exhaustive(false),
+    m_cancelled(nullptr)
+{
+
+}
+
+int PngEncoder::compressionLevel() const {
+    return m_compressionLevel;
+}
+
+// setPalette makes write produce an indexed PNG, the palette must contain
+// every color of the image, 256 at most
+void PngEncoder::setPalette(const QVector<QRgb> &palette) {
+    m_palette = palette.mid(0, 256);
+}
+
+QVector<QRgb> PngEncoder::palette() const {
+    return m_palette;
+}
+
+// setExhaustive trades a lot of time for the smallest file, the
+// compression level is ignored then
+void PngEncoder::setExhaustive(const bool exhaustive) {
+    m_exhaustive = exhaustive;
+}
+
+bool PngEncoder::isExhaustive() const {
+    return m_exhaustive;
+}
+
+// setCancelFlag makes an exhaustive write fail as soon as the flag is set,
+// it is checked between the attempts
+void PngEncoder::setCancelFlag(const QAtomicInt *cancelled) {
+    m_cancelled = cancelled;
+}
+
+bool PngEncoder::write(const QImage &source, QIODevice *device) const {
+    if (source.isNull()) {
+        return false;
+    }
+    const bool alpha = source.hasAlphaChannel();
+    const QImage image = source.convertToFormat(alpha ?
+            QImage::Format_ARGB32 : QImage::Format_RGB32);
+    const bool indexed = !m_palette.isEmpty();
+    const int bpp = indexed ? 1 : alpha ? 4 : 3;
+    QHash<QRgb, uchar> paletteIndices;
+    for (int i = 0; i < m_palette.size(); ++i) {
+        paletteIndices.insert(m_palette.at(i), static_cast<uchar>(i));
+    }
+    const QHash<QRgb, uchar> *indices = indexed ? &paletteIndices : nullptr;
+
+    QVector<Chunk> chunks;
+    if (m_exhaustive) {
+        Chunk best;
+        if (!smallestChunk(image, bpp, indices, m_cancelled, best)) {
+            return false;
+        }
+        chunks.append(best);
+    } else if (!compressChunks(image, bpp, indices, m_compressionLevel,
+                               chunks))
+    {
+        return false;
+    }
+
+    QByteArray header;
+    appendUInt32(header, image.width());
+    appendUInt32(header, image.height());
+    header.append(static_cast<char>(8));
+    header.append(static_cast<char>(indexed ? 3 : alpha ? 6 : 2));
+    header.append(3, static_cast<char>(0));
+
+    const int level = m_exhaustive ? Z_BEST_COMPRESSION : m_compressionLevel;
+
+    uLong adler = adler32(0L, Z_NULL, 0);
+    bool ok = device->write(PNG_SIGNATURE, 8) == 8 &&
+            writePngChunk(device, "IHDR", header);
+    if (ok && indexed) {
+        QByteArray plte, trns;
+        int lastTranslucent = -1;
+        for (int i = 0; i < m_palette.size(); ++i) {
+            const QRgb c = m_palette.at(i);
+            plte.append(static_cast<char>(qRed(c)));
+            plte.append(static_cast<char>(qGreen(c)));
+            plte.append(static_cast<char>(qBlue(c)));
+            trns.append(static_cast<char>(alpha ? qAlpha(c) : 255));
+            if (alpha && qAlpha(c) != 255) {
+                lastTranslucent = i;
+            }
+        }
+        ok = writePngChunk(device, "PLTE", plte);
+        // the entries after the last translucent one are opaque by default
+        if (ok && lastTranslucent >= 0) {
+            ok = writePngChunk(device, "tRNS", trns.left(lastTranslucent + 1));
+        }
+    }
+    for (int i = 0; ok && i < chunks.size(); ++i) {
+        const Chunk &chunk = chunks.at(i);
+        adler = adler32_combine(adler, chunk.adler, chunk.filtered.size());
+        QByteArray data;
+        if (i == 0) {
+            data.append(zlibHeader(level));
+        }
+        data.append(chunk.compressed);
+        if (i == chunks.size() - 1) {
+            appendUInt32(data, adler);
+        }
+        ok = writePngChunk(device, "IDAT", data);
+    }
+    return ok && writePngChunk(device, "IEND", QByteArray());
+}
+
+// save writes the file atomically, a failed save doesn't leave a
+// truncated image
+bool PngEncoder::save(const QImage &image, const QString &path) const {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    if (!write(image, &file)) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+// writeStrips writes an opaque image which doesn't fit in memory. @strip
+// is called in order with the first row and the number of rows wanted, it
+// must return them preceded by the row before the first one, which the
+// filters need, except for the first strip. Each strip is compressed in
+// parallel as write does and the zlib stream continues over the strips.
+bool PngEncoder::writeStrips(const QSize &size, const StripSource &strip,
+                             QIODevice *device) const
+{
+    if (size.isEmpty()) {
+        return false;
+    }
+    QByteArray header;
+    appendUInt32(header, size.width());
+    appendUInt32(header, size.height());
+    header.append(static_cast<char>(8));
+    header.append(static_cast<char>(2));
+    header.append(3, static_cast<char>(0));
+    if (device->write(PNG_SIGNATURE, 8) != 8 ||
+            !writePngChunk(device, "IHDR", header))
+    {
+        return false;
+    }
+
+    const int rowsPerStrip = qMax(1, STRIP_BYTES / (size.width() * 4));
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (int y = 0; y < size.height(); y += rowsPerStrip) {
+        const int rows = qMin(rowsPerStrip, size.height() - y);
+        const int firstRow = y > 0 ? 1 : 0;
+        QImage image = strip(y, rows);
+        if (image.format() != QImage::Format_RGB32) {
+            image = image.convertToFormat(QImage::Format_RGB32);
+        }
+        if (image.width() != size.width() ||
+                image.height() != rows + firstRow)
+        {
+            return false;
+        }
+        const bool finish = y + rows == size.height();
+        QVector<Chunk> chunks;
+        if (!compressChunks(image, 3, nullptr, m_compressionLevel, chunks,
+                            firstRow, finish))
+        {
+            return false;
+        }
+        for (int i = 0; i < chunks.size(); ++i) {
+            const Chunk &chunk = chunks.at(i);
+            adler = adler32_combine(adler, chunk.adler, chunk.filtered.size());
+            QByteArray data;
+            if (y == 0 && i == 0) {
+                data.append(zlibHeader(m_compressionLevel));
+            }
+            data.append(chunk.compressed);
+            if (finish && i == chunks.size() - 1) {
+                appendUInt32(data, adler);
+            }
+            if (!writePngChunk(device, "IDAT", data)) {
+                return false;
+            }
+        }
+    }
+    return writePngChunk(device, "IEND", QByteArray());
+}
+
+// imageData returns the zlib stream of the rows, the content of the IDAT
+// chunks, for the formats which embed it such as APNG. The palette isn't
+// used.
+QByteArray PngEncoder::imageData(const QImage &source) const {
+    const bool alpha = source.hasAlphaChannel();
+    const QImage image = source.convertToFormat(alpha ?
+            QImage::Format_ARGB32 : QImage::Format_RGB32);
+    QVector<Chunk> chunks;
+    if (image.isNull() || !compressChunks(image, alpha ? 4 : 3, nullptr,
+                                          m_compressionLevel, chunks))
+    {
+        return QByteArray();
+    }
+    QByteArray res = zlibHeader(m_compressionLevel);
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (const Chunk &chunk: chunks) {
+        adler = adler32_combine(adler, chunk.adler, chunk.filtered.size());
+        res.append(chunk.compressed);
+    }
+    appendUInt32(res, adler);
+    return res;
+}
+
+QByteArray PngEncoder::encode(const QImage &image) const {
+    QByteArray res;
+    QBuffer buffer(&res);
+    buffer.open(QIODevice::WriteOnly);
+    if (!write(image, &buffer)) {
+        res.clear();
+    }
+    return res;
+}
@@ -0,0 +1,57 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <QImage>
+#include <QVector>
+#include <QAtomicInt>
+#include <functional>
+
+class QIODevice;
+
+class PngEncoder
+{
+public:
+    using StripSource = std::function<QImage(const int first, const int rows)>;
+
+    PngEncoder();
+    explicit PngEncoder(const int compressionLevel);
+
+    int compressionLevel() const;
+    void setPalette(const QVector<QRgb> &palette);
+    QVector<QRgb> palette() const;
+    void setExhaustive(const bool exhaustive);
+    bool isExhaustive() const;
+    void setCancelFlag(const QAtomicInt *cancelled);
+
+    bool write(const QImage &image, QIODevice *device) const;
+    bool save(const QImage &image, const QString &path) const;
+    QByteArray encode(const QImage &image) const;
+    QByteArray imageData(const QImage &image) const;
+    bool writeStrips(const QSize &size, const StripSource &strip,
+                     QIODevice *device) const;
+
+private:
+    int m_compressionLevel;
+    QVector<QRgb> m_palette;
+    bool m_exhaustive;
+    const QAtomicInt *m_cancelled;
+};
+
+#endif // PNGENCODER_H
@@ -0,0 +1,291 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "savequeue.h"
+#include "src/utils/confighandler.h"
+#include "src/utils/systemnotification.h"
+#include "src/utils/dedupindex.h"
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QFileInfo>
+#include <QFile>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+
+// SaveQueue writes the captures in a background thread so a slow disk
+// doesn't freeze the interface. Every file is written with a temporary name
+// next to its final path, synced as the config says and renamed in place,
+// a crash never leaves a truncated image with the final name. Captures with
+// the same pixels as a saved one are linked to it or skipped, and similar
+// ones are reported.
+
+namespace {
+
+const int MEGABYTE = 1024 * 1024;
+// memory of the queued images, enqueue blocks when it is exhausted
+const int BUDGET_MB = 256;
+// differing bits of the perceptual hashes of two similar captures
+const int SIMILAR_DISTANCE = 4;
+
+// withoutSuffix removes the extension of the file name, the names of the
+// captures differ before it
+QString withoutSuffix(const QString &path) {
+    const int dot = path.lastIndexOf('.');
+    return dot > path.lastIndexOf('/') ? path.left(dot) : path;
+}
+
+// finalPath gives the reserved path the suffix of the chosen encoding, a
+// file already saved with that suffix isn't overwritten
+QString finalPath(const QString &reservedPath, const QString &suffix) {
+    if (reservedPath.endsWith(suffix)) {
+        return reservedPath;
+    }
+    const QString base = withoutSuffix(reservedPath);
+    QString path = base + suffix;
+    for (int n = 1; QFileInfo(path).exists(); ++n) {
+        path = QString("%1_%2%3").arg(base).arg(n).arg(suffix);
+    }
+    return path;
+}
+
+class SaveJob : public QRunnable
+{
+public:
+    SaveJob(SaveQueue *queue, QSemaphore *budget, const int cost,
+            const QSharedPointer<ExportPipeline> &capture, const QString &path,
+            const EncoderSelector::Choice &choice, const bool choose,
+            const SaveQueue::SyncPolicy policy,
+            const SaveQueue::DuplicatePolicy duplicates) :
+        m_queue(queue), m_budget(budget), m_cost(cost), m_capture(capture),
+        m_reservedPath(path), m_path(path), m_savedPath(path),
+        m_choice(choice), m_choose(choose), m_policy(policy),
+        m_duplicates(duplicates)
+    {
+    }
+
+    void run() override {
+        QElapsedTimer timer;
+        timer.start();
+        // the histogram of the choice isn't computed in the GUI thread
+        if (m_choose) {
+            m_choice = m_capture->choice(true);
+            m_path = finalPath(m_reservedPath, m_choice.suffix);
+            m_savedPath = m_path;
+        }
+        bool ok = save();
+        m_capture->addTiming("save", timer.elapsed());
+        // the capture isn't needed anymore
+        m_capture.clear();
+        m_budget->release(m_cost);
+        QMetaObject::invokeMethod(m_queue, "handleJobDone",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, m_reservedPath),
+                                  Q_ARG(QString, m_path),
+                                  Q_ARG(QString, m_savedPath),
+                                  Q_ARG(bool, ok),
+                                  Q_ARG(QString, m_reasons.join(", ")));
+    }
+
+private:
+    SaveQueue *m_queue;
+    QSemaphore *m_budget;
+    int m_cost;
+    QSharedPointer<ExportPipeline> m_capture;
+    // path given to the queue, its suffix may change with the encoding
+    QString m_reservedPath;
+    QString m_path;
+    // path of the capture once saved, a skipped duplicate keeps the old one
+    QString m_savedPath;
+    EncoderSelector::Choice m_choice;
+    // the encoding is chosen by the job
+    bool m_choose;
+    SaveQueue::SyncPolicy m_policy;
+    SaveQueue::DuplicatePolicy m_duplicates;
+    QStringList m_reasons;
+
+    bool save() {
+        DedupIndex *index = DedupIndex::getInstance();
+        const DedupIndex::CaptureHash hash =
+                DedupIndex::hashImage(m_capture->image());
+        QString identical = index->findIdentical(hash);
+        // the old file could be gone or have another format
+        if (!identical.isEmpty() &&
+                (!QFileInfo(identical).exists() ||
+                 QFileInfo(identical).suffix() != QFileInfo(m_path).suffix()))
+        {
+            identical.clear();
+        }
+        if (!identical.isEmpty() &&
+                m_duplicates == SaveQueue::DUPLICATES_SKIP)
+        {
+            m_savedPath = identical;
+            m_reasons << QObject::tr("identical to a saved capture");
+            return true;
+        }
+        if (!identical.isEmpty() &&
+                m_duplicates == SaveQueue::DUPLICATES_LINK &&
+                ::link(QFile::encodeName(identical).constData(),
+                       QFile::encodeName(m_path).constData()) == 0)
+        {
+            m_reasons << QObject::tr("hard link to %1").arg(identical);
+            return true;
+        }
+        // links fail across filesystems, a copy is written then
+        const QString similar = identical.isEmpty() ?
+                    index->findSimilar(hash, SIMILAR_DISTANCE) : QString();
+        if (!write()) {
+            return false;
+        }
+        index->insert(hash, m_path);
+        if (!m_choice.reason.isEmpty()) {
+            m_reasons << m_choice.reason;
+        }
+        if (!identical.isEmpty()) {
+            m_reasons << QObject::tr("identical to %1").arg(identical);
+        } else if (!similar.isEmpty()) {
+            m_reasons << QObject::tr("similar to %1").arg(similar);
+        }
+        return true;
+    }
+
+    bool write() {
+        const QString tempPath = m_path + ".part";
+        QFile file(tempPath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return false;
+        }
+        // the encoding is shared with the other destinations of the capture
+        const ExportPipeline::Encoded encoded =
+                m_capture->encoding(m_choice).result();
+        if (!encoded.reason.isEmpty()) {
+            m_choice.reason = encoded.reason;
+        }
+        bool ok = !encoded.data.isEmpty() &&
+                file.write(encoded.data) == encoded.data.size() &&
+                file.flush();
+        if (ok && m_policy != SaveQueue::SYNC_NONE) {
+            ok = ::fsync(file.handle()) == 0;
+        }
+        file.close();
+        if (ok) {
+            // unlike QFile::rename it replaces the destination atomically
+            ok = std::rename(QFile::encodeName(tempPath).constData(),
+                             QFile::encodeName(m_path).constData()) == 0;
+        }
+        if (!ok) {
+            QFile::remove(tempPath);
+            return false;
+        }
+        if (m_policy == SaveQueue::SYNC_FULL) {
+            const QByteArray dir =
+                    QFile::encodeName(QFileInfo(m_path).absolutePath());
+            int fd = ::open(dir.constData(), O_RDONLY | O_DIRECTORY);
+            if (fd >= 0) {
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+        return true;
+    }
+};
+
+} // unnamed namespace
+
+SaveQueue::SaveQueue(QObject *parent) : QObject(parent), m_budget(BUDGET_MB) {
+    // a single writer keeps the order of the saves and doesn't compete for
+    // the disk, the encoder already uses every core
+    m_pool.setMaxThreadCount(1);
+    connect(qApp, &QCoreApplication::aboutToQuit,
+            this, &SaveQueue::waitForDone);
+}
+
+SaveQueue *SaveQueue::getInstance() {
+    static SaveQueue q;
+    return &q;
+}
+
+// enqueue returns once the image is queued, it only waits when the queued
+// images exceed the memory budget
+void SaveQueue::enqueue(const QSharedPointer<ExportPipeline> &capture,
+                        const QString &path,
+                        const EncoderSelector::Choice &choice)
+{
+    start(capture, path, choice, false);
+}
+
+// this enqueue lets the writer choose the encoding, the suffix of @path is
+// replaced by the one of the encoding
+void SaveQueue::enqueue(const QSharedPointer<ExportPipeline> &capture,
+                        const QString &path)
+{
+    start(capture, path, EncoderSelector::Choice(), true);
+}
+
+void SaveQueue::start(const QSharedPointer<ExportPipeline> &capture,
+                      const QString &path,
+                      const EncoderSelector::Choice &choice, const bool choose)
+{
+    const int cost = qBound(1, capture->image().byteCount() / MEGABYTE + 1,
+                            BUDGET_MB);
+    m_budget.acquire(cost);
+    m_pending.insert(withoutSuffix(path));
+    ConfigHandler config;
+    auto policy = static_cast<SyncPolicy>(config.saveSyncPolicyValue());
+    auto duplicates =
+            static_cast<DuplicatePolicy>(config.duplicateActionValue());
+    m_pool.start(new SaveJob(this, &m_budget, cost, capture, path, choice,
+                             choose, policy, duplicates));
+}
+
+// isPending tells if a file is queued but not written yet, its name
+// can't be used by another capture whatever its suffix
+bool SaveQueue::isPending(const QString &path) const {
+    return m_pending.contains(withoutSuffix(path));
+}
+
+// handleJobDone gets the reserved path, the one of the written file and
+// the one of the saved capture, the last ones only differ for a skipped
+// duplicate
+void SaveQueue::handleJobDone(const QString &reservedPath, const QString &path,
+                              const QString &savedPath, const bool ok,
+                              const QString &reason)
+{
+    m_pending.remove(withoutSuffix(reservedPath));
+    QString saveMessage;
+    if (ok) {
+        ConfigHandler config;
+        config.setSavePath(QFileInfo(path).absolutePath());
+        config.setLastCapturePath(savedPath);
+        saveMessage = QObject::tr("Capture saved as ") + savedPath;
+        if (!reason.isEmpty()) {
+            saveMessage += " (" + reason + ")";
+        }
+        Q_EMIT saved(savedPath);
+    } else {
+        saveMessage = QObject::tr("Error trying to save as ") + path;
+        Q_EMIT saveFailed(path);
+    }
+    SystemNotification().sendMessage(saveMessage);
+}
+
+void SaveQueue::waitForDone() {
+    m_pool.waitForDone();
+}
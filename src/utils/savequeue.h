@@ -0,0 +1,77 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SAVEQUEUE_H
+#define SAVEQUEUE_H
+
+#include "src/core/exportpipeline.h"
+#include <QObject>
+#include <QSharedPointer>
+#include <QSet>
+#include <QThreadPool>
+#include <QSemaphore>
+
+class SaveQueue : public QObject
+{
+    Q_OBJECT
+public:
+    enum SyncPolicy {
+        SYNC_NONE, // leave the flush to the kernel
+        SYNC_FILE, // fsync the file before renaming it
+        SYNC_FULL, // also fsync the directory after the rename
+    };
+
+    // what to do with a capture identical to a saved one
+    enum DuplicatePolicy {
+        DUPLICATES_KEEP,
+        DUPLICATES_LINK,
+        DUPLICATES_SKIP,
+    };
+
+    static SaveQueue* getInstance();
+
+    void enqueue(const QSharedPointer<ExportPipeline> &capture,
+                 const QString &path, const EncoderSelector::Choice &choice);
+    void enqueue(const QSharedPointer<ExportPipeline> &capture,
+                 const QString &path);
+    bool isPending(const QString &path) const;
+
+signals:
+    void saved(const QString &path);
+    void saveFailed(const QString &path);
+
+private slots:
+    void handleJobDone(const QString &reservedPath, const QString &path,
+                       const QString &savedPath, const bool ok,
+                       const QString &reason);
+    void waitForDone();
+
+private:
+    explicit SaveQueue(QObject *parent = nullptr);
+
+    QThreadPool m_pool;
+    QSemaphore m_budget;
+    // queued paths without their suffix
+    QSet<QString> m_pending;
+
+    void start(const QSharedPointer<ExportPipeline> &capture,
+               const QString &path, const EncoderSelector::Choice &choice,
+               const bool choose);
+};
+
+#endif // SAVEQUEUE_H
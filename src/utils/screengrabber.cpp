@@ -63,3 +63,26 @@ QPixmap ScreenGrabber::grabEntireDesktop(bool &ok) {
     p.setDevicePixelRatio(QApplication::desktop()->devicePixelRatio());
     return p;
 }
+
+// grabArea reads only the pixels of @area, in the logical coordinates of
+// the desktop, instead of the whole desktop
+QPixmap ScreenGrabber::grabArea(const QRect &area, bool &ok) {
+    ok = !m_info.waylandDectected();
+    if (!ok) {
+        return QPixmap();
+    }
+    QRect geometry;
+    for (QScreen *const screen : QGuiApplication::screens()) {
+        geometry = geometry.united(screen->geometry());
+    }
+    const QRect r = area.intersected(geometry);
+    if (r.isEmpty()) {
+        ok = false;
+        return QPixmap();
+    }
+    QPixmap p(QApplication::primaryScreen()->grabWindow(
+                  QApplication::desktop()->winId(),
+                  r.x(), r.y(), r.width(), r.height()));
+    p.setDevicePixelRatio(QApplication::desktop()->devicePixelRatio());
+    return p;
+}
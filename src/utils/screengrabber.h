@@ -27,6 +27,7 @@ class ScreenGrabber : public QObject
 public:
     explicit ScreenGrabber(QObject *parent = nullptr);
     QPixmap grabEntireDesktop(bool &ok);
+    QPixmap grabArea(const QRect &area, bool &ok);
 
 private:
     DesktopInfo m_info;
@@ -0,0 +1,109 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "tilehasher.h"
+#include <QtConcurrent>
+#include <cstring>
+
+// TileHasher splits an image in square tiles and computes a 64 bit hash of
+// each one, equal hashes let us skip identical areas without comparing
+// their pixels.
+
+namespace {
+
+const quint64 FNV_OFFSET = 14695981039346656037ULL;
+const quint64 FNV_PRIME = 1099511628211ULL;
+
+} // unnamed namespace
+
+TileHasher::TileHasher(const int tileSize) : m_tileSize(tileSize) {
+
+}
+
+int TileHasher::tileSize() const {
+    return m_tileSize;
+}
+
+int TileHasher::columns(const QSize &imageSize) const {
+    return (imageSize.width() + m_tileSize - 1) / m_tileSize;
+}
+
+int TileHasher::rows(const QSize &imageSize) const {
+    return (imageSize.height() + m_tileSize - 1) / m_tileSize;
+}
+
+QRect TileHasher::tileRect(const int index, const QSize &imageSize) const {
+    int c = columns(imageSize);
+    QRect r((index % c) * m_tileSize, (index / c) * m_tileSize,
+            m_tileSize, m_tileSize);
+    return r.intersected(QRect(QPoint(0, 0), imageSize));
+}
+
+// hashTiles returns the hashes in row-major order, the rows of tiles are
+// hashed in parallel and every thread reads the image sequentially
+QVector<quint64> TileHasher::hashTiles(const QImage &image) const {
+    QImage img = image;
+    if (img.depth() != 32) {
+        img = img.convertToFormat(QImage::Format_RGB32);
+    }
+    const int c = columns(img.size());
+    const int r = rows(img.size());
+    QVector<quint64> res(c * r, FNV_OFFSET);
+    quint64 *hashes = res.data();
+
+    QVector<int> tileRows(r);
+    for (int i = 0; i < r; ++i) {
+        tileRows[i] = i;
+    }
+    const int tileSize = m_tileSize;
+    auto hashRow = [&img, hashes, c, tileSize](const int row) {
+        quint64 *rowHashes = hashes + row * c;
+        const int end = qMin((row + 1) * tileSize, img.height());
+        for (int y = row * tileSize; y < end; ++y) {
+            const uchar *line = img.constScanLine(y);
+            for (int column = 0; column < c; ++column) {
+                int x = column * tileSize;
+                int width = qMin(tileSize, img.width() - x);
+                rowHashes[column] = hashBytes(line + x * 4, width * 4,
+                                              rowHashes[column]);
+            }
+        }
+    };
+    QtConcurrent::blockingMap(tileRows, hashRow);
+    return res;
+}
+
+// hashBytes is a FNV-1a variant which consumes 8 bytes per step
+quint64 TileHasher::hashBytes(const uchar *data, const int length,
+                              quint64 seed)
+{
+    quint64 h = seed;
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        quint64 word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * FNV_PRIME;
+    }
+    for (; i < length; ++i) {
+        h = (h ^ data[i]) * FNV_PRIME;
+    }
+    return h ^ (h >> 29);
+}
+
+quint64 TileHasher::initialHash() {
+    return FNV_OFFSET;
+}
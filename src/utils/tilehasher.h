@@ -0,0 +1,44 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TILEHASHER_H
+#define TILEHASHER_H
+
+#include <QImage>
+#include <QVector>
+
+class TileHasher
+{
+public:
+    explicit TileHasher(const int tileSize = 32);
+
+    int tileSize() const;
+    int columns(const QSize &imageSize) const;
+    int rows(const QSize &imageSize) const;
+    QRect tileRect(const int index, const QSize &imageSize) const;
+
+    QVector<quint64> hashTiles(const QImage &image) const;
+
+    static quint64 hashBytes(const uchar *data, const int length,
+                             quint64 seed = initialHash());
+    static quint64 initialHash();
+
+private:
+    int m_tileSize;
+};
+
+#endif // TILEHASHER_H
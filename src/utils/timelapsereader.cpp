@@ -0,0 +1,211 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "timelapsereader.h"
+#include "src/utils/timelapsewriter.h"
+#include "src/utils/tilehasher.h"
+#include "src/utils/pngencoder.h"
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
+#include <cstring>
+
+// TimelapseReader rebuilds the frames written by TimelapseWriter, applying
+// every delta on a copy of the previous frame.
+
+namespace {
+
+// a bigger payload means a corrupted record, a 8K key frame is ~130 MB
+const quint32 MAX_PAYLOAD = 512 * 1024 * 1024;
+
+quint32 uint32At(const QByteArray &data, const int offset) {
+    return qFromLittleEndian<quint32>(
+                reinterpret_cast<const uchar *>(data.constData() + offset));
+}
+
+} // unnamed namespace
+
+TimelapseReader::TimelapseReader(const QString &path) :
+    m_file(path), m_tileSize(0), m_error(false)
+{
+
+}
+
+bool TimelapseReader::open() {
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = true;
+        return false;
+    }
+    const QByteArray header = m_file.read(TimelapseWriter::HEADER_SIZE);
+    if (header.size() != TimelapseWriter::HEADER_SIZE ||
+            std::memcmp(header.constData(), TimelapseWriter::MAGIC, 4) != 0 ||
+            uint32At(header, 4) != TimelapseWriter::VERSION)
+    {
+        m_error = true;
+        return false;
+    }
+    m_tileSize = uint32At(header, 8);
+    m_error = m_tileSize <= 0;
+    return !m_error;
+}
+
+// readFrame returns false at the end of the file, and also sets the error
+// flag when a record can't be read
+bool TimelapseReader::readFrame(QImage &frame, qint64 &timestamp) {
+    if (m_error || !m_file.isOpen()) {
+        return false;
+    }
+    const QByteArray header = m_file.read(TimelapseWriter::RECORD_HEADER_SIZE);
+    if (header.isEmpty()) {
+        return false;
+    }
+    const quint32 length = header.size() == TimelapseWriter::RECORD_HEADER_SIZE ?
+                uint32At(header, 12) : MAX_PAYLOAD + 1;
+    const QByteArray payload = length <= MAX_PAYLOAD ?
+                m_file.read(length) : QByteArray();
+    if (payload.size() != static_cast<int>(length) || length == 0) {
+        // truncated, the recording was interrupted
+        m_error = true;
+        return false;
+    }
+    bool ok = false;
+    switch (uint32At(header, 0)) {
+    case TimelapseWriter::RECORD_KEY:
+        ok = applyKeyFrame(payload);
+        break;
+    case TimelapseWriter::RECORD_DELTA:
+        ok = applyDelta(payload);
+        break;
+    }
+    if (!ok) {
+        m_error = true;
+        return false;
+    }
+    timestamp = qFromLittleEndian<qint64>(
+                reinterpret_cast<const uchar *>(header.constData() + 4));
+    frame = m_frame;
+    return true;
+}
+
+bool TimelapseReader::hasError() const {
+    return m_error;
+}
+
+// expand saves every frame as a PNG file named after the timelapse and the
+// number of the frame. The frames are encoded in parallel in batches, so
+// only a few of them are in memory at once. It returns false when a frame
+// can't be read or saved, the files saved until then stay in @paths.
+bool TimelapseReader::expand(const QString &directory, QStringList &paths) {
+    if (!m_file.isOpen() && !open()) {
+        return false;
+    }
+    struct Output {
+        QImage image;
+        QString path;
+        bool saved;
+    };
+    const QString base = QDir(directory).filePath(
+                QFileInfo(m_file.fileName()).completeBaseName());
+    const int batchSize = qMax(QThread::idealThreadCount(), 1) * 2;
+    int index = 0;
+    bool ok = true;
+    bool end = false;
+    while (ok && !end) {
+        QVector<Output> batch;
+        QImage frame;
+        qint64 timestamp;
+        while (batch.size() < batchSize) {
+            if (!readFrame(frame, timestamp)) {
+                end = true;
+                break;
+            }
+            batch.append({ frame, base + QString("-%1.png")
+                           .arg(index++, 5, 10, QChar('0')), false });
+        }
+        QtConcurrent::blockingMap(batch, [](Output &o) {
+            o.saved = PngEncoder().save(o.image, o.path);
+        });
+        for (const Output &o: batch) {
+            if (!o.saved) {
+                ok = false;
+                break;
+            }
+            paths << o.path;
+        }
+    }
+    return ok && !m_error;
+}
+
+bool TimelapseReader::applyKeyFrame(const QByteArray &payload) {
+    if (payload.size() < 8) {
+        return false;
+    }
+    const int width = uint32At(payload, 0);
+    const int height = uint32At(payload, 4);
+    const QByteArray rows = qUncompress(payload.mid(8));
+    if (width <= 0 || height <= 0 || rows.size() != width * height * 4) {
+        return false;
+    }
+    QImage frame(width, height, QImage::Format_RGB32);
+    if (frame.isNull()) {
+        return false;
+    }
+    for (int y = 0; y < height; ++y) {
+        std::memcpy(frame.scanLine(y), rows.constData() + y * width * 4,
+                    width * 4);
+    }
+    m_frame = frame;
+    return true;
+}
+
+// applyDelta copies the tiles in a new frame, the frames already returned
+// share the previous buffer
+bool TimelapseReader::applyDelta(const QByteArray &payload) {
+    if (m_frame.isNull() || payload.size() < 4) {
+        return false;
+    }
+    const quint32 count = uint32At(payload, 0);
+    if (count > static_cast<quint32>(payload.size() - 4) / 4) {
+        return false;
+    }
+    const QByteArray rows = qUncompress(payload.mid(4 + count * 4));
+    const TileHasher hasher(m_tileSize);
+    const QSize size = m_frame.size();
+    const int tiles = hasher.columns(size) * hasher.rows(size);
+    QImage frame = m_frame.copy();
+    int offset = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        const int index = uint32At(payload, 4 + i * 4);
+        if (index < 0 || index >= tiles) {
+            return false;
+        }
+        const QRect r = hasher.tileRect(index, size);
+        const int rowBytes = r.width() * 4;
+        if (offset + rowBytes * r.height() > rows.size()) {
+            return false;
+        }
+        for (int y = r.top(); y <= r.bottom(); ++y) {
+            std::memcpy(frame.scanLine(y) + r.x() * 4,
+                        rows.constData() + offset, rowBytes);
+            offset += rowBytes;
+        }
+    }
+    m_frame = frame;
+    return true;
+}
@@ -0,0 +1,45 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMELAPSEREADER_H
+#define TIMELAPSEREADER_H
+
+#include <QFile>
+#include <QImage>
+#include <QStringList>
+
+class TimelapseReader
+{
+public:
+    explicit TimelapseReader(const QString &path);
+
+    bool open();
+    bool readFrame(QImage &frame, qint64 &timestamp);
+    bool hasError() const;
+    bool expand(const QString &directory, QStringList &paths);
+
+private:
+    QFile m_file;
+    int m_tileSize;
+    QImage m_frame;
+    bool m_error;
+
+    bool applyKeyFrame(const QByteArray &payload);
+    bool applyDelta(const QByteArray &payload);
+};
+
+#endif // TIMELAPSEREADER_H
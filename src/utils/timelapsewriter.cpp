@@ -0,0 +1,132 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "timelapsewriter.h"
+#include "src/utils/tilehasher.h"
+#include <QtEndian>
+
+// TimelapseWriter stores the frames of a timelapse as key frames and tile
+// deltas. The file starts with a 16 bytes header: the magic "FSTL", the
+// version and the tile size as little-endian 32 bit integers and 4 zero
+// bytes. Each record has a 16 bytes header, the type, the milliseconds
+// since the epoch (64 bits) and the payload length, followed by:
+// - key frame: the width, the height and the zlib compressed BGRA rows.
+// - delta: the number of changed tiles, their row-major indexes and the
+//   zlib compressed BGRA rows of every tile, in the same order.
+// A delta applies to the frame built by the previous records, a reader can
+// stop at a truncated record and keep the frames written before it.
+
+const char TimelapseWriter::MAGIC[4] = { 'F', 'S', 'T', 'L' };
+
+namespace {
+
+void appendUInt32LE(QByteArray &out, const quint32 value) {
+    uchar b[4];
+    qToLittleEndian<quint32>(value, b);
+    out.append(reinterpret_cast<const char *>(b), 4);
+}
+
+// appendRows appends the BGRA rows of @rect without the line padding
+void appendRows(QByteArray &out, const QImage &image, const QRect &rect) {
+    const int rowBytes = rect.width() * 4;
+    for (int y = rect.top(); y <= rect.bottom(); ++y) {
+        out.append(reinterpret_cast<const char *>(
+                       image.constScanLine(y) + rect.x() * 4), rowBytes);
+    }
+}
+
+} // unnamed namespace
+
+// the file is truncated, it starts with the first key frame
+TimelapseWriter::TimelapseWriter(const QString &path, const int tileSize) :
+    m_file(path), m_tileSize(tileSize)
+{
+
+}
+
+QString TimelapseWriter::path() const {
+    return m_file.fileName();
+}
+
+int TimelapseWriter::tileSize() const {
+    return m_tileSize;
+}
+
+bool TimelapseWriter::appendKeyFrame(const QImage &frame,
+                                     const qint64 timestamp)
+{
+    if (!m_file.isOpen()) {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+        QByteArray header(MAGIC, sizeof(MAGIC));
+        appendUInt32LE(header, VERSION);
+        appendUInt32LE(header, m_tileSize);
+        appendUInt32LE(header, 0);
+        if (m_file.write(header) != header.size()) {
+            return false;
+        }
+    }
+    const QImage image = frame.format() == QImage::Format_RGB32 ? frame :
+            frame.convertToFormat(QImage::Format_RGB32);
+    QByteArray rows;
+    rows.reserve(image.width() * image.height() * 4);
+    appendRows(rows, image, image.rect());
+    QByteArray payload;
+    appendUInt32LE(payload, image.width());
+    appendUInt32LE(payload, image.height());
+    payload.append(qCompress(rows));
+    m_size = image.size();
+    return writeRecord(RECORD_KEY, timestamp, payload);
+}
+
+// appendDelta stores the @tiles of the frame, it must have the size of the
+// last key frame
+bool TimelapseWriter::appendDelta(const QImage &frame,
+                                  const QVector<int> &tiles,
+                                  const qint64 timestamp)
+{
+    if (!m_file.isOpen() || frame.size() != m_size) {
+        return false;
+    }
+    const QImage image = frame.format() == QImage::Format_RGB32 ? frame :
+            frame.convertToFormat(QImage::Format_RGB32);
+    const TileHasher hasher(m_tileSize);
+    QByteArray rows;
+    rows.reserve(tiles.size() * m_tileSize * m_tileSize * 4);
+    QByteArray payload;
+    appendUInt32LE(payload, tiles.size());
+    for (const int index: tiles) {
+        appendUInt32LE(payload, index);
+        appendRows(rows, image, hasher.tileRect(index, m_size));
+    }
+    payload.append(qCompress(rows));
+    return writeRecord(RECORD_DELTA, timestamp, payload);
+}
+
+bool TimelapseWriter::writeRecord(const RecordType type, const qint64 timestamp,
+                                  const QByteArray &payload)
+{
+    uchar header[RECORD_HEADER_SIZE];
+    qToLittleEndian<quint32>(type, header);
+    qToLittleEndian<quint64>(timestamp, header + 4);
+    qToLittleEndian<quint32>(payload.size(), header + 12);
+    // every record is flushed, a crash loses only the one being written
+    return m_file.write(reinterpret_cast<const char *>(header),
+                        RECORD_HEADER_SIZE) == RECORD_HEADER_SIZE &&
+            m_file.write(payload) == payload.size() && m_file.flush();
+}
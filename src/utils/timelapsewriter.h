@@ -0,0 +1,55 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMELAPSEWRITER_H
+#define TIMELAPSEWRITER_H
+
+#include <QFile>
+#include <QImage>
+#include <QVector>
+
+class TimelapseWriter
+{
+public:
+    enum RecordType {
+        RECORD_KEY = 1,
+        RECORD_DELTA = 2,
+    };
+
+    explicit TimelapseWriter(const QString &path, const int tileSize = 32);
+
+    QString path() const;
+    int tileSize() const;
+    bool appendKeyFrame(const QImage &frame, const qint64 timestamp);
+    bool appendDelta(const QImage &frame, const QVector<int> &tiles,
+                     const qint64 timestamp);
+
+    static const char MAGIC[4];
+    static const int HEADER_SIZE = 16;
+    static const int RECORD_HEADER_SIZE = 16;
+    static const quint32 VERSION = 1;
+
+private:
+    QFile m_file;
+    int m_tileSize;
+    QSize m_size;
+
+    bool writeRecord(const RecordType type, const qint64 timestamp,
+                     const QByteArray &payload);
+};
+
+#endif // TIMELAPSEWRITER_H
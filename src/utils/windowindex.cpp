@@ -0,0 +1,130 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "windowindex.h"
+#include "src/utils/desktopinfo.h"
+#include "src/third-party/qxtglobalshortcut5/gui/qxtwindowsystem.h"
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+#include <QX11Info>
+#include <X11/Xlib.h>
+#endif
+
+// WindowIndex keeps the geometry of the visible windows collected once when
+// the capture starts, so the window under the cursor can be found without
+// asking the window system on every mouse move.
+
+namespace {
+
+// side of the square cells of the grid
+const int CELL_SIZE = 128;
+
+bool isViewable(WId window) {
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(QX11Info::display(), window, &attributes)) {
+        return false;
+    }
+    return attributes.map_state == IsViewable;
+#else
+    Q_UNUSED(window);
+    return true;
+#endif
+}
+
+} // unnamed namespace
+
+WindowIndex::WindowIndex() : m_columns(0), m_rows(0) {
+
+}
+
+// build queries the window system once, bounds is the area covered by the
+// capture in logical coordinates
+void WindowIndex::build(const QRect &bounds, const qreal devicePixelRatio) {
+    m_windows.clear();
+    m_cells.clear();
+    m_bounds = bounds;
+    m_columns = (bounds.width() + CELL_SIZE - 1) / CELL_SIZE;
+    m_rows = (bounds.height() + CELL_SIZE - 1) / CELL_SIZE;
+    if (DesktopInfo().waylandDectected() || bounds.isEmpty()) {
+        return;
+    }
+    m_cells.resize(m_columns * m_rows);
+
+    // _NET_CLIENT_LIST_STACKING goes from the bottom to the top
+    for (const WId wid: QxtWindowSystem::windows()) {
+        if (!isViewable(wid)) {
+            continue;
+        }
+        QRect r = QxtWindowSystem::windowGeometry(wid);
+        // the window system reports physical pixels
+        r = QRect(r.topLeft() / devicePixelRatio, r.size() / devicePixelRatio);
+        r.translate(-bounds.topLeft());
+        r = r.intersected(QRect(QPoint(0, 0), bounds.size()));
+        if (r.isEmpty()) {
+            continue;
+        }
+        m_windows.append(r);
+        insert(m_windows.size() - 1);
+    }
+}
+
+// windowAt returns the rect of the topmost window containing pos, pos is
+// relative to the top left corner of the bounds
+QRect WindowIndex::windowAt(const QPoint &pos) const {
+    int cell = cellIndex(pos);
+    if (cell < 0) {
+        return QRect();
+    }
+    const QVector<int> &candidates = m_cells.at(cell);
+    for (int i = candidates.size() - 1; i >= 0; --i) {
+        const QRect &r = m_windows.at(candidates.at(i));
+        if (r.contains(pos)) {
+            return r;
+        }
+    }
+    return QRect();
+}
+
+bool WindowIndex::isEmpty() const {
+    return m_windows.isEmpty();
+}
+
+void WindowIndex::insert(const int index) {
+    const QRect &r = m_windows.at(index);
+    int firstColumn = r.left() / CELL_SIZE;
+    int lastColumn = qMin(r.right() / CELL_SIZE, m_columns - 1);
+    int firstRow = r.top() / CELL_SIZE;
+    int lastRow = qMin(r.bottom() / CELL_SIZE, m_rows - 1);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            m_cells[row * m_columns + column].append(index);
+        }
+    }
+}
+
+int WindowIndex::cellIndex(const QPoint &pos) const {
+    if (m_cells.isEmpty() || pos.x() < 0 || pos.y() < 0) {
+        return -1;
+    }
+    int column = pos.x() / CELL_SIZE;
+    int row = pos.y() / CELL_SIZE;
+    if (column >= m_columns || row >= m_rows) {
+        return -1;
+    }
+    return row * m_columns + column;
+}
@@ -0,0 +1,46 @@
+// Copyright 2017 Alejandro Sirgo Rica
+//
+// This file is part of Flameshot.
+//
+//     Flameshot is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Flameshot is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Flameshot.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WINDOWINDEX_H
+#define WINDOWINDEX_H
+
+#include <QRect>
+#include <QVector>
+
+class WindowIndex
+{
+public:
+    WindowIndex();
+
+    void build(const QRect &bounds, const qreal devicePixelRatio);
+    QRect windowAt(const QPoint &pos) const;
+    bool isEmpty() const;
+
+private:
+    // window rects in stacking order, the topmost is the last one
+    QVector<QRect> m_windows;
+    // uniform grid, every cell holds the indexes of the windows overlapping it
+    QVector<QVector<int> > m_cells;
+    QRect m_bounds;
+    int m_columns;
+    int m_rows;
+
+    void insert(const int index);
+    int cellIndex(const QPoint &pos) const;
+};
+
+#endif // WINDOWINDEX_H